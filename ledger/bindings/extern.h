@@ -18,15 +18,21 @@
 
 // extern.h
 #include "hashing.h"
+#include "slab.h"
+#include "state_types.h"
 #include <cstddef>
 #include <cstdint>
 
 extern "C" {
+    // fails, leaving out unset, if what a previous 
+    // process left remapped can't be settled;
+    // threads of 0 picks from the core count
     int ledger_open(
         void** out,
         const char* path, 
         size_t cache_size,
         size_t map_size,
+        size_t threads,
         const char* tag,
         unsigned char* secret,
         size_t secret_size
@@ -44,6 +50,39 @@ extern "C" {
         size_t setup_size
     );
 
+    // one entry per node size class in use,
+    // count is set to the number of classes even if > cap
+    int ledger_alloc_stats(
+        void* ledger,
+        SlabStats* out, size_t cap,
+        size_t* count
+    );
+
+    // a subtree heavier than this, in accounts or bytes, 
+    // has the root split on finalize. zero for either is no limit
+    int ledger_set_split_weight(
+        void* ledger,
+        uint32_t leaves,
+        uint64_t bytes
+    );
+
+    // 0 moves a block's versions to cannonical on justify, 1 only 
+    // remaps the cannonical root and leaves the moving to settle
+    int ledger_set_justify_mode(void* ledger, uint8_t mode);
+
+    // copies up to max_blocks remap justified blocks to cannonical, 
+    // oldest first. 0 settles all of them
+    int ledger_settle_versions(void* ledger, size_t max_blocks);
+
+    // count first and last pairs of the key byte the root splits on,
+    // both included. the cannonical trie outside them is dropped,
+    // none holds everything
+    int ledger_set_shards(
+        void* ledger,
+        const unsigned char* ranges,
+        size_t count
+    );
+
     // prev_block_hash is optional, and defaults to cannonical
     int ledger_create_account(
         void* ledger,
@@ -89,6 +128,160 @@ extern "C" {
         const Hash* prev_block_hash
     );
 
+    /*
+     *  applies a block's ops in one call, nothing is applied
+     *  unless the whole buffer is well formed.
+     *
+     *  buffer (little endian):
+     *      u8 version (1), u32 op count,
+     *      then per op:
+     *          u8 opcode (0 put, 1 replace, 2 remove, 
+     *                     3 create_account, 4 delete_account)
+     *          u8 val_idx, u16 key_size, key,
+     *          32 value hash, 32 prev value hash
+     *
+     *  unused hashes are ignored but must be present.
+     *  statuses gets one code per op, statuses_len >= op count.
+     *  prev_block_hash is optional, and defaults to cannonical
+     */
+    int ledger_apply_ops(
+        void* ledger,
+        const unsigned char* ops, size_t ops_size,
+        const Hash* block_hash,
+        const Hash* prev_block_hash,
+        int* statuses, size_t statuses_len
+    );
+
+    // value hash stored at key/val_idx, NOT_EXIST if there is none.
+    // block_hash is optional, and defaults to cannonical
+    int ledger_get(
+        void* ledger,
+        const unsigned char* key, size_t key_size,
+        uint8_t val_idx,
+        const Hash* block_hash,
+        Hash* out
+    );
+
+    /*
+     *  pins the trie as it is on disk (cannonical as of its last 
+     *  justify, a pending block as of its finalize) for many reads.
+     *  one thread at a time per snapshot, open one per reader thread.
+     *  block_hash is optional, and defaults to cannonical. a pending
+     *  block changed since its finalize gives BLOCK_NOT_FINALIZED
+     */
+    int ledger_snapshot_open(
+        void* ledger,
+        const Hash* block_hash,
+        void** out
+    );
+
+    int ledger_snapshot_get(
+        void* snapshot,
+        const unsigned char* key, size_t key_size,
+        uint8_t val_idx,
+        Hash* out
+    );
+
+    /*
+     *  count lookups at once, results[i] being what ledger_get
+     *  would return for keys[i]. the return code is for the call
+     *  as a whole (bad params, unknown block).
+     */
+    int ledger_multi_get(
+        void* ledger,
+        const unsigned char* const* keys, const size_t* key_sizes,
+        const uint8_t* val_idxs,
+        size_t count,
+        const Hash* block_hash,
+        Hash* outs,
+        int* results
+    );
+
+    int ledger_snapshot_multi_get(
+        void* snapshot,
+        const unsigned char* const* keys, const size_t* key_sizes,
+        const uint8_t* val_idxs,
+        size_t count,
+        Hash* outs,
+        int* results
+    );
+
+    void ledger_snapshot_close(void* snapshot);
+
+    /*
+     *  streams (key hash, slot, value hash) under a key hash prefix 
+     *  in key order, from what is on disk when opened.
+     *  next returns ITER_END (23) once it runs out.
+     *  block_hash is optional, and defaults to cannonical
+     */
+    int ledger_iter_open(
+        void* ledger,
+        const unsigned char* prefix, size_t prefix_size,
+        const Hash* block_hash,
+        void** out
+    );
+
+    int ledger_iter_next(
+        void* iter,
+        Hash* key_hash,
+        uint8_t* slot,
+        Hash* val_hash
+    );
+
+    void ledger_iter_close(void* iter);
+
+    /*
+     *  the cannonical trie as self verifying chunks, cut depth
+     *  levels below the root. next hands out malloc'd chunks
+     *  and returns ITER_END (23) once it runs out.
+     */
+    int ledger_export_open(
+        void* ledger,
+        uint8_t depth,
+        void** out
+    );
+
+    int ledger_export_next(
+        void* exporter,
+        void** out,
+        size_t* out_size
+    );
+
+    void ledger_export_close(void* exporter);
+
+    /*
+     *  checks every chunk against root_hash then writes them all,
+     *  nothing is written if one fails (INVALID_CHUNK, 24) or some
+     *  of the trie has no chunk (MISSING_CHUNK, 30).
+     *  meant for a fresh ledger
+     */
+    int ledger_import_chunks(
+        void* ledger,
+        const unsigned char* const* chunks, const size_t* chunk_sizes,
+        size_t count,
+        const Hash* root_hash
+    );
+
+    /*
+     *  builds the cannonical trie of an empty ledger bottom up.
+     *  add takes entries strictly increasing by key hash then slot
+     *  (UNSORTED_KEYS, 25 otherwise), finish writes what is left 
+     *  and gives the root hash. close frees the loader either way
+     */
+    int ledger_bulk_begin(void* ledger, void** out);
+
+    int ledger_bulk_add(
+        void* loader,
+        const Hash* key_hashes,
+        const uint8_t* slots,
+        const Hash* val_hashes,
+        size_t count
+    );
+
+    int ledger_bulk_finish(void* loader, Hash* root_hash);
+
+    void ledger_bulk_close(void* loader);
+
     int ledger_finalize(
         void* ledger, 
         const Hash* block_hash, 
@@ -106,6 +299,35 @@ extern "C" {
         const Hash* block_hash
     );
 
+    // ledger_finalize for a sharded ledger, out gets one vote per
+    // range held here, count is set to how many even if > cap.
+    // root_hash is set on OK, SHARDS_PENDING while other 
+    // shards' hashes are still missing
+    int ledger_finalize_shards(
+        void* ledger,
+        const Hash* block_hash,
+        ShardVote* out, size_t cap,
+        size_t* count,
+        Hash* root_hash
+    );
+
+    // another shard's hash for its range, same returns as above
+    int ledger_insert_shard_hash(
+        void* ledger,
+        const Hash* block_hash,
+        const ShardVote* vote,
+        Hash* root_hash
+    );
+
+    // first and last pairs of the ranges the block's root is still
+    // waiting on, count is set to how many even if > cap
+    int ledger_missing_shards(
+        void* ledger,
+        const Hash* block_hash,
+        unsigned char* out, size_t cap,
+        size_t* count
+    );
+
     // block_hash is optional, and defaults to cannonical
     int ledger_generate_existence_proof(
         void* ledger, 
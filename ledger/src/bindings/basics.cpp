@@ -17,7 +17,6 @@
  */
 
 #include "ledger.h"
-#include <cstring>
 
 int ledger_create_account(
     void* ledger,
@@ -109,8 +108,5 @@ int ledger_remove(
 
     const ByteSlice key_slice((byte*)key, key_size);
 
-    Hash zero_h;
-    std::memset(zero_h.h, 0, 32);
-
-    return l->put(key_slice, &zero_h, val_idx, block_hash, prev_block_hash);
+    return l->remove(key_slice, val_idx, block_hash, prev_block_hash);
 }
@@ -58,6 +58,65 @@ int ledger_justify(
     return justify_block(*l, block_hash);
 }
 
+int ledger_finalize_shards(
+    void* ledger,
+    const Hash* block_hash,
+    ShardVote* out, size_t cap,
+    size_t* count,
+    Hash* root_hash
+) {
+    if (!ledger || !block_hash || !count || !root_hash) return NULL_PARAMETER;
+    if (cap && !out) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::vector<ShardVote> votes;
+    int rc = finalize_shards(*l, block_hash, votes, root_hash);
+    if (rc != OK && rc != SHARDS_PENDING) return rc;
+
+    *count = votes.size();
+    size_t n = std::min(cap, votes.size());
+    for (size_t i{}; i < n; i++) out[i] = votes[i];
+
+    return rc;
+}
+
+int ledger_insert_shard_hash(
+    void* ledger,
+    const Hash* block_hash,
+    const ShardVote* vote,
+    Hash* root_hash
+) {
+    if (!ledger || !block_hash || !vote || !root_hash) return NULL_PARAMETER;
+    auto l = reinterpret_cast<Ledger*>(ledger);
+    return insert_shard_hash(*l, block_hash, *vote, root_hash);
+}
+
+int ledger_missing_shards(
+    void* ledger,
+    const Hash* block_hash,
+    unsigned char* out, size_t cap,
+    size_t* count
+) {
+    if (!ledger || !block_hash || !count) return NULL_PARAMETER;
+    if (cap && !out) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::vector<ShardRange> missing;
+    int rc = missing_shards(*l, block_hash, missing);
+    if (rc != OK) return rc;
+
+    *count = missing.size();
+    size_t n = std::min(cap, missing.size());
+    for (size_t i{}; i < n; i++) {
+        out[2 * i] = missing[i].first;
+        out[2 * i + 1] = missing[i].last;
+    }
+
+    return OK;
+}
+
 int ledger_generate_existence_proof(
     void* ledger, 
     const unsigned char* key, size_t key_size,
@@ -76,38 +135,26 @@ int ledger_generate_existence_proof(
     derive_hash(key_hash.h, key_slice);
     key_hash.h[31] = val_idx;
 
-    std::vector<Commitment> Cs;
-    std::vector<Proof> Pis;
-    Bitmap<8> split_map{};
-
-    int rc = generate_proof(*l, Cs, Pis, &split_map, &key_hash, block_hash);
-    if (rc != OK) return rc;
-
-    size_t total_size;
-    total_size += sizeof(uint8_t);
-    total_size += (Cs.size() * sizeof(Commitment));
-    total_size += sizeof(uint8_t);
-    total_size += (Pis.size() * sizeof(Proof));
-    total_size += sizeof(uint8_t); // split_map
+    std::vector<byte> proof;
 
-    *out = malloc(total_size);
-    *out_size = total_size;
+    if (!block_hash) {
+        int rc = generate_cached_proof(*l, &key_hash, proof);
+        if (rc != OK) return rc;
 
-    auto cursor = reinterpret_cast<byte*>(*out);
+    } else {
+        std::vector<Commitment> Cs;
+        std::vector<Proof> Pis;
+        ProofShape shape{};
 
-    *cursor++ = Cs.size();
-    for (auto &commit: Cs) {
-        blst_p1_compress(cursor, &commit);
-        cursor += sizeof(Commitment);
-    }
+        int rc = generate_proof(*l, Cs, Pis, &shape, &key_hash, block_hash);
+        if (rc != OK) return rc;
 
-    *cursor++ = Pis.size();
-    for (auto &proof: Pis) {
-        blst_p1_compress(cursor, &proof);
-        cursor += sizeof(Proof);
+        proof = encode_proof(Cs, Pis, &shape);
     }
 
-    *cursor++ = *split_map.data_ptr();
+    *out = malloc(proof.size());
+    *out_size = proof.size();
+    std::memcpy(*out, proof.data(), proof.size());
 
     return 0;
 }
@@ -125,26 +172,10 @@ int ledger_validate_proof(
 
     auto l = reinterpret_cast<Ledger*>(ledger);
 
-    auto cursor = proof;
-
-    uint8_t Cs_size = *cursor;
-    cursor++;
-    std::vector<Commitment> Cs(Cs_size);;
-    for (auto &commit: Cs) {
-        commit = p1_from_bytes(cursor);
-        cursor += sizeof(Commitment);
-    }
-
-
-    uint8_t Pis_size = *cursor;
-    cursor++;
-    std::vector<Proof> Pis(Pis_size);
-    for (auto &proof: Pis) {
-        proof = p1_from_bytes(cursor);
-        cursor += sizeof(Proof);
-    }
-
-    Bitmap<8> split_map(cursor++);
+    std::vector<Commitment> Cs;
+    std::vector<Proof> Pis;
+    ProofShape shape{};
+    decode_proof(proof, Cs, Pis, &shape);
 
     const ByteSlice key_slice((byte*)key, key_size);
     Hash key_hash;
@@ -154,8 +185,8 @@ int ledger_validate_proof(
     std::vector<size_t> Zs;
     std::vector<blst_scalar> Ys;
 
-    derive_Zs_n_Ys(*l, &key_hash, value_hash, &split_map, &Cs, &Pis, &Zs, &Ys);
+    derive_Zs_n_Ys(*l, &key_hash, value_hash, &shape, &Cs, &Pis, &Zs, &Ys);
 
-    return valid_proof(*l, &Cs, &Pis, &split_map, &key_hash, value_hash, val_idx);
+    return valid_proof(*l, &Cs, &Pis, &shape, &key_hash, value_hash, val_idx);
 }
 
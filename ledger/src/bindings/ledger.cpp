@@ -27,6 +27,7 @@ int ledger_open(
     const char* path, 
     size_t cache_size,
     size_t map_size,
+    size_t threads,
     const char* tag,
     unsigned char* secret,
     size_t secret_size
@@ -49,8 +50,15 @@ int ledger_open(
         std::memset(random, 0, 32);
     }
 
-    *out = new Ledger(path, cache_size, map_size, tag, s);
+    auto l = new Ledger(path, cache_size, map_size, tag, s, threads);
 
+    int rc = l->open_status();
+    if (rc != OK) {
+        delete l;
+        return rc;
+    }
+
+    *out = l;
     return OK;
 }
 
@@ -123,4 +131,67 @@ int ledger_set_SRS(
 
     return 0;
 }
+
+int ledger_alloc_stats(
+    void* ledger,
+    SlabStats* out, size_t cap,
+    size_t* count
+) {
+    if (!ledger || !count) return NULL_PARAMETER;
+    if (cap && !out) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::vector<SlabStats> stats = l->get_gadgets()->alloc.alloc_stats();
+    *count = stats.size();
+
+    size_t n = std::min(cap, stats.size());
+    for (size_t i{}; i < n; i++) out[i] = stats[i];
+
+    return OK;
+}
+
+int ledger_set_split_weight(
+    void* ledger,
+    uint32_t leaves,
+    uint64_t bytes
+) {
+    if (!ledger) return NULL_PARAMETER;
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    l->set_split_weight({leaves, bytes});
+    return OK;
+}
+
+int ledger_set_justify_mode(void* ledger, uint8_t mode) {
+    if (!ledger) return NULL_PARAMETER;
+    if (mode > JUSTIFY_REMAP) return INVALID_JUSTIFY_MODE;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+    l->set_justify_mode(static_cast<JustifyMode>(mode));
+    return OK;
+}
+
+int ledger_settle_versions(void* ledger, size_t max_blocks) {
+    if (!ledger) return NULL_PARAMETER;
+    auto l = reinterpret_cast<Ledger*>(ledger);
+    return l->settle_versions(max_blocks);
+}
+
+int ledger_set_shards(
+    void* ledger,
+    const unsigned char* ranges,
+    size_t count
+) {
+    if (!ledger) return NULL_PARAMETER;
+    if (count && !ranges) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::vector<ShardRange> shards(count);
+    for (size_t i{}; i < count; i++) 
+        shards[i] = {ranges[2 * i], ranges[2 * i + 1]};
+
+    return l->set_shards(shards);
+}
 }
@@ -0,0 +1,127 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ledger.h"
+#include <cstring>
+
+const uint8_t OPS_VERSION = 1;
+const size_t OPS_HEADER_SIZE = 1 + sizeof(uint32_t);
+const size_t OP_FIXED_SIZE = 1 + 1 + sizeof(uint16_t) + 32 + 32;
+const size_t PARALLEL_APPLY_MIN = 256;
+
+// checks every record before anything is applied
+static int parse_ops(
+    const byte* buf, size_t size,
+    std::vector<LedgerOp> &ops,
+    std::vector<Hash> &hashes
+) {
+    if (size < OPS_HEADER_SIZE || buf[0] != OPS_VERSION) 
+        return INVALID_OPS_BUFFER;
+
+    uint32_t count;
+    std::memcpy(&count, buf + 1, sizeof(count));
+
+    // cant be more ops than fixed sized records
+    if (count > (size - OPS_HEADER_SIZE) / OP_FIXED_SIZE) 
+        return INVALID_OPS_BUFFER;
+
+    ops.reserve(count);
+
+    // ops point into this, so it cant reallocate
+    hashes.resize(2 * size_t(count));
+
+    const byte* cursor = buf + OPS_HEADER_SIZE;
+    const byte* end = buf + size;
+
+    for (uint32_t i{}; i < count; i++) {
+        if (size_t(end - cursor) < OP_FIXED_SIZE) return INVALID_OPS_BUFFER;
+
+        uint8_t opcode = *cursor++;
+        uint8_t idx = *cursor++;
+
+        uint16_t key_size;
+        std::memcpy(&key_size, cursor, sizeof(key_size));
+        cursor += sizeof(key_size);
+
+        if (opcode > OP_DELETE_ACCOUNT) return INVALID_OPS_BUFFER;
+        if (key_size == 0) return INVALID_OPS_BUFFER;
+        if (size_t(end - cursor) < size_t(key_size) + 64) return INVALID_OPS_BUFFER;
+
+        bool account_op = (
+            opcode == OP_CREATE_ACCOUNT || 
+            opcode == OP_DELETE_ACCOUNT
+        );
+        if (!account_op && idx >= LEAF_ORDER) return INVALID_OPS_BUFFER;
+
+        ByteSlice key((byte*)cursor, key_size);
+        cursor += key_size;
+
+        Hash* val_hash = &hashes[2 * i];
+        std::memcpy(val_hash->h, cursor, 32);
+        cursor += 32;
+
+        Hash* prev_val_hash = &hashes[2 * i + 1];
+        std::memcpy(prev_val_hash->h, cursor, 32);
+        cursor += 32;
+
+        ops.push_back({
+            static_cast<OpKind>(opcode), key, idx,
+            val_hash,
+            opcode == OP_REPLACE ? prev_val_hash : nullptr
+        });
+    }
+
+    if (cursor != end) return INVALID_OPS_BUFFER;
+
+    return OK;
+}
+
+extern "C" {
+
+int ledger_apply_ops(
+    void* ledger,
+    const unsigned char* ops, size_t ops_size,
+    const Hash* block_hash,
+    const Hash* prev_block_hash,
+    int* statuses, size_t statuses_len
+) {
+    if (!ledger || !ops || !block_hash || !statuses) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::vector<LedgerOp> parsed;
+    std::vector<Hash> hashes;
+
+    int rc = parse_ops(ops, ops_size, parsed, hashes);
+    if (rc != OK) return rc;
+
+    if (statuses_len < parsed.size()) return INVALID_OPS_BUFFER;
+
+    // below this handing groups to the pool costs more than it saves
+    bool parallel = parsed.size() >= PARALLEL_APPLY_MIN;
+
+    std::vector<int> results;
+    rc = l->apply_batch(parsed, results, block_hash, prev_block_hash, parallel);
+    if (rc != OK) return rc;
+
+    std::memcpy(statuses, results.data(), results.size() * sizeof(int));
+
+    return OK;
+}
+
+}
@@ -0,0 +1,161 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ledger.h"
+
+extern "C" {
+int ledger_get(
+    void* ledger,
+    const unsigned char* key, size_t key_size,
+    uint8_t val_idx,
+    const Hash* block_hash,
+    Hash* out
+) {
+    if (!ledger || !key || !out) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+    const ByteSlice key_slice((byte*)key, key_size);
+
+    return l->get(key_slice, val_idx, out, block_hash);
+}
+
+int ledger_snapshot_open(
+    void* ledger,
+    const Hash* block_hash,
+    void** out
+) {
+    if (!ledger || !out) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::unique_ptr<Snapshot> snap;
+    int rc = l->open_snapshot(snap, block_hash);
+    if (rc != OK) return rc;
+
+    *out = snap.release();
+    return OK;
+}
+
+int ledger_snapshot_get(
+    void* snapshot,
+    const unsigned char* key, size_t key_size,
+    uint8_t val_idx,
+    Hash* out
+) {
+    if (!snapshot || !key || !out) return NULL_PARAMETER;
+
+    auto snap = reinterpret_cast<Snapshot*>(snapshot);
+
+    const ByteSlice key_slice((byte*)key, key_size);
+
+    Hash key_hash;
+    derive_hash(key_hash.h, key_slice);
+    key_hash.h[32-1] = val_idx;
+
+    return snap->get(&key_hash, out);
+}
+
+int ledger_multi_get(
+    void* ledger,
+    const unsigned char* const* keys, const size_t* key_sizes,
+    const uint8_t* val_idxs,
+    size_t count,
+    const Hash* block_hash,
+    Hash* outs,
+    int* results
+) {
+    if (!ledger || !keys || !key_sizes || !val_idxs || !outs || !results) 
+        return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::vector<ByteSlice> key_slices;
+    key_slices.reserve(count);
+    for (size_t i{}; i < count; i++) {
+        if (!keys[i]) return NULL_PARAMETER;
+        key_slices.emplace_back((byte*)keys[i], key_sizes[i]);
+    }
+
+    return l->multi_get(key_slices.data(), val_idxs, count, outs, results, block_hash);
+}
+
+int ledger_snapshot_multi_get(
+    void* snapshot,
+    const unsigned char* const* keys, const size_t* key_sizes,
+    const uint8_t* val_idxs,
+    size_t count,
+    Hash* outs,
+    int* results
+) {
+    if (!snapshot || !keys || !key_sizes || !val_idxs || !outs || !results) 
+        return NULL_PARAMETER;
+
+    auto snap = reinterpret_cast<Snapshot*>(snapshot);
+
+    std::vector<Hash> key_hashes(count);
+    for (size_t i{}; i < count; i++) {
+        if (!keys[i]) return NULL_PARAMETER;
+
+        const ByteSlice key_slice((byte*)keys[i], key_sizes[i]);
+        derive_hash(key_hashes[i].h, key_slice);
+        key_hashes[i].h[32-1] = val_idxs[i];
+    }
+
+    snap->multi_get(key_hashes.data(), count, outs, results);
+    return OK;
+}
+
+void ledger_snapshot_close(void* snapshot) {
+    delete reinterpret_cast<Snapshot*>(snapshot);
+}
+
+int ledger_iter_open(
+    void* ledger,
+    const unsigned char* prefix, size_t prefix_size,
+    const Hash* block_hash,
+    void** out
+) {
+    if (!ledger || !out) return NULL_PARAMETER;
+    if (prefix_size && !prefix) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::unique_ptr<RangeIter> it;
+    int rc = l->iter(it, (const byte*)prefix, prefix_size, block_hash);
+    if (rc != OK) return rc;
+
+    *out = it.release();
+    return OK;
+}
+
+int ledger_iter_next(
+    void* iter,
+    Hash* key_hash,
+    uint8_t* slot,
+    Hash* val_hash
+) {
+    if (!iter || !key_hash || !slot || !val_hash) return NULL_PARAMETER;
+
+    auto it = reinterpret_cast<RangeIter*>(iter);
+    return it->next(key_hash, slot, val_hash);
+}
+
+void ledger_iter_close(void* iter) {
+    delete reinterpret_cast<RangeIter*>(iter);
+}
+}
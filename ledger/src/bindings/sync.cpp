@@ -0,0 +1,124 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ledger.h"
+#include <cstring>
+
+extern "C" {
+int ledger_export_open(
+    void* ledger,
+    uint8_t depth,
+    void** out
+) {
+    if (!ledger || !out) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::unique_ptr<ChunkExporter> exp;
+    int rc = l->export_chunks(exp, depth);
+    if (rc != OK) return rc;
+
+    *out = exp.release();
+    return OK;
+}
+
+int ledger_export_next(
+    void* exporter,
+    void** out,
+    size_t* out_size
+) {
+    if (!exporter || !out || !out_size) return NULL_PARAMETER;
+
+    auto exp = reinterpret_cast<ChunkExporter*>(exporter);
+
+    std::vector<byte> chunk;
+    int rc = exp->next(chunk);
+    if (rc == OK) {
+        *out = malloc(chunk.size());
+        *out_size = chunk.size();
+
+        std::memcpy(*out, chunk.data(), chunk.size());
+    }
+    return rc;
+}
+
+void ledger_export_close(void* exporter) {
+    delete reinterpret_cast<ChunkExporter*>(exporter);
+}
+
+int ledger_import_chunks(
+    void* ledger,
+    const unsigned char* const* chunks, const size_t* chunk_sizes,
+    size_t count,
+    const Hash* root_hash
+) {
+    if (!ledger || !chunks || !chunk_sizes || !root_hash) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::vector<ByteSlice> slices;
+    slices.reserve(count);
+    for (size_t i{}; i < count; i++) {
+        if (!chunks[i]) return NULL_PARAMETER;
+        slices.emplace_back((byte*)chunks[i], chunk_sizes[i]);
+    }
+
+    return l->import_chunks(slices, root_hash);
+}
+
+int ledger_bulk_begin(void* ledger, void** out) {
+    if (!ledger || !out) return NULL_PARAMETER;
+
+    auto l = reinterpret_cast<Ledger*>(ledger);
+
+    std::unique_ptr<BulkLoader> loader;
+    int rc = l->bulk_load(loader);
+    if (rc != OK) return rc;
+
+    *out = loader.release();
+    return OK;
+}
+
+int ledger_bulk_add(
+    void* loader,
+    const Hash* key_hashes,
+    const uint8_t* slots,
+    const Hash* val_hashes,
+    size_t count
+) {
+    if (!loader || !key_hashes || !slots || !val_hashes) return NULL_PARAMETER;
+
+    auto bl = reinterpret_cast<BulkLoader*>(loader);
+    for (size_t i{}; i < count; i++) {
+        int rc = bl->add(&key_hashes[i], slots[i], &val_hashes[i]);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+int ledger_bulk_finish(void* loader, Hash* root_hash) {
+    if (!loader || !root_hash) return NULL_PARAMETER;
+
+    auto bl = reinterpret_cast<BulkLoader*>(loader);
+    return bl->finish(root_hash);
+}
+
+void ledger_bulk_close(void* loader) {
+    delete reinterpret_cast<BulkLoader*>(loader);
+}
+}
@@ -18,82 +18,280 @@
 
 #include "processing.h"
 #include "bitmap.h"
+#include "branch.h"
+#include "fft.h"
 #include "hashing.h"
 #include "helpers.h"
 #include "kzg.h"
 #include "state_types.h"
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
-#include <future>
+
+// key byte each branch in a proof is opened at, leaf end first
+// like the proof. the top one is the root's, a split and the
+// range under it are opened at the same byte
+static std::vector<size_t> opening_bytes(const ProofShape* shape, size_t branches) {
+    std::vector<size_t> at(branches);
+
+    size_t level{};
+    bool in_split{};
+    for (size_t b = branches; b-- > 0;) {
+        size_t skip = b < shape->skips.size() ? shape->skips[b] : 0;
+        at[b] = level + skip;
+
+        if (!in_split && level < 8 && shape->split_map.is_set(level)) {
+            in_split = true;
+            continue;
+        }
+
+        in_split = false;
+        level = at[b] + 1;
+    }
+
+    return at;
+}
 
 // descends subtree & generates proofs and commitments.
 // returns the new root hash for that block.
-int finalize_block(
-    Ledger &ledger, 
-    const Hash* block_hash, 
-    Hash* out
+// nodes hashed per task, hashing alone is too cheap to go one by one
+const size_t LEVEL_HASH_CHUNK = 64;
+
+// commits, hashes and writes one depth worth of nodes
+static int finalize_level(
+    const Gadgets_ptr &gadgets,
+    std::vector<Node_ptr> &level
 ) {
+    const KZGSettings &settings = gadgets->settings;
+    size_t n = level.size();
+
+    std::vector<blst_p1> commits(n);
+    {
+        TaskGroup tasks(gadgets->pool);
+        for (size_t i{}; i < n; i++) {
+            tasks.spawn([&, i] {
+                Polynomial poly(BRANCH_ORDER, ZERO_SK);
+                level[i]->fill_evals(poly);
+                inverse_fft_in_place(poly, settings.roots.inv_roots);
+                commit_g1_msm(&commits[i], poly, settings.setup);
+            });
+        }
+        tasks.wait();
+    }
 
-    size_t BATCHES = 4;
-    size_t PER_BATCH = BRANCH_ORDER / BATCHES;
+    // one shared inversion for the level instead of one per node.
+    // the point at infinity has no affine form so leave those lazy
+    std::vector<const blst_p1*> finite;
+    std::vector<size_t> finite_idx;
+    for (size_t i{}; i < n; i++) {
+        if (blst_p1_is_inf(&commits[i])) continue;
+        finite.push_back(&commits[i]);
+        finite_idx.push_back(i);
+    }
 
-    Polynomial Fx(BRANCH_ORDER, ZERO_SK);
+    std::vector<blst_p1_affine> affs(finite.size());
+    if (!finite.empty()) 
+        blst_p1s_to_affine(affs.data(), finite.data(), finite.size());
+
+    for (size_t i{}; i < n; i++) 
+        if (blst_p1_is_inf(&commits[i])) level[i]->set_commitment(commits[i]);
+    for (size_t k{}; k < finite.size(); k++) 
+        level[finite_idx[k]]->set_commitment(commits[finite_idx[k]], affs[k]);
+
+    {
+        TaskGroup tasks(gadgets->pool);
+        for (size_t begin{}; begin < n; begin += LEVEL_HASH_CHUNK) {
+            tasks.spawn([&, begin] {
+                size_t end = std::min(begin + LEVEL_HASH_CHUNK, n);
+                for (size_t i = begin; i < end; i++) 
+                    level[i]->get_scalar();
+            });
+        }
+        tasks.wait();
+    }
 
-    std::vector<std::future<int>> futures; 
-    futures.reserve(BATCHES);
+    return gadgets->alloc.write_nodes(level);
+}
 
-    uint16_t block_id = ledger.get_block_id(block_hash, false);
-    if (block_id == 0) return BLOCK_NOT_EXIST;
+/*
+ *  walks the blocks dirty set bottom up rather than searching
+ *  the trie for it. a node's parent is its id a level up, and
+ *  the nibble it hangs off is the last of its path.
+ *  returns false in found if the block has no recorded set.
+ */
+static int finalize_levels(
+    Ledger &ledger,
+    Node_ptr root,
+    uint16_t block_id,
+    bool commit_root,
+    bool* found
+) {
+    const Gadgets_ptr gadgets = ledger.get_gadgets();
 
+    std::vector<NodeId> dirty;
+    *found = gadgets->alloc.dirty_nodes(block_id, dirty);
+    if (!*found) return OK;
 
-    /*
-     *  TODO --
-     *      this function needs to be able to get 
-     *      a specific shard root.
-     *          because you cant finalize a layer before you get all the other shard hashes
-     *          but then how can you tell when you do recieve them all
-     *              keep track of what you recieve and what you need...
-     */
+    const NodeId root_id = *root->get_id();
+    uint8_t root_level = root_id.get_level();
 
-    std::vector<byte> shard_prefix;
+    std::unordered_map<NodeId, Node_ptr, NodeIdHash> by_id;
+    by_id.reserve(dirty.size() + 1);
+    by_id.emplace(root_id, root);
 
-    Result<Node_ptr, int> r = ledger.get_root(&shard_prefix, block_id);
-    if (r.is_err()) return r.unwrap_err();
-    Node_ptr root = r.unwrap();
+    std::vector<std::vector<Node_ptr>> levels(1);
+    levels[0].push_back(root);
 
+    for (auto &id: dirty) {
+        if (id == root_id || id.get_level() < root_level) continue;
 
-    for (size_t i{}; i < BATCHES; i++) {
-        futures.push_back(std::async(std::launch::async, [&, i] {
+        auto res = gadgets->alloc.load_node(&id);
+        if (res.is_err()) {
+            int rc = res.unwrap_err();
+            if (rc == MDB_NOTFOUND) continue;
+            return rc;
+        }
 
-            int start = i * PER_BATCH;
-            int end = start + PER_BATCH;
+        // removed during the block, nothing to commit or write
+        Node_ptr node = res.unwrap();
+        if (node->should_delete()) continue;
 
-            // TODO -- shard hashes
-            Hash shard_hash;
+        size_t depth = id.get_level() - root_level;
+        if (levels.size() <= depth) levels.resize(depth + 1);
+        levels[depth].push_back(node);
 
-            return root->finalize(
-                &shard_hash,
-                block_id, nullptr,
-                start, end, &Fx
-            );
-        }));
+        by_id.emplace(id, node);
     }
 
-    int res {OK};
-    for (auto &f : futures) {
-        int interm_res = f.get();
-        if (interm_res != OK) {
-            res = interm_res;
+    for (size_t d = levels.size(); d-- > 0;) {
+        std::vector<Node_ptr> &level = levels[d];
+        if (level.empty()) continue;
+
+        // every child is in by now
+        for (auto &node: level) {
+            int rc = node->commit_ranges(block_id);
+            if (rc != OK) return rc;
+        }
+        if (d == 0 && !commit_root) break;
+
+        int rc = finalize_level(gadgets, level);
+        if (rc != OK) return rc;
+
+        if (d == 0) break;
+
+        for (auto &node: level) {
+            NodeId parent_id {node->get_id()};
+            uint8_t lvl = parent_id.get_level();
+            byte anchor = parent_id.get_full()[lvl - 1];
+
+            // a parent with an extension sits more than a level up,
+            // its the nearest of this block's nodes on the path
+            auto it = by_id.end();
+            while (it == by_id.end() && lvl > root_level) {
+                if (lvl <= ID_PATH_SIZE) parent_id.set_self_nibble(0);
+                parent_id.set_level(--lvl);
+                it = by_id.find(parent_id);
+            }
+            if (it == by_id.end()) continue;
+
+            it->second->set_child_scalar(anchor, block_id, *node->get_scalar());
         }
     }
-    if (res != OK) return res;
 
-    const KZGSettings* settings = &ledger.get_gadgets()->settings;
+    return OK;
+}
 
-    blst_scalar sk;
-    hash_p1_to_scalar(root->derive_commitment(), &sk, &settings->tag);
+// snapshots read a pending block off disk, so what the 
+// fork-join walk committed goes down with the finalize
+static int write_dirty(const Gadgets_ptr &gadgets, uint16_t block_id) {
+    std::vector<NodeId> dirty;
+    if (!gadgets->alloc.dirty_nodes(block_id, dirty)) return OK;
+
+    std::vector<Node_ptr> nodes;
+    nodes.reserve(dirty.size());
+    for (auto &id: dirty) {
+        auto res = gadgets->alloc.load_node(&id);
+        if (res.is_err()) {
+            int rc = res.unwrap_err();
+            if (rc == MDB_NOTFOUND) continue;
+            return rc;
+        }
+
+        // removed during the block, nothing links to it
+        if (res.unwrap()->should_delete()) continue;
+        nodes.push_back(res.unwrap());
+    }
+
+    return gadgets->alloc.write_nodes(nodes);
+}
+
+// finalizes what the block changed under its root, and the root
+// itself unless it has to wait on other shards' ranges
+static int finalize_root(
+    Ledger &ledger,
+    uint16_t block_id,
+    FinalizeMode mode,
+    bool commit_root,
+    Node_ptr &root
+) {
+    Polynomial Fx(BRANCH_ORDER, ZERO_SK);
+
+    // ranges are settled before anything under them is committed
+    int split_rc = ledger.split_heavy(block_id);
+    if (split_rc != OK) return split_rc;
+
+    std::vector<byte> shard_prefix;
+
+    Result<Node_ptr, int> r = ledger.get_root(&shard_prefix, block_id);
+    if (r.is_err()) return r.unwrap_err();
+    root = r.unwrap();
+
+    Hash shard_hash;
+
+    bool found = false;
+    if (mode == FINALIZE_LEVELS) {
+        int res = finalize_levels(ledger, root, block_id, commit_root, &found);
+        if (res != OK) return res;
+    }
+
+    // no record of what the block touched, search for it
+    if (!found) {
+        // forks off every heavy dirty subtree,
+        // so the work spreads wherever the block wrote
+        int res = root->finalize(
+            &shard_hash,
+            block_id, nullptr,
+            0, BRANCH_ORDER, &Fx
+        );
+        if (res != OK) return res;
+
+        if (commit_root) root->derive_commitment();
+
+        res = write_dirty(ledger.get_gadgets(), block_id);
+        if (res != OK) return res;
+    }
+
+    return OK;
+}
+
+int finalize_block(
+    Ledger &ledger, 
+    const Hash* block_hash, 
+    Hash* out,
+    FinalizeMode mode
+) {
+    uint16_t block_id = ledger.get_block_id(block_hash, false);
+    if (block_id == 0) return BLOCK_NOT_EXIST;
+
+    // a sharded ledger waits on the other shards, see finalize_shards
+    Node_ptr root;
+    int rc = finalize_root(ledger, block_id, mode, true, root);
+    if (rc != OK) return rc;
+
+    blst_scalar sk = *root->get_scalar();
     std::memcpy(out->h, sk.b, sizeof(out->h));
 
+    ledger.block_finalized(block_id);
 
     // TODO -- delete_block_hash...
     // rather replace block_hash -> block_id
@@ -102,42 +300,179 @@ int finalize_block(
     return OK;
 }
 
-// descends subtree and changes all block_ids to ZERO.
-// if child block_id != 0 load it... recurse...
-    // delete self (block_id) 
-    // if have no children return DELETED
-    // else overwrite block_id == 0 node with self
-        // and if leaf, save values under new block_id??
-    // return OK
+// the root's commitment, once each of its ranges has its hash
+static int combine_shards(Ledger &ledger, Node_ptr root, Hash* out) {
+    root->derive_commitment();
+
+    int rc = ledger.get_gadgets()->alloc.write_nodes({root});
+    if (rc != OK) return rc;
+
+    blst_scalar sk = *root->get_scalar();
+    std::memcpy(out->h, sk.b, sizeof(out->h));
+
+    ledger.block_finalized(root->get_id()->get_block_id());
+    return OK;
+}
+
+int finalize_shards(
+    Ledger &ledger, 
+    const Hash* block_hash, 
+    std::vector<ShardVote> &out,
+    Hash* root_hash,
+    FinalizeMode mode
+) {
+    uint16_t block_id = ledger.get_block_id(block_hash, false);
+    if (block_id == 0) return BLOCK_NOT_EXIST;
+
+    Node_ptr root;
+    int rc = finalize_root(ledger, block_id, mode, false, root);
+    if (rc != OK) return rc;
+
+    // the root is always a branch
+    const std::vector<Child> &ranges = static_cast<Branch*>(root.get())->get_ranges();
+
+    out.clear();
+    for (auto &range: ranges) {
+        if (!ledger.holds_range(range.anchor, range.end)) continue;
+
+        ShardVote vote{range.anchor, range.end, ZERO_HASH};
+        std::memcpy(vote.hash.h, range.sk.b, sizeof(vote.hash.h));
+        out.push_back(vote);
+    }
+
+    ledger.shard_finalized(block_id);
+    if (!ledger.shards_complete(block_id, ranges)) return SHARDS_PENDING;
+
+    return combine_shards(ledger, root, root_hash);
+}
+
+int insert_shard_hash(
+    Ledger &ledger,
+    const Hash* block_hash,
+    const ShardVote &vote,
+    Hash* root_hash
+) {
+    uint16_t block_id = ledger.get_block_id(block_hash, false);
+    if (block_id == 0) return BLOCK_NOT_EXIST;
+
+    // ours are committed here, never taken from elsewhere
+    if (ledger.holds_range(vote.first, vote.last)) return INVALID_SHARD;
+
+    Result<Node_ptr, int> r = ledger.get_root(nullptr, block_id);
+    if (r.is_err()) return r.unwrap_err();
+    Node_ptr root = r.unwrap();
+
+    // the root is always a branch
+    Branch* branch = static_cast<Branch*>(root.get());
+
+    blst_scalar sk;
+    blst_scalar_from_le_bytes(&sk, vote.hash.h, sizeof(vote.hash.h));
+    if (!branch->set_range_scalar(vote.first, vote.last, sk)) return INVALID_SHARD;
+
+    ledger.shard_received(block_id, vote.first);
+    if (!ledger.shards_complete(block_id, branch->get_ranges())) return SHARDS_PENDING;
+
+    return combine_shards(ledger, root, root_hash);
+}
+
+int missing_shards(
+    Ledger &ledger,
+    const Hash* block_hash,
+    std::vector<ShardRange> &out
+) {
+    uint16_t block_id = ledger.get_block_id(block_hash, false);
+    if (block_id == 0) return BLOCK_NOT_EXIST;
+
+    Result<Node_ptr, int> r = ledger.get_root(nullptr, block_id);
+    if (r.is_err()) return r.unwrap_err();
+    Node_ptr root = r.unwrap();
+
+    out = ledger.missing_shards(block_id, static_cast<Branch*>(root.get())->get_ranges());
+    return OK;
+}
+
+/*
+ *  justifies without touching a node. the cannonical root is 
+ *  pointed at the block's, whose links reach the rest of its 
+ *  versions, and settle_versions does the copying later on.
+ *  which proofs went stale isn't worked out, they all are
+ */
+static int justify_by_remap(Ledger &ledger, uint16_t block_id) {
+    ledger.get_proof_cache().invalidate_all();
+
+    int rc = ledger.remap_block(block_id);
+    if (rc != OK) return rc;
+
+    ledger.forget_shards(block_id);
+
+    // the root may have split, or split further
+    return ledger.drop_outside_shards();
+}
+
+// promotes every version this block has to its cannonical id.
 // ALL DESCENDANTS AND COMPETITORS MUST BE PRUNED
 int justify_block(Ledger &ledger, const Hash* block_hash) {
 
-
     uint16_t block_id = ledger.get_block_id(block_hash, false);
     if (block_id == 0) return BLOCK_NOT_EXIST;
 
-    Result<Node_ptr, int> root = ledger.get_root(nullptr, block_id);
-    if (root.is_err()) return root.unwrap_err();
+    if (ledger.get_justify_mode() == JUSTIFY_REMAP) 
+        return justify_by_remap(ledger, block_id);
+
+    // a remapped block's versions are cannonical in all but id, 
+    // so they go first for this one's to land on top
+    int rc = ledger.settle_versions();
+    if (rc != OK) return rc;
+
+    NodeAllocator &alloc = ledger.get_gadgets()->alloc;
+    std::vector<NodeId> versions;
+    rc = alloc.block_versions(block_id, versions);
+    if (rc != OK) return rc;
+
+    // cached proofs passing through anything
+    // this block touched need to be re-opened
+    ledger.get_proof_cache().invalidate(versions);
+
+    std::vector<Node_ptr> nodes;
+    nodes.reserve(versions.size());
+    for (auto &id: versions) {
+        Result<Node_ptr, int> res = alloc.load_node(&id);
+        if (res.is_err()) {
+            rc = res.unwrap_err();
+            if (rc == MDB_NOTFOUND) continue;
+            return rc;
+        }
+
+        rc = res.unwrap()->justify(block_id);
+        if (rc != OK && rc != DELETED) return rc;
+        nodes.push_back(res.unwrap());
+    }
 
-    int res = root.unwrap()->justify(block_id);
-    return res == DELETED ? OK : res;
+    // snapshots read the cannonical trie off disk, 
+    // so write what this block changed now rather than on eviction
+    rc = alloc.promote_versions(block_id, nodes);
+    if (rc != OK) return rc;
+
+    rc = ledger.release_block(block_id);
+    if (rc != OK) return rc;
+    ledger.forget_shards(block_id);
+
+    // the root may have split, or split further
+    return ledger.drop_outside_shards();
 }
 
-// descends subtree and removes all nodes belonging to that block_id.
-// including leaf values
+// deletes every version this block has, without walking the trie
 int prune_block(Ledger &ledger, const Hash* block_hash) {
 
     uint16_t block_id = ledger.get_block_id(block_hash, false);
     if (block_id == 0) return BLOCK_NOT_EXIST;
     ledger.remove_block_id(block_hash);
+    ledger.forget_shards(block_id);
 
-    Result<Node_ptr, int> root = ledger.get_root(nullptr, block_id);
-    if (root.is_err()) {
-        int err = root.unwrap_err();
-        if (err == MDB_NOTFOUND) return OK;
-        return err;
-    }
-    return root.unwrap()->prune(block_id);
+    int rc = ledger.get_gadgets()->alloc.drop_versions(block_id);
+    if (rc != OK) return rc;
+
+    return ledger.release_block(block_id);
 }
 
 
@@ -145,9 +480,11 @@ int generate_proof(
     Ledger &ledger,
     std::vector<Commitment> &Cs, 
     std::vector<Proof> &Pis,
-    Bitmap<8>* split_map,
+    ProofShape* shape,
     const Hash* key_hash, 
-    const Hash* block_hash
+    const Hash* block_hash,
+    const std::vector<Proof>* reuse_Pis,
+    size_t stale
 ) {
     std::vector<Scalar_vec> Fxs; 
     Fxs.reserve(6);
@@ -162,32 +499,50 @@ int generate_proof(
     if (r.is_err()) return r.unwrap_err();
     Node_ptr root = r.unwrap();
 
-    int rc = root->generate_proof(key_hash, Fxs, Cs, split_map);
+    shape->skips.clear();
+    int rc = root->generate_proof(key_hash, Fxs, Cs, shape);
     if (rc != OK) return rc;
 
     size_t n = Fxs.size();
 
     // Build Commits via Fxs in parrallel
-    std::vector<std::future<LedgerCodes>> futures; 
-    futures.reserve(n);
+    const Gadgets_ptr gadgets = ledger.get_gadgets();
+    TaskGroup group(gadgets->pool);
+    std::vector<int> level_res(n, OK);
 
     // add one for key proof on leaf commitment
     Pis.resize(n + 1);
 
-    auto settings = ledger.get_gadgets()->settings;
+    const KZGSettings &settings = gadgets->settings;
+
+    // levels below this are unchanged since reuse_Pis was opened.
+    // splits add a level without consuming a nibble so count them too
+    size_t fresh_from = 0;
+    if (reuse_Pis && reuse_Pis->size() == n + 1) {
+        stale += shape->split_map.count();
+        if (stale < n) fresh_from = n - stale;
+    }
+
+    std::vector<size_t> at = opening_bytes(shape, n - 1);
 
-    uint8_t key_offset{};
     for (size_t i{}; i < n; i++) {
 
-        int key_idx = (n - 1) - i;
+        if (i < fresh_from) {
+            if (i == 0) Pis[0] = reuse_Pis->at(0);
+            Pis[i + 1] = reuse_Pis->at(i + 1);
+            continue;
+        }
 
-        futures.push_back(std::async(std::launch::async, [&, i, key_idx, key_offset] {
+        group.spawn([&, i] {
             byte nib;
 
             if (i == 0) {
                 // proof leaf commitment is linked to this key.
                 auto kzg_res = prove_kzg(Fxs[0], 0, settings);
-                if (!kzg_res.has_value()) return KZG_PROOF_ERR;
+                if (!kzg_res.has_value()) {
+                    level_res[i] = KZG_PROOF_ERR;
+                    return;
+                }
 
                 Pis[i] = kzg_res.value();
 
@@ -196,26 +551,24 @@ int generate_proof(
             } else {
 
                 // nibble propogating upward from leaf
-                nib = key_hash->h[key_idx - key_offset];
+                nib = key_hash->h[at[i - 1]];
             }
 
             auto kzg_res = prove_kzg(Fxs[i], nib, settings);
-            if (!kzg_res.has_value()) return KZG_PROOF_ERR;
+            if (!kzg_res.has_value()) {
+                level_res[i] = KZG_PROOF_ERR;
+                return;
+            }
 
             Pis[i + 1] = kzg_res.value();
-
-            return OK;
-        }));
-
-        // if there is a SPLIT in the proof we have to adjust
-        // our key index by one because of the reused nibble
-        if (split_map->is_set(key_idx)) key_offset++;
+        });
     }
 
 
+    group.wait();
+
     int res {OK};
-    for (auto &f : futures) {
-        int interm_res = f.get();
+    for (int interm_res: level_res) {
         if (interm_res != OK) {
             res = interm_res;
         }
@@ -224,11 +577,116 @@ int generate_proof(
     return res;
 }
 
+int generate_cached_proof(
+    Ledger &ledger,
+    const Hash* key_hash,
+    std::vector<byte> &out
+) {
+    ProofCache &cache = ledger.get_proof_cache();
+
+    uint8_t stale{};
+    std::optional<CachedProof> hit = cache.get(key_hash, &stale);
+    if (hit && stale == 0) {
+        out = std::move(hit->bytes);
+        return OK;
+    }
+
+    std::vector<Commitment> Cs;
+    std::vector<Proof> Pis;
+    ProofShape shape{};
+
+    std::vector<Proof> prev_Pis;
+    if (hit) {
+        std::vector<Commitment> prev_Cs;
+        ProofShape prev_shape{};
+        decode_proof(hit->bytes.data(), prev_Cs, prev_Pis, &prev_shape);
+    }
+
+    int rc = generate_proof(
+        ledger, Cs, Pis, &shape, key_hash, nullptr,
+        hit ? &prev_Pis : nullptr, stale
+    );
+    if (rc != OK) return rc;
+
+    out = encode_proof(Cs, Pis, &shape);
+    cache.put(key_hash, out);
+
+    return OK;
+}
+
+std::vector<byte> encode_proof(
+    const std::vector<Commitment> &Cs,
+    const std::vector<Proof> &Pis,
+    const ProofShape* shape
+) {
+    size_t total_size{};
+    total_size += sizeof(uint8_t);
+    total_size += (Cs.size() * sizeof(Commitment));
+    total_size += sizeof(uint8_t);
+    total_size += (Pis.size() * sizeof(Proof));
+    total_size += sizeof(uint8_t); // split_map
+    total_size += sizeof(uint8_t) + shape->skips.size(); // skips
+
+    std::vector<byte> out(total_size);
+    byte* cursor = out.data();
+
+    *cursor++ = Cs.size();
+    for (auto &commit: Cs) {
+        blst_p1_compress(cursor, &commit);
+        cursor += sizeof(Commitment);
+    }
+
+    *cursor++ = Pis.size();
+    for (auto &proof: Pis) {
+        blst_p1_compress(cursor, &proof);
+        cursor += sizeof(Proof);
+    }
+
+    *cursor++ = *shape->split_map.data_ptr();
+
+    *cursor++ = shape->skips.size();
+    for (uint8_t skip: shape->skips) *cursor++ = skip;
+
+    return out;
+}
+
+void decode_proof(
+    const byte* proof,
+    std::vector<Commitment> &Cs,
+    std::vector<Proof> &Pis,
+    ProofShape* shape
+) {
+    auto cursor = proof;
+
+    uint8_t Cs_size = *cursor;
+    cursor++;
+    Cs.resize(Cs_size);
+    for (auto &commit: Cs) {
+        commit = p1_from_bytes(cursor);
+        cursor += sizeof(Commitment);
+    }
+
+    uint8_t Pis_size = *cursor;
+    cursor++;
+    Pis.resize(Pis_size);
+    for (auto &proof: Pis) {
+        proof = p1_from_bytes(cursor);
+        cursor += sizeof(Proof);
+    }
+
+    shape->split_map = Bitmap<8>(cursor);
+    cursor++;
+
+    uint8_t skips_size = *cursor;
+    cursor++;
+    shape->skips.assign(cursor, cursor + skips_size);
+}
+
 bool valid_proof(
     Ledger &ledger,
     std::vector<Commitment>* Cs,
     std::vector<Proof>* Pis,
-    Bitmap<8>* split_map,
+    ProofShape* shape,
     const Hash* key_hash,
     const Hash* val_hash,
     const uint8_t val_idx,
@@ -237,7 +695,7 @@ bool valid_proof(
     std::vector<size_t> Zs;
     std::vector<blst_scalar> Ys;
 
-    derive_Zs_n_Ys(ledger, key_hash, val_hash, split_map, Cs, Pis, &Zs, &Ys);
+    derive_Zs_n_Ys(ledger, key_hash, val_hash, shape, Cs, Pis, &Zs, &Ys);
 
     auto tag = ledger.get_gadgets()->settings.tag;
     ByteSlice tag_slice((byte*)tag.data(), tag.size());
@@ -262,7 +720,7 @@ void derive_Zs_n_Ys(
     Ledger &ledger,
     const Hash* key_hash,
     const Hash* val_hash,
-    Bitmap<8>* split_map,
+    ProofShape* shape,
     std::vector<Commitment>* Cs,
     std::vector<Proof>* Pis,
     std::vector<size_t>* Zs,
@@ -276,7 +734,9 @@ void derive_Zs_n_Ys(
 
     blst_scalar s;
     auto tag = ledger.get_gadgets()->settings.tag;
-    uint8_t key_offset{};
+
+    std::vector<size_t> at = opening_bytes(shape, n < 2 ? 0 : n - 2);
+
     for (int k{}; k < n; k++) {
 
         if (k == 0) {
@@ -296,14 +756,11 @@ void derive_Zs_n_Ys(
             blst_scalar_from_le_bytes(&Ys->at(1), val_hash->h, 32);
 
         } else {
-            // if this is a split the next Z must be the same as now
-            // so we incrememnt key_offset which will be -1 for next
-            // iteration when deriving i again
-            int i = (n - 1) - k - key_offset;
-            if (split_map->is_set(i)) key_offset++;
+            // a proof that doesn't add up just fails to verify
+            size_t z = at[k - 2];
 
             // F(z) == H(Cs[k - 1])
-            Zs->at(k) = key_hash->h[i];
+            Zs->at(k) = z < 32 - 1 ? key_hash->h[z] : 0;
             hash_p1_to_scalar(&Cs->at(k - 1), &Ys->at(k), &tag);
         }
     }
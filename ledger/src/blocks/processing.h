@@ -20,10 +20,51 @@
 #include "kzg.h"
 #include "ledger.h"
 
+enum FinalizeMode : uint8_t {
+    // depth first, forking off dirty children with enough leaves under them
+    FINALIZE_FORK_JOIN = 0,
+
+    // bottom up a depth at a time over the blocks dirty set. 
+    // each level's commitments, hashes and writes are done as one batch.
+    // falls back to FINALIZE_FORK_JOIN if the set wasn't recorded
+    FINALIZE_LEVELS = 1,
+};
+
 int finalize_block(
     Ledger &ledger, 
     const Hash* block_hash,
-    Hash* out
+    Hash* out,
+    FinalizeMode mode = FINALIZE_LEVELS
+);
+
+/*
+ *  finalize_block for a ledger holding some of the root's ranges.
+ *  out gets a vote per range held here, to hand to the other shards.
+ *  the root is only committed once every range held elsewhere has
+ *  its hash in through insert_shard_hash, root_hash is set and OK
+ *  returned then, SHARDS_PENDING until then
+ */
+int finalize_shards(
+    Ledger &ledger, 
+    const Hash* block_hash,
+    std::vector<ShardVote> &out,
+    Hash* root_hash,
+    FinalizeMode mode = FINALIZE_LEVELS
+);
+
+// another shard's vote for the block, same returns as finalize_shards
+int insert_shard_hash(
+    Ledger &ledger,
+    const Hash* block_hash,
+    const ShardVote &vote,
+    Hash* root_hash
+);
+
+// ranges held elsewhere the block's root is still waiting on
+int missing_shards(
+    Ledger &ledger,
+    const Hash* block_hash,
+    std::vector<ShardRange> &out
 );
 
 int prune_block(
@@ -36,20 +77,44 @@ int justify_block(
     const Hash* block_hash
 );
 
+// reuse_Pis is a previous proof of the same key whose
+// openings below the top `stale` levels are still valid
 int generate_proof(
     Ledger &ledger, 
     std::vector<Commitment> &Cs,
     std::vector<Proof> &Pis,
-    Bitmap<8>* split_map,
+    ProofShape* shape,
     const Hash* key_hash,
-    const Hash* block_hash = nullptr
+    const Hash* block_hash = nullptr,
+    const std::vector<Proof>* reuse_Pis = nullptr,
+    size_t stale = 0
+);
+
+// proves against the cannonical root through the ledgers proof cache
+int generate_cached_proof(
+    Ledger &ledger,
+    const Hash* key_hash,
+    std::vector<byte> &out
+);
+
+std::vector<byte> encode_proof(
+    const std::vector<Commitment> &Cs,
+    const std::vector<Proof> &Pis,
+    const ProofShape* shape
+);
+
+void decode_proof(
+    const byte* proof,
+    std::vector<Commitment> &Cs,
+    std::vector<Proof> &Pis,
+    ProofShape* shape
 );
 
 bool valid_proof(
     Ledger &ledger,
     std::vector<Commitment>* Cs,
     std::vector<Proof>* Pis,
-    Bitmap<8>* split_map,
+    ProofShape* shape,
     const Hash* key_hash,
     const Hash* val_hash,
     const uint8_t val_idx,
@@ -60,7 +125,7 @@ void derive_Zs_n_Ys(
     Ledger &ledger,
     const Hash* key_hash,
     const Hash* val_hash,
-    Bitmap<8>* split_map,
+    ProofShape* shape,
     std::vector<Commitment>* Cs,
     std::vector<Proof>* Pis,
     std::vector<size_t>* Zs,
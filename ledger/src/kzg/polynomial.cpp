@@ -19,6 +19,7 @@
 #include "helpers.h"
 #include "polynomial.h"
 #include "kzg.h"
+#include <cassert>
 
 // ================== COMMIT POLYNOMIAL ==================
 // commits to f(x) via evaluating f(r)
@@ -38,6 +39,30 @@ void commit_g1(
     }
 }
 
+void commit_g1_msm(
+    blst_p1* C,
+    const Polynomial& coeffs, 
+    const SRS& srs
+) {
+    assert(coeffs.size() <= srs.g1_powers_aff.size());
+
+    size_t n = coeffs.size();
+    if (n == 0) {
+        *C = new_p1();
+        return;
+    }
+
+    thread_local std::vector<limb_t> scratch;
+    size_t scratch_limbs = blst_p1s_mult_pippenger_scratch_sizeof(n) / sizeof(limb_t);
+    if (scratch.size() < scratch_limbs) scratch.resize(scratch_limbs);
+
+    // a null second entry means the first points at a contiguous array
+    const blst_p1_affine* points[2] = {srs.g1_powers_aff.data(), nullptr};
+    const byte* scalars[2] = {coeffs.data()->b, nullptr};
+
+    blst_p1s_mult_pippenger(C, points, n, scalars, 256, scratch.data());
+}
+
 
 Polynomial multiply_binomial(const Polynomial &P, const blst_scalar &w) {
     size_t d = P.size();
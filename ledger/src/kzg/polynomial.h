@@ -24,6 +24,10 @@ using Polynomial = std::vector<blst_scalar>;
 
 void commit_g1(blst_p1* C, const Polynomial& coeffs, const SRS& srs);
 
+// same commitment as commit_g1 through a pippenger msm 
+// over the affine powers, scratch is kept per thread
+void commit_g1_msm(blst_p1* C, const Polynomial& coeffs, const SRS& srs);
+
 Polynomial multiply_binomial(
     const Polynomial &P,
     const blst_scalar &w
@@ -18,7 +18,9 @@
 
 #include "branch.h"
 #include "leaf.h"
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 NodeAllocator::NodeAllocator(
     std::string path, 
@@ -26,40 +28,234 @@ NodeAllocator::NodeAllocator(
     size_t map_size
 ) :
     db_(path.data(), map_size),
-    cache_(cache_size),
     gadgets_(nullptr)
 {
+    // cache_size split between them, but every partition needs
+    // room for a full path through its subtree, so a small
+    // cache ends up holding more than it asked for
+    size_t per_partition = std::max<size_t>(
+        (cache_size + CACHE_PARTITIONS - 1) / CACHE_PARTITIONS,
+        ID_PATH_SIZE + 1
+    );
+    for (auto &part: partitions_) 
+        part = std::make_unique<CachePartition>(per_partition);
 }
 
 NodeAllocator::~NodeAllocator() { }
 
-void NodeAllocator::persist_node(Node* node) {
-
+int NodeAllocator::write_node(const Node* node, void* trx) {
     const NodeId* id = node->get_id();
 
-    std::vector<byte> bytes = node->to_bytes();
+    // encode straight into the page lmdb hands back
+    void* out = nullptr;
+    size_t size = node->encoded_size();
+    int rc = db_.put_reserve(id->get_full(), id->size(), size, &out, trx);
+    if (rc != OK) return rc;
+
+    size_t written = node->encode(static_cast<byte*>(out));
+    assert(written == size);
+
+    uint16_t block_id = id->get_block_id();
+    if (block_id == 0) return OK;
+
+    return db_.put_version(block_id, id->get_full(), id->size(), trx);
+}
 
+void NodeAllocator::persist_node(Node* node) {
     void* trx = db_.start_txn();
-    int rc = db_.put(
-        id->get_full(), id->size(), 
-        bytes.data(), bytes.size(), 
-        trx
-    );
+    int rc = write_node(node, trx);
     assert(rc == OK);
     db_.end_txn(trx, rc);
 }
 
+int NodeAllocator::write_nodes(const std::vector<Node_ptr> &nodes) {
+    void* trx = db_.start_txn();
+
+    int rc{OK};
+    for (auto &node: nodes) {
+        rc = write_node(node.get(), trx);
+        if (rc != OK) break;
+    }
+    db_.end_txn(trx, rc);
+
+    return rc;
+}
+
+void NodeAllocator::mark_dirty(const NodeId* id) {
+    uint16_t block_id = id->get_block_id();
+    if (block_id == 0) return;
+
+    std::lock_guard lock(dirty_mux_);
+    dirty_[block_id].insert(*id);
+}
+
+void NodeAllocator::unmark_dirty(const NodeId* id) {
+    std::lock_guard lock(dirty_mux_);
+    auto it = dirty_.find(id->get_block_id());
+    if (it != dirty_.end()) it->second.erase(*id);
+}
+
+bool NodeAllocator::dirty_nodes(uint16_t block_id, std::vector<NodeId> &out) {
+    std::lock_guard lock(dirty_mux_);
+    auto it = dirty_.find(block_id);
+    if (it == dirty_.end()) return false;
+
+    out.insert(out.end(), it->second.begin(), it->second.end());
+    return true;
+}
+
+void NodeAllocator::clear_dirty(uint16_t block_id) {
+    std::lock_guard lock(dirty_mux_);
+    dirty_.erase(block_id);
+}
+
+int NodeAllocator::block_versions(uint16_t block_id, std::vector<NodeId> &out) {
+    std::vector<std::byte> written;
+
+    void* trx = db_.start_rd_txn();
+    int rc = db_.get_versions(block_id, written, trx);
+    db_.end_txn(trx, rc);
+    if (rc != OK) return rc;
+
+    for (size_t at{}; at + ID_SIZE <= written.size(); at += ID_SIZE) 
+        out.emplace_back(reinterpret_cast<const byte*>(written.data() + at));
+
+    // cached ones that were never written, or written since
+    dirty_nodes(block_id, out);
+
+    std::sort(out.begin(), out.end(), [](const NodeId &a, const NodeId &b) {
+        return std::memcmp(a.get_full(), b.get_full(), ID_SIZE) < 0;
+    });
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return OK;
+}
+
+void NodeAllocator::discard_cached(const NodeId* id) {
+    CachePartition &part = partition_of(id);
+
+    Node_ptr entry;
+    {
+        std::lock_guard lock(part.mux);
+        entry = part.cache.remove(*id);
+    }
+    if (entry) entry->discard();
+}
+
+int NodeAllocator::drop_versions(uint16_t block_id) {
+    std::vector<NodeId> versions;
+    int rc = block_versions(block_id, versions);
+    if (rc != OK) return rc;
+
+    for (auto &id: versions) discard_cached(&id);
+
+    void* trx = db_.start_txn();
+    for (auto &id: versions) {
+        rc = db_.del(id.get_full(), id.size(), trx);
+        if (rc == MDB_NOTFOUND) rc = OK;
+        if (rc != OK) break;
+    }
+    if (rc == OK) rc = db_.del_versions(block_id, trx);
+    db_.end_txn(trx, rc);
+    if (rc != OK) return rc;
+
+    clear_dirty(block_id);
+    return OK;
+}
+
+int NodeAllocator::promote_versions(uint16_t block_id, const std::vector<Node_ptr> &nodes) {
+    std::vector<Node_ptr> promoted;
+    promoted.reserve(nodes.size());
+
+    void* trx = db_.start_txn();
+
+    int rc{OK};
+    for (auto &node: nodes) {
+        NodeId id = *node->get_id();
+        NodeId canonical_id = id;
+        canonical_id.set_block_id(0);
+
+        rc = db_.del(id.get_full(), id.size(), trx);
+        if (rc != OK && rc != MDB_NOTFOUND) break;
+
+        evict_node(&id);
+
+        // the copy it replaces would write itself back over it
+        discard_cached(&canonical_id);
+
+        if (node->should_delete()) {
+            rc = db_.del(canonical_id.get_full(), canonical_id.size(), trx);
+            if (rc != OK && rc != MDB_NOTFOUND) break;
+            rc = OK;
+            continue;
+        }
+
+        node->set_id(&canonical_id);
+        rc = write_node(node.get(), trx);
+        if (rc != OK) break;
+
+        promoted.push_back(node);
+    }
+    if (rc == OK) rc = db_.del_versions(block_id, trx);
+    db_.end_txn(trx, rc);
+    if (rc != OK) return rc;
+
+    for (auto &node: promoted) cache_insert(node);
+    clear_dirty(block_id);
+
+    return OK;
+}
+
+int NodeAllocator::copy_versions(const std::vector<Node_ptr> &nodes) {
+    void* trx = db_.start_txn();
+
+    int rc{OK};
+    for (auto &node: nodes) {
+        NodeId id = *node->get_id();
+        NodeId canonical_id = id;
+        canonical_id.set_block_id(0);
+
+        // the copy it replaces would write itself back over it
+        discard_cached(&canonical_id);
+
+        if (node->should_delete()) {
+            rc = db_.del(canonical_id.get_full(), canonical_id.size(), trx);
+            if (rc != OK && rc != MDB_NOTFOUND) break;
+            rc = OK;
+            continue;
+        }
+
+        node->set_id(&canonical_id);
+        rc = write_node(node.get(), trx);
+        node->set_id(&id);
+        if (rc != OK) break;
+    }
+    db_.end_txn(trx, rc);
+
+    return rc;
+}
+
 void NodeAllocator::set_gadgets(std::shared_ptr<Gadgets> gadgets) { 
     gadgets_ = gadgets; 
 }
 
-Node_ptr NodeAllocator::cache_node(
-    Node_ptr node, 
-    bool needs_lock
-) {
-    if (needs_lock) mux_.lock();
-    auto put_res = cache_.put(node->get_id(), node);
-    if (needs_lock) mux_.unlock();
+CachePartition& NodeAllocator::partition_of(const NodeId* id) {
+    if (id->get_level() == 0) return *partitions_[ROOT_PARTITION];
+    return *partitions_[id->get_full()[0]];
+}
+
+Node_ptr NodeAllocator::cache_node(Node_ptr node) {
+    mark_dirty(node->get_id());
+    return cache_insert(node);
+}
+
+Node_ptr NodeAllocator::cache_insert(Node_ptr node) {
+    CachePartition &part = partition_of(node->get_id());
+
+    std::optional<std::tuple<NodeId, Node_ptr>> put_res;
+    {
+        std::lock_guard lock(part.mux);
+        put_res = part.cache.put(node->get_id(), node);
+    }
 
     if (put_res.has_value()) {
         // put_res can have an evicted node but
@@ -72,100 +268,106 @@ Node_ptr NodeAllocator::cache_node(
 }
 
 int NodeAllocator::recache(
+    Node* node,
     const NodeId *old_id, 
-    const NodeId *new_id, 
-    bool needs_lock
+    const NodeId *new_id
 ) {
-    if (needs_lock) mux_.lock();
-    Node_ptr entry = cache_.remove(old_id);
-    if (needs_lock) mux_.unlock();
-    if (entry == nullptr) return NOT_EXIST_RECACHE;
-    // if its not in cache we can just return OK
-    // it will be deconstructed and therefore persisted...
-
-    std::vector<byte> node_bytes = entry->to_bytes();
-    void* trx = db_.start_txn();
-    int rc = db_.put(
-        entry->get_id()->get_full(), entry->get_id()->size(), 
-        node_bytes.data(), node_bytes.size(), 
-        trx
-    );
-    db_.end_txn(trx, rc);
-    if (rc != OK) return rc;
+    // the caller holds node, so it is alive even if it was evicted
+    Node_ptr entry(node);
+    {
+        CachePartition &part = partition_of(old_id);
+        std::lock_guard lock(part.mux);
+        part.cache.remove(*old_id);
+    }
+
+    // another block's, or the cannonical, version stays readable as a
+    // copy. it's written when evicted, or by its own block's finalize,
+    // unless it's on disk already. a block's own old version is done with
+    if (old_id->get_block_id() != new_id->get_block_id()) {
+        Node_ptr old = entry->clone();
+        old->synced_ = entry->synced_;
+        cache_insert(old);
+    }
 
+    entry->synced_ = false;
     entry->set_id(new_id);
-    Node_ptr maybe_evicted = cache_node(entry, needs_lock);
+    Node_ptr maybe_evicted = cache_node(entry);
 
     return OK;
 }
 
 
-Result<Node_ptr, int> NodeAllocator::load_node(
-    const NodeId* id, 
-    bool needs_lock
-) {
+Result<Node_ptr, int> NodeAllocator::load_node(const NodeId* id) {
 
-    if (needs_lock) mux_.lock_shared();
-    Node_ptr* node = cache_.get(id);
-    if (needs_lock) mux_.unlock_shared();
-    if (node) return *node;
+    Node_ptr cached = peek_node(id);
+    if (cached) return cached;
 
-    std::vector<byte> out;
-    void* out_data = nullptr;
+    const void* data = nullptr;
     size_t size = 0;
+    Node_ptr node_ptr;
 
+    // decode straight off the page,
+    // the constructors copy out what they keep
     void* trx = db_.start_rd_txn();
-    int rc = db_.get_raw(id->get_full(), id->size(), &out_data, &size, trx);
+    int rc = db_.get_view(id->get_full(), id->size(), &data, &size, trx);
     if (rc == 0) {
-        out.resize(size);
-        std::memcpy(out.data(), out_data, size);
-        free(out_data);  // avoid memory leak
-    }
-    db_.end_txn(trx, rc);
-
-    if (rc == 0) {
-        ByteSlice raw_node(out.data(), out.size());
-        Node_ptr node_ptr;
+        ByteSlice raw_node((byte*)data, size);
 
-        if (raw_node[0] == BRANCH)
+        if (is_branch_type(raw_node[0]))
             node_ptr = create_branch(gadgets_, id, &raw_node);
         else
             node_ptr = create_leaf(gadgets_, id, &raw_node);
+    }
+    db_.end_txn(trx, rc);
 
-        // Insert into cache (cache now owns the unique_ptr)
-        cache_node(node_ptr, needs_lock);
+    if (rc != 0) return rc;
 
-        return node_ptr;
-    }
+    // Insert into cache (cache now owns the node).
+    // already on disk so not something this process dirtied
+    node_ptr->synced_ = id->get_block_id() == 0;
+    cache_insert(node_ptr);
 
-    return rc;
+    return node_ptr;
 }
 
-Result<Node_ptr, int> NodeAllocator::delete_node(
-    const NodeId* id,
-    bool need_lock
-) {
-    if (need_lock) mux_.lock();
+Node_ptr NodeAllocator::peek_node(const NodeId* id) {
+    CachePartition &part = partition_of(id);
+
+    std::lock_guard lock(part.mux);
+    Node_ptr* node = part.cache.get(*id);
+    return node ? *node : nullptr;
+}
+
+void NodeAllocator::evict_node(const NodeId* id) {
+    CachePartition &part = partition_of(id);
+
+    std::lock_guard lock(part.mux);
+    part.cache.remove(*id);
+}
+
+Result<Node_ptr, int> NodeAllocator::delete_node(const NodeId* id) {
+    CachePartition &part = partition_of(id);
+    unmark_dirty(id);
+
+    Node_ptr entry;
+    {
+        std::lock_guard lock(part.mux);
+        entry = part.cache.remove(*id);
+    }
 
-    Node_ptr entry = cache_.remove(*id);
     if (!entry) {
         Result<Node_ptr, int> res = load_node(id);
-        if (res.is_ok()) {
-            entry = cache_.remove(*id);
-        } else {
-            if (need_lock) mux_.unlock();
-            return res.unwrap_err();
-        }
+        if (res.is_err()) return res.unwrap_err();
+
+        std::lock_guard lock(part.mux);
+        entry = part.cache.remove(*id);
     }
+
     if (entry) {
         void* trx = db_.start_txn();
         int rc = db_.del(id->get_full(), id->size(), trx);
         db_.end_txn(trx, rc);
-        if (rc != OK && rc != MDB_NOTFOUND) {
-            if (need_lock) mux_.unlock();
-            return rc;
-        }
+        if (rc != OK && rc != MDB_NOTFOUND) return rc;
     }
-    if (need_lock) mux_.unlock();
     return entry;
 }
@@ -21,9 +21,31 @@
 #include "db.h"
 #include "lru.h"
 #include "result.h"
+#include "slab.h"
+#include <array>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 struct Gadgets;
 
+/*
+ *  The node cache is split by the first path byte of the id,
+ *  which below the root is the root child a node lives under,
+ *  one partition per root child and one more for the root. 
+ *  Each partition has its own lock and LRU, so threads working
+ *  different root subtrees don't contend, or evict each others nodes.
+ */
+const size_t CACHE_PARTITIONS = BRANCH_ORDER + 1;
+const size_t ROOT_PARTITION = BRANCH_ORDER;
+
+struct CachePartition {
+    std::mutex mux;
+    LRUCache<NodeId, Node_ptr, NodeIdHash> cache;
+
+    explicit CachePartition(size_t capacity) : cache(capacity) {}
+};
+
 class NodeAllocator {
 public:
     NodeAllocator(
@@ -33,22 +55,94 @@ public:
     );
     ~NodeAllocator();
 
-    std::shared_mutex mux_;
-    LRUCache<NodeId, std::shared_ptr<Node>, NodeIdHash> cache_;
+    // declared before partitions_ so it outlives every cached node
+    SlabAllocator slabs_;
+    std::array<std::unique_ptr<CachePartition>, CACHE_PARTITIONS> partitions_;
     BulletDB db_;
     std::shared_ptr<Gadgets> gadgets_;
 
+    // ids each pending block has its own version of,
+    // recorded as they are created so finalize needn't search
+    std::mutex dirty_mux_;
+    std::unordered_map<uint16_t, std::unordered_set<NodeId, NodeIdHash>> dirty_;
+
+    // cache_node without marking, for nodes read back from disk
+    Node_ptr cache_insert(Node_ptr node);
+
     void set_gadgets(std::shared_ptr<Gadgets> gadgets);
 
-    Result<std::shared_ptr<Node>, int> load_node(
-        const NodeId* id, 
-        bool needs_lock = false
-    );
-    Result<std::shared_ptr<Node>, int> delete_node(
-        const NodeId* id,
-        bool needs_lock = false
-    );
-    int recache(const NodeId *old_id, const NodeId *new_id, bool needs_lock = false);
-    Node_ptr cache_node(std::shared_ptr<Node> node, bool needs_lock = false);
+    CachePartition& partition_of(const NodeId* id);
+
+    Result<Node_ptr, int> load_node(const NodeId* id);
+
+    // cache only, nullptr on a miss
+    Node_ptr peek_node(const NodeId* id);
+
+    Result<Node_ptr, int> delete_node(const NodeId* id);
+
+    // drops the cached copy, if any, without writing it back
+    void evict_node(const NodeId* id);
+
+    // moves node from old_id to new_id, nothing is written. 
+    // another block's old version stays cached under old_id as a copy
+    int recache(Node* node, const NodeId *old_id, const NodeId *new_id);
+    // for nodes created or moved by a block, they're marked dirty
+    Node_ptr cache_node(Node_ptr node);
     void persist_node(Node* node);
+
+    // all in one transaction
+    int write_nodes(const std::vector<Node_ptr> &nodes);
+
+    // no-op for canonical (block 0) ids
+    void mark_dirty(const NodeId* id);
+    void unmark_dirty(const NodeId* id);
+
+    // false if nothing was recorded for block_id, 
+    // e.g. its nodes were made before a restart
+    bool dirty_nodes(uint16_t block_id, std::vector<NodeId> &out);
+    void clear_dirty(uint16_t block_id);
+
+    // every id block_id has its own version of, sorted. the
+    // versions index has the written ones, dirty_ the cached ones
+    int block_versions(uint16_t block_id, std::vector<NodeId> &out);
+
+    // deletes every version block_id has in one txn,
+    // cached copies are discarded rather than written back
+    int drop_versions(uint16_t block_id);
+
+    // moves each of nodes, block_id's versions, under its cannonical id 
+    // in one txn. ones the block removed have its cannonical id deleted too
+    int promote_versions(uint16_t block_id, const std::vector<Node_ptr> &nodes);
+
+    // writes each of nodes under its cannonical id as well in one txn,
+    // leaving the block's own version for whatever still links to it
+    int copy_versions(const std::vector<Node_ptr> &nodes);
+
+    // drops the cached copy, if any, and empties it so it's never written
+    void discard_cached(const NodeId* id);
+
+    // node under its own id, in the callers txn
+    int write_node(const Node* node, void* trx);
+
+    template <typename T, typename... Args>
+    Ref<T> make_node(Args&&... args) {
+        static_assert(alignof(T) <= SLAB_ALIGN);
+
+        SlabClass* slab = slabs_.class_for(sizeof(T));
+        void* mem = slab ? slab->allocate() : ::operator new(sizeof(T));
+
+        T* node = nullptr;
+        try {
+            node = new (mem) T(std::forward<Args>(args)...);
+        } catch (...) {
+            if (slab) slab->deallocate(mem);
+            else ::operator delete(mem);
+            throw;
+        }
+        node->slab_ = slab;
+
+        return Ref<T>(node);
+    }
+
+    std::vector<SlabStats> alloc_stats() { return slabs_.stats(); }
 };
@@ -0,0 +1,332 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bulk_load.h"
+#include "branch.h"
+#include "fft.h"
+#include "helpers.h"
+#include "polynomial.h"
+#include "state_types.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+
+// closed nodes held before they are committed and written
+const size_t BULK_FLUSH_NODES = 1 << 14;
+
+// nodes a task hashes at a time
+const size_t BULK_HASH_CHUNK = 64;
+
+// the last byte of a key is its slot
+const size_t STEM_SIZE = 32 - 1;
+
+static size_t shared_prefix(const Hash &a, const Hash &b) {
+    size_t i{};
+    while (i < STEM_SIZE && a.h[i] == b.h[i]) i++;
+    return i;
+}
+
+BulkLoader::BulkLoader(
+    Gadgets_ptr gadgets, 
+    ProofCache &proof_cache, 
+    const NodeId &root_id
+) :
+    gadgets_(gadgets),
+    proof_cache_(proof_cache),
+    root_id_(root_id),
+    last_key_(new_hash()),
+    has_last_{},
+    finished_{},
+    root_sk_(ZERO_SK)
+{
+    auto root = std::make_unique<BuiltNode>();
+    root->id = root_id;
+    root->is_leaf = false;
+    root->parent = nullptr;
+    root->parent_idx = 0;
+    root->key_level = root_id.get_level();
+    open_.push_back(std::move(root));
+}
+
+int BulkLoader::add(const Hash* key_hash, uint8_t slot, const Hash* val_hash) {
+    if (finished_) return INVALID_OPS_BUFFER;
+    if (slot >= LEAF_ORDER) return VAL_IDX_RANGE;
+
+    // keys outside the root's path belong to another shard
+    size_t root_len = std::min<size_t>(root_id_.get_level(), ID_PATH_SIZE);
+    if (std::memcmp(key_hash->h, root_id_.get_full(), root_len) != 0) return NOT_IN_SHARD;
+
+    Hash key = *key_hash;
+    key.h[STEM_SIZE] = slot;
+
+    // slot 0 is the account's own stem,
+    // as Leaf::set_path puts it there
+    Hash stem = key;
+    stem.h[STEM_SIZE] = 0;
+    if (slot == 0 && !hash_is_zero(*val_hash) && !(*val_hash == stem)) return LEAF_IDX_ZERO;
+
+    if (has_last_ && std::memcmp(last_key_.h, key.h, 32) >= 0) return UNSORTED_KEYS;
+    last_key_ = key;
+    has_last_ = true;
+
+    // nothing to commit to
+    if (hash_is_zero(*val_hash)) return OK;
+
+    size_t shared = leaf_ ? shared_prefix(leaf_->path, key) : STEM_SIZE;
+    if (shared < STEM_SIZE) {
+        place_leaf(shared);
+
+        if (closed_.size() >= BULK_FLUSH_NODES) {
+            int rc = flush();
+            if (rc != OK) return rc;
+        }
+    }
+
+    if (!leaf_) {
+        leaf_ = std::make_unique<BuiltNode>();
+        leaf_->is_leaf = true;
+        leaf_->path = stem;
+        leaf_->slots.push_back({0, 0, stem});
+    }
+
+    if (slot != 0) leaf_->slots.push_back({slot, 0, *val_hash});
+    return OK;
+}
+
+BulkLoader::BuiltNode_ptr BulkLoader::open_branch(const Hash &path, size_t key_level) {
+    auto branch = std::make_unique<BuiltNode>();
+    branch->is_leaf = false;
+    branch->parent = nullptr;
+    branch->parent_idx = 0;
+    branch->key_level = key_level;
+    branch->path = path;
+    return branch;
+}
+
+// a child's id is its own path down to one past its parent's key byte
+void BulkLoader::attach(BuiltNode* child, BuiltNode* parent) {
+    byte nib = child->path.h[parent->key_level];
+
+    child->id = NodeId();
+    child->id.append_path(child->path.h, parent->key_level + 1);
+    child->parent = parent;
+    child->parent_idx = parent->children.size();
+
+    parent->children.push_back({nib, nib, ZERO_SK, 0, {}});
+}
+
+// the stream has moved on to paths sharing only level bytes,
+// branches going down on anything deeper are done
+void BulkLoader::close_to(size_t level) {
+    while (open_.back()->key_level > level) {
+        BuiltNode_ptr node = std::move(open_.back());
+        open_.pop_back();
+
+        // what comes next shares more with it than its parent does,
+        // so a branch goes in between on the byte they part at
+        if (open_.back()->key_level < level) 
+            open_.push_back(open_branch(node->path, level));
+
+        attach(node.get(), open_.back().get());
+        closed_.push_back(std::move(node));
+    }
+}
+
+void BulkLoader::place_leaf(size_t next_shared) {
+    next_shared = std::max<size_t>(next_shared, root_id_.get_level());
+
+    // hangs off the branch on the byte it parts from either 
+    // neighbour at, the one it shares with the last is open
+    if (open_.back()->key_level < next_shared) 
+        open_.push_back(open_branch(leaf_->path, next_shared));
+
+    attach(leaf_.get(), open_.back().get());
+    closed_.push_back(std::move(leaf_));
+
+    close_to(next_shared);
+}
+
+static void built_evals(
+    const std::vector<LeafSlot> &slots,
+    const std::vector<Child> &children,
+    Polynomial &poly
+) {
+    for (auto &slot: slots) 
+        blst_scalar_from_le_bytes(&poly[slot.nib], slot.hash.h, 32);
+    for (auto &child: children) 
+        poly[child.anchor] = child.sk;
+}
+
+// what a built node takes written, by the layouts nodes are written in
+static size_t built_size(
+    bool is_leaf, 
+    size_t ext_size,
+    const std::vector<LeafSlot> &slots,
+    const std::vector<Child> &children
+) {
+    if (is_leaf) return leaf_encoded_size(slots.data(), slots.size());
+    return branch_encoded_size(ext_size, children.size(), false, 0);
+}
+
+int BulkLoader::flush() {
+    if (closed_.empty()) return OK;
+
+    const KZGSettings &settings = gadgets_->settings;
+    const std::string* tag = &settings.tag;
+
+    // a parent is always closed after its children, 
+    // deepest first has every scalar in before it's needed
+    std::stable_sort(closed_.begin(), closed_.end(), [](auto &a, auto &b) {
+        return a->id.get_level() > b->id.get_level();
+    });
+
+    size_t begin{};
+    while (begin < closed_.size()) {
+        uint8_t level = closed_[begin]->id.get_level();
+        size_t end = begin;
+        while (end < closed_.size() && closed_[end]->id.get_level() == level) end++;
+
+        size_t n = end - begin;
+        std::vector<blst_p1> commits(n);
+        {
+            TaskGroup tasks(gadgets_->pool);
+            for (size_t i{}; i < n; i++) {
+                tasks.spawn([&, i] {
+                    BuiltNode* node = closed_[begin + i].get();
+
+                    Polynomial poly(BRANCH_ORDER, ZERO_SK);
+                    built_evals(node->slots, node->children, poly);
+                    inverse_fft_in_place(poly, settings.roots.inv_roots);
+                    commit_g1_msm(&commits[i], poly, settings.setup);
+                });
+            }
+            tasks.wait();
+        }
+
+        // one shared inversion for the level,
+        // the point at infinity has no affine form so it stays lazy
+        std::vector<const blst_p1*> finite;
+        std::vector<size_t> finite_idx;
+        for (size_t i{}; i < n; i++) {
+            if (blst_p1_is_inf(&commits[i])) {
+                closed_[begin + i]->commit.set(commits[i]);
+                continue;
+            }
+            finite.push_back(&commits[i]);
+            finite_idx.push_back(i);
+        }
+
+        std::vector<blst_p1_affine> affs(finite.size());
+        if (!finite.empty()) 
+            blst_p1s_to_affine(affs.data(), finite.data(), finite.size());
+        for (size_t k{}; k < finite.size(); k++) 
+            closed_[begin + finite_idx[k]]->commit.set(commits[finite_idx[k]], affs[k]);
+
+        {
+            TaskGroup tasks(gadgets_->pool);
+            for (size_t c = begin; c < end; c += BULK_HASH_CHUNK) {
+                tasks.spawn([&, c] {
+                    size_t stop = std::min(c + BULK_HASH_CHUNK, end);
+                    for (size_t i = c; i < stop; i++) closed_[i]->commit.scalar(tag);
+                });
+            }
+            tasks.wait();
+        }
+
+        for (size_t i = begin; i < end; i++) {
+            BuiltNode* node = closed_[i].get();
+            const blst_scalar* sk = node->commit.scalar(tag);
+
+            if (!node->parent) {
+                root_sk_ = *sk;
+                continue;
+            }
+            Child &in_parent = node->parent->children[node->parent_idx];
+            in_parent.sk = *sk;
+
+            // its children's are all in by now, as with the scalars
+            size_t ext_size = node->is_leaf ? 0 : node->key_level - node->id.get_level();
+            Weight weight{
+                node->is_leaf ? 1u : 0u, 
+                built_size(node->is_leaf, ext_size, node->slots, node->children)
+            };
+            for (auto &child: node->children) weight += child.weight;
+            in_parent.weight = weight;
+        }
+
+        begin = end;
+    }
+
+    // written in key order, pages fill front to back
+    std::sort(closed_.begin(), closed_.end(), [](auto &a, auto &b) {
+        return std::memcmp(a->id.get_full(), b->id.get_full(), ID_SIZE) < 0;
+    });
+
+    BulletDB &db = gadgets_->alloc.db_;
+    void* trx = db.start_txn();
+
+    int rc{OK};
+    std::vector<byte> bytes;
+    for (auto &node: closed_) {
+        // the root is never given one
+        size_t level = node->id.get_level();
+        size_t ext_size = node->is_leaf || !node->parent ? 0 : node->key_level - level;
+
+        bytes.resize(built_size(node->is_leaf, ext_size, node->slots, node->children));
+        if (node->is_leaf) {
+            uint8_t count = node->slots.size();
+            encode_leaf(
+                bytes.data(), node->commit, tag, node->path, 
+                count, node->slots.data(), node->slots.size()
+            );
+        } else {
+            encode_branch(
+                bytes.data(), false, node->commit, tag,
+                node->path.h + level, ext_size, node->children, {}
+            );
+        }
+
+        rc = db.put(node->id.get_full(), node->id.size(), bytes.data(), bytes.size(), trx);
+        if (rc != OK) break;
+    }
+    db.end_txn(trx, rc);
+
+    closed_.clear();
+    return rc;
+}
+
+int BulkLoader::finish(Hash* root_hash) {
+    if (finished_) return INVALID_OPS_BUFFER;
+    finished_ = true;
+
+    // everything down from the root is done
+    if (leaf_) place_leaf(0);
+    close_to(root_id_.get_level());
+    closed_.push_back(std::move(open_.front()));
+    open_.clear();
+
+    int rc = flush();
+    if (rc != OK) return rc;
+
+    // a root read before the load is stale, as is any proof of it
+    gadgets_->alloc.evict_node(&root_id_);
+    proof_cache_.invalidate_all();
+
+    std::memcpy(root_hash->h, root_sk_.b, sizeof(root_hash->h));
+    return OK;
+}
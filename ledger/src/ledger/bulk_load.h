@@ -0,0 +1,117 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  Builds the cannonical trie bottom up from a sorted stream,
+ *  for genesis and imports into an empty ledger.
+ *
+ *  With the keys sorted a leaf's level is fixed by its neighbours,
+ *  one past the longest path it shares with either. So the loader
+ *  only holds the branches on the current path open. Once the stream
+ *  moves past a branch it can never gain another child, it's closed
+ *  and its commitment can be worked out.
+ *
+ *  Branches only exist where paths part, with the bytes in between
+ *  as their extension. Where one starts depends on its parent, which
+ *  may only show up after it, so a node gets its id as it's attached.
+ *
+ *  Closed nodes wait in a batch. A flush commits the batch deepest
+ *  level first, each level's msms in parallel on the pool, hands the
+ *  scalars up to the parents, then writes the whole batch in one txn
+ *  in key order. Every node is committed and written exactly once,
+ *  and no node objects or cache are involved.
+ */
+
+#pragma once
+#include "gadgets.h"
+#include "hashing.h"
+#include "lazy_commitment.h"
+#include "leaf.h"
+#include "nodeid.h"
+#include "proof_cache.h"
+#include <memory>
+#include <vector>
+
+class BulkLoader {
+private:
+    struct BuiltNode {
+        NodeId id;
+        bool is_leaf;
+        LazyCommitment commit;
+
+        // leaf: its slots, branch: a child per anchor 
+        // with its scalar and subtree's weight
+        std::vector<LeafSlot> slots;
+        std::vector<Child> children;
+
+        // where the scalar goes once committed, null for the root
+        BuiltNode* parent;
+        size_t parent_idx;
+
+        // branch: the key byte it goes down on, past its extension
+        size_t key_level;
+
+        // leaf: its stem, branch: any stem under it
+        Hash path;
+    };
+    using BuiltNode_ptr = std::unique_ptr<BuiltNode>;
+
+    Gadgets_ptr gadgets_;
+    ProofCache &proof_cache_;
+    NodeId root_id_;
+
+    // open branches from the root down, by key level
+    std::vector<BuiltNode_ptr> open_;
+
+    // closed, waiting for the next flush
+    std::vector<BuiltNode_ptr> closed_;
+
+    // the leaf being filled, placed once the next stem shows 
+    // how much it shares with it
+    BuiltNode_ptr leaf_;
+
+    Hash last_key_;
+    bool has_last_;
+    bool finished_;
+    blst_scalar root_sk_;
+
+    BuiltNode_ptr open_branch(const Hash &path, size_t key_level);
+    void attach(BuiltNode* child, BuiltNode* parent);
+    void place_leaf(size_t next_shared);
+    void close_to(size_t level);
+    int flush();
+
+public:
+    BulkLoader(
+        Gadgets_ptr gadgets, 
+        ProofCache &proof_cache, 
+        const NodeId &root_id
+    );
+
+    BulkLoader(const BulkLoader&) = delete;
+    BulkLoader& operator=(const BulkLoader&) = delete;
+
+    // entries strictly increasing by key hash then slot, 
+    // the key hash's last byte is ignored for the slot.
+    // an account is created with its first entry, slot 0 
+    // holds its stem and may be passed or left out
+    int add(const Hash* key_hash, uint8_t slot, const Hash* val_hash);
+
+    // closes the remaining path, writes it and gives the root hash
+    int finish(Hash* root_hash);
+};
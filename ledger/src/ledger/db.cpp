@@ -25,14 +25,30 @@
 BulletDB::BulletDB(const char* path, size_t map_size) {
     assert(mdb_env_create(&env_) == 0);
     assert(mdb_env_set_mapsize(env_, map_size) == 0);
-    assert(mdb_env_open(env_, path, 0, 0600) == 0);
+    assert(mdb_env_set_maxdbs(env_, 2) == 0);
+    // read txns are tied to snapshots rather than threads
+    assert(mdb_env_open(env_, path, MDB_NOTLS, 0600) == 0);
 
     void* trx = start_txn();
     assert(mdb_dbi_open((MDB_txn*)trx, nullptr, 0, &dbi_) == 0);
+
+    // every id is the same size, so the dups are kept packed
+    assert(mdb_dbi_open(
+        (MDB_txn*)trx, "versions", 
+        MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, 
+        &versions_dbi_
+    ) == 0);
+    assert(mdb_dbi_open(
+        (MDB_txn*)trx, "remaps", 
+        MDB_CREATE | MDB_INTEGERKEY, 
+        &remaps_dbi_
+    ) == 0);
     end_txn(trx);
 }
 
 BulletDB::~BulletDB() {
+    mdb_dbi_close(env_, remaps_dbi_);
+    mdb_dbi_close(env_, versions_dbi_);
     mdb_dbi_close(env_, dbi_);
     mdb_env_close(env_);
 }
@@ -67,6 +83,19 @@ int BulletDB::put(
     return mdb_put((MDB_txn*)trx, dbi_, &key, &value, 0);
 }
 
+int BulletDB::put_reserve(
+    const void* key_data, size_t key_size, 
+    size_t value_size, void** value_data,
+    void* trx
+) {
+    MDB_val key{ key_size, (void*)(key_data) };
+    MDB_val value{ value_size, nullptr };
+
+    int rc = mdb_put((MDB_txn*)trx, dbi_, &key, &value, MDB_RESERVE);
+    if (rc == 0) *value_data = value.mv_data;
+    return rc;
+}
+
 int BulletDB::get_raw(
     const void* key_data, size_t key_size, 
     void** value_data, size_t* value_size,
@@ -84,6 +113,22 @@ int BulletDB::get_raw(
     return rc;
 }
 
+int BulletDB::get_view(
+    const void* key_data, size_t key_size, 
+    const void** value_data, size_t* value_size,
+    void* trx
+) {
+    MDB_val key{ key_size, (void*)(key_data) };
+    MDB_val value;
+
+    int rc = mdb_get((MDB_txn*)trx, dbi_, &key, &value);
+    if (rc == 0) {
+        *value_size = value.mv_size;
+        *value_data = value.mv_data;
+    }
+    return rc;
+}
+
 int BulletDB::get(
     const void* key_data, size_t key_size, 
     std::vector<std::byte> &out,
@@ -100,6 +145,146 @@ int BulletDB::get(
     return rc;
 }
 
+int BulletDB::open_cursor(void* trx, void** cursor) {
+    MDB_cursor* cur;
+    int rc = mdb_cursor_open((MDB_txn*)trx, dbi_, &cur);
+    if (rc == 0) *cursor = cur;
+    return rc;
+}
+
+void BulletDB::close_cursor(void* cursor) {
+    mdb_cursor_close((MDB_cursor*)cursor);
+}
+
+static int cursor_get(
+    void* cursor, MDB_val* key, MDB_cursor_op op,
+    const void** key_out, size_t* key_out_size,
+    const void** value_data, size_t* value_size
+) {
+    MDB_val value;
+
+    int rc = mdb_cursor_get((MDB_cursor*)cursor, key, &value, op);
+    if (rc == 0) {
+        *key_out = key->mv_data;
+        *key_out_size = key->mv_size;
+        *value_data = value.mv_data;
+        *value_size = value.mv_size;
+    }
+    return rc;
+}
+
+int BulletDB::cursor_seek(
+    void* cursor,
+    const void* key_data, size_t key_size,
+    const void** key_out, size_t* key_out_size,
+    const void** value_data, size_t* value_size
+) {
+    MDB_val key{ key_size, (void*)(key_data) };
+    return cursor_get(cursor, &key, MDB_SET_RANGE, key_out, key_out_size, value_data, value_size);
+}
+
+int BulletDB::cursor_next(
+    void* cursor,
+    const void** key_out, size_t* key_out_size,
+    const void** value_data, size_t* value_size
+) {
+    MDB_val key;
+    return cursor_get(cursor, &key, MDB_NEXT, key_out, key_out_size, value_data, value_size);
+}
+
+int BulletDB::put_version(uint16_t block_id, const void* id, size_t id_size, void* trx) {
+    MDB_val key{ sizeof(block_id), &block_id };
+    MDB_val value{ id_size, (void*)(id) };
+
+    // an id already there is left as is
+    return mdb_put((MDB_txn*)trx, versions_dbi_, &key, &value, 0);
+}
+
+int BulletDB::get_versions(uint16_t block_id, std::vector<std::byte> &out, void* trx) {
+    MDB_cursor* cur;
+    int rc = mdb_cursor_open((MDB_txn*)trx, versions_dbi_, &cur);
+    if (rc != 0) return rc;
+
+    MDB_val key{ sizeof(block_id), &block_id };
+    MDB_val value;
+
+    rc = mdb_cursor_get(cur, &key, &value, MDB_SET);
+    while (rc == 0) {
+        const std::byte* id = static_cast<const std::byte*>(value.mv_data);
+        out.insert(out.end(), id, id + value.mv_size);
+        rc = mdb_cursor_get(cur, &key, &value, MDB_NEXT_DUP);
+    }
+    mdb_cursor_close(cur);
+
+    return rc == MDB_NOTFOUND ? 0 : rc;
+}
+
+int BulletDB::del_versions(uint16_t block_id, void* trx) {
+    MDB_val key{ sizeof(block_id), &block_id };
+
+    int rc = mdb_del((MDB_txn*)trx, versions_dbi_, &key, nullptr);
+    return rc == MDB_NOTFOUND ? 0 : rc;
+}
+
+int BulletDB::clear_versions() {
+    void* trx = start_txn();
+
+    MDB_cursor* cur;
+    int rc = mdb_cursor_open((MDB_txn*)trx, versions_dbi_, &cur);
+    if (rc != 0) {
+        end_txn(trx, rc);
+        return rc;
+    }
+
+    MDB_val key, value;
+    rc = mdb_cursor_get(cur, &key, &value, MDB_FIRST);
+    while (rc == 0) {
+        rc = mdb_del((MDB_txn*)trx, dbi_, &value, nullptr);
+        if (rc != 0 && rc != MDB_NOTFOUND) break;
+
+        rc = mdb_cursor_get(cur, &key, &value, MDB_NEXT);
+    }
+    mdb_cursor_close(cur);
+
+    if (rc == MDB_NOTFOUND) rc = mdb_drop((MDB_txn*)trx, versions_dbi_, 0);
+    end_txn(trx, rc);
+
+    return rc;
+}
+
+int BulletDB::put_remap(uint64_t serial, uint16_t block_id, void* trx) {
+    MDB_val key{ sizeof(serial), &serial };
+    MDB_val value{ sizeof(block_id), &block_id };
+    return mdb_put((MDB_txn*)trx, remaps_dbi_, &key, &value, 0);
+}
+
+int BulletDB::del_remap(uint64_t serial, void* trx) {
+    MDB_val key{ sizeof(serial), &serial };
+    int rc = mdb_del((MDB_txn*)trx, remaps_dbi_, &key, nullptr);
+    return rc == MDB_NOTFOUND ? 0 : rc;
+}
+
+int BulletDB::get_remaps(std::vector<std::pair<uint64_t, uint16_t>> &out, void* trx) {
+    MDB_cursor* cur;
+    int rc = mdb_cursor_open((MDB_txn*)trx, remaps_dbi_, &cur);
+    if (rc != 0) return rc;
+
+    MDB_val key, value;
+    rc = mdb_cursor_get(cur, &key, &value, MDB_FIRST);
+    while (rc == 0) {
+        uint64_t serial;
+        uint16_t block_id;
+        std::memcpy(&serial, key.mv_data, sizeof(serial));
+        std::memcpy(&block_id, value.mv_data, sizeof(block_id));
+        out.emplace_back(serial, block_id);
+
+        rc = mdb_cursor_get(cur, &key, &value, MDB_NEXT);
+    }
+    mdb_cursor_close(cur);
+
+    return rc == MDB_NOTFOUND ? 0 : rc;
+}
+
 int BulletDB::del(const void* key_data, size_t key_size, void* trx) {
     MDB_val key{ key_size, (void*)(key_data) };
     return mdb_del((MDB_txn*)trx, dbi_, &key, nullptr);
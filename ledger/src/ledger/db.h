@@ -17,14 +17,24 @@
  */
 
 #pragma once
+#include <cstdint>
 #include <lmdb.h>
 #include <shared_mutex>
+#include <utility>
 #include <vector>
 
 class BulletDB {
 public:
     MDB_env* env_;
     MDB_dbi dbi_;
+
+    // ids written under each pending block, a dup per id, so a
+    // block's versions can be swept without walking the trie
+    MDB_dbi versions_dbi_;
+
+    // blocks justified by remapping that have yet to settle,
+    // by the order they were justified in
+    MDB_dbi remaps_dbi_;
     int count_;
     std::shared_mutex mux_;
 
@@ -39,6 +49,12 @@ public:
             const void* value_data, size_t value_size,
             void* trx
         );
+    // reserves value_size bytes under key for the caller to fill,
+    // value_data is only valid until trx ends
+    int put_reserve(const void* key_data, size_t key_size, 
+            size_t value_size, void** value_data,
+            void* trx
+        );
     int get(
         const void* key_data, size_t key_size, 
         std::vector<std::byte> &out, 
@@ -49,6 +65,47 @@ public:
              void* trx
     );
 
+    // no copy, value_data points into the map
+    // and is only valid until trx ends
+    int get_view(const void* key_data, size_t key_size,
+            const void** value_data, size_t* value_size,
+            void* trx
+    );
+
+    // cursors walk keys in order, the key and value they hand out
+    // point into the map and are only valid until trx ends
+    int open_cursor(void* trx, void** cursor);
+    void close_cursor(void* cursor);
+
+    // first key >= key_data
+    int cursor_seek(void* cursor, 
+            const void* key_data, size_t key_size,
+            const void** key_out, size_t* key_out_size,
+            const void** value_data, size_t* value_size
+    );
+    int cursor_next(void* cursor, 
+            const void** key_out, size_t* key_out_size,
+            const void** value_data, size_t* value_size
+    );
+
+    int put_version(uint16_t block_id, const void* id, size_t id_size, void* trx);
+
+    // every id indexed under block_id, back to back in out
+    int get_versions(uint16_t block_id, std::vector<std::byte> &out, void* trx);
+
+    // drops block_id's index, not the versions in it
+    int del_versions(uint16_t block_id, void* trx);
+
+    // deletes every indexed version and empties the index.
+    // block ids don't outlive the process, so any left at open are stale
+    int clear_versions();
+
+    int put_remap(uint64_t serial, uint16_t block_id, void* trx);
+    int del_remap(uint64_t serial, void* trx);
+
+    // (serial, block id) of every remap, oldest first
+    int get_remaps(std::vector<std::pair<uint64_t, uint16_t>> &out, void* trx);
+
     int del(const void* key_data, size_t key_size,  void* trx);
     int exists(const void* key_data, size_t key_size,  void* trx);
     std::vector<uint64_t> flatten_sort_l2();
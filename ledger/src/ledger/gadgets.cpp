@@ -24,10 +24,11 @@ Gadgets_ptr init_gadgets(
     std::string tag,
     std::string path,
     size_t cache_size,
-    size_t map_size
+    size_t map_size,
+    size_t threads
 ) {
     auto g = std::make_shared<Gadgets>(
-        degree, s, tag, path, cache_size, map_size
+        degree, s, tag, path, cache_size, map_size, threads
     );
     g->alloc.set_gadgets(g);
     return g;
@@ -18,21 +18,27 @@
 
 #pragma once
 #include "alloc.h"
+#include "thread_pool.h"
 
 struct Gadgets {
     KZGSettings settings;
     NodeAllocator alloc;
 
+    // declared last so workers are joined before the rest goes
+    ThreadPool pool;
+
     Gadgets(
         size_t degree, 
         const blst_scalar &s, 
         std::string tag,
         std::string path,
         size_t cache_size,
-        size_t map_size
+        size_t map_size,
+        size_t threads
     ) : 
         settings(init_settings(degree, s, tag)),
-        alloc(path, cache_size, map_size)
+        alloc(path, cache_size, map_size),
+        pool(threads)
     {}
 };
 
@@ -44,5 +50,6 @@ Gadgets_ptr init_gadgets(
     std::string tag,
     std::string path,
     size_t cache_size,
-    size_t map_size
+    size_t map_size,
+    size_t threads
 );
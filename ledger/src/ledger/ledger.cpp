@@ -19,46 +19,77 @@
 #include "ledger.h"
 #include "branch.h"
 #include "state_types.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
 
 const size_t PENDING_BLOCKS_SIZE = 256;
+const size_t PROOF_CACHE_SIZE = 4096;
+
+// one worker per core, leaving the calling thread to help out
+static size_t default_threads() {
+    size_t cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+}
 
 Ledger::Ledger(
     std::string path, 
     size_t cache_size, 
     size_t map_size,
     std::string tag,
-    blst_scalar secret_sk
+    blst_scalar secret_sk,
+    size_t threads
 ) : 
     gadgets_(init_gadgets(
         BRANCH_ORDER, 
         secret_sk, tag, 
-        path, cache_size, map_size
+        path, cache_size, map_size,
+        threads ? threads : default_threads()
     )),
-    current_block_id_{1}
+    current_block_id_{1},
+    proof_cache_(PROOF_CACHE_SIZE),
+    justify_mode_{JUSTIFY_COPY},
+    serial_{}
 {
     block_hash_map_.reserve(PENDING_BLOCKS_SIZE);
     shard_prefix_.reserve(32);
+
+    open_rc_ = resume_remaps();
 }
 
 Ledger::~Ledger() {}
 
+int Ledger::open_status() const { return open_rc_; }
+
 const Gadgets_ptr Ledger::get_gadgets() const { return gadgets_; }
+ProofCache& Ledger::get_proof_cache() { return proof_cache_; }
 
 
 uint16_t Ledger::get_block_id(const Hash* block_hash, bool create_new) {
     if (block_hash) {
+        std::shared_lock lock(block_mux_);
         auto it = block_hash_map_.find(*block_hash);
         if (it != block_hash_map_.end()) 
             return it->second;
     }
 
     if (create_new) {
+        std::unique_lock lock(block_mux_);
+
+        // someone may have beaten us to it
+        auto it = block_hash_map_.find(*block_hash);
+        if (it != block_hash_map_.end()) 
+            return it->second;
+
         uint16_t id = current_block_id_++;
 
         if (current_block_id_ == 0)
             current_block_id_++;
 
         block_hash_map_.emplace(*block_hash, id);
+
+        std::unique_lock remap_lock(remap_mux_);
+        born_[id] = serial_++;
         return id;
     } else {
 
@@ -68,32 +99,172 @@ uint16_t Ledger::get_block_id(const Hash* block_hash, bool create_new) {
 
 bool Ledger::remove_block_id(const Hash* block_hash) {
     if (!block_hash) return false;
-    return block_hash_map_.erase(*block_hash) > 0;
+    std::unique_lock lock(block_mux_);
+
+    auto it = block_hash_map_.find(*block_hash);
+    if (it == block_hash_map_.end()) return false;
+
+    finalized_.erase(it->second);
+    block_hash_map_.erase(it);
+    return true;
 }
 
+uint16_t Ledger::changing_block(const Hash* block_hash) {
+    uint16_t block_id = get_block_id(block_hash);
+
+    std::unique_lock lock(block_mux_);
+    finalized_.erase(block_id);
+    return block_id;
+}
+
+void Ledger::block_finalized(uint16_t block_id) {
+    std::unique_lock lock(block_mux_);
+    finalized_.insert(block_id);
+}
+
+bool Ledger::is_finalized(uint16_t block_id) {
+    std::shared_lock lock(block_mux_);
+    return finalized_.count(block_id) > 0;
+}
+
+
+int Ledger::open_snapshot(
+    std::unique_ptr<Snapshot> &out,
+    const Hash* block_hash
+) {
+    uint16_t block_id{};
+    if (block_hash) {
+        block_id = get_block_id(block_hash, false);
+        if (block_id == 0) return BLOCK_NOT_EXIST;
+        if (!is_finalized(block_id)) return BLOCK_NOT_FINALIZED;
+    }
+
+    // settling copies a block's versions before dropping its remap, 
+    // and retiring drops them after. with the remap looked up while 
+    // the txn starts, it sees whichever versions the id resolves to
+    std::shared_lock lock(remap_mux_);
+
+    NodeId root_id {&shard_prefix_, block_id};
+    resolve_version(&root_id);
+    out = std::make_unique<Snapshot>(gadgets_, root_id);
+
+    return OK;
+}
+
+int Ledger::iter(
+    std::unique_ptr<RangeIter> &out,
+    const byte* prefix, size_t prefix_size,
+    const Hash* block_hash
+) {
+    uint16_t block_id{};
+    if (block_hash) {
+        block_id = get_block_id(block_hash, false);
+        if (block_id == 0) return BLOCK_NOT_EXIST;
+    }
+
+    NodeId root_id {&shard_prefix_, block_id};
+    current_version(&root_id);
+    out = std::make_unique<RangeIter>(gadgets_, root_id, prefix, prefix_size);
+
+    return OK;
+}
+
+int Ledger::export_chunks(
+    std::unique_ptr<ChunkExporter> &out,
+    uint8_t depth
+) {
+    // a remapped root and all under it carry the block's id,
+    // chunks must go out under the cannonical one
+    int rc = settle_versions();
+    if (rc != OK) return rc;
+
+    NodeId root_id {&shard_prefix_, 0};
+    out = std::make_unique<ChunkExporter>(gadgets_, root_id, depth);
+
+    return OK;
+}
+
+int Ledger::import_chunks(
+    const std::vector<ByteSlice> &chunks,
+    const Hash* root_hash
+) {
+    NodeId root_id {&shard_prefix_, 0};
+    int rc = ::import_chunks(gadgets_, root_id, chunks, root_hash);
+
+    // whatever was proven before may not be there anymore
+    proof_cache_.invalidate_all();
+    return rc;
+}
+
+int Ledger::bulk_load(std::unique_ptr<BulkLoader> &out) {
+    NodeId root_id {&shard_prefix_, 0};
+    out = std::make_unique<BulkLoader>(gadgets_, proof_cache_, root_id);
+
+    return OK;
+}
+
+int Ledger::get(
+    const ByteSlice &key,
+    uint8_t idx,
+    Hash* out,
+    const Hash* block_hash
+) {
+    Hash key_hash;
+    derive_hash(key_hash.h, key);
+    key_hash.h[32-1] = idx;
+
+    if (!in_shard(&key_hash)) return NOT_IN_SHARD;
+
+    std::unique_ptr<Snapshot> snap;
+    int rc = open_snapshot(snap, block_hash);
+    if (rc != OK) return rc;
+
+    return snap->get(&key_hash, out);
+}
+
+int Ledger::multi_get(
+    const ByteSlice* keys,
+    const uint8_t* idxs,
+    size_t n,
+    Hash* outs,
+    int* results,
+    const Hash* block_hash
+) {
+    std::unique_ptr<Snapshot> snap;
+    int rc = open_snapshot(snap, block_hash);
+    if (rc != OK) return rc;
+
+    // only the keys in this shard go down the trie
+    std::vector<Hash> key_hashes;
+    std::vector<size_t> pos;
+    key_hashes.reserve(n);
+    pos.reserve(n);
+
+    Hash key_hash;
+    for (size_t i{}; i < n; i++) {
+        derive_hash(key_hash.h, keys[i]);
+        key_hash.h[32-1] = idxs[i];
+
+        if (!in_shard(&key_hash)) {
+            results[i] = NOT_IN_SHARD;
+            continue;
+        }
+        key_hashes.push_back(key_hash);
+        pos.push_back(i);
+    }
+
+    std::vector<Hash> got(key_hashes.size());
+    std::vector<int> codes(key_hashes.size());
+    snap->multi_get(key_hashes.data(), key_hashes.size(), got.data(), codes.data());
+
+    for (size_t j{}; j < pos.size(); j++) {
+        results[pos[j]] = codes[j];
+        if (codes[j] == OK) outs[pos[j]] = got[j];
+    }
+
+    return OK;
+}
 
-/*  
- *  TODO --
- *
- *  THE THOUGHT::
- *      you can just insert from a global root...
- *      shouldnt be that big of an issue...
- *          in_shard() should handle odd cases
- *      then you can call finalize on the lowest shard root.
- *      that gives you a hash you can report
- *      
- *      for the next level up you wait for all the votes...
- *      then you can derive the next layer up...
- *      and you do that until you reach the global root...
- *
- *      I think just a vector of root_node_ids
- *      for our shard...
- *      so you can just grab the last one...
- *      then the next to last, and so forth...
- *
- *      what about multiple shards??
- *      2D vector of roots ids
-*/
 Result<Node_ptr, int> Ledger::get_root( 
     std::vector<byte>* path,
     uint16_t block_id, 
@@ -101,12 +272,14 @@ Result<Node_ptr, int> Ledger::get_root(
 ) {
 
     NodeId id {path, block_id};
+    current_version(&id);
     Result<Node_ptr, int> res = gadgets_->alloc.load_node(&id);
     if (res.is_err() && res.unwrap_err() == MDB_NOTFOUND) {
 
         // fetch prev_blocks root
         NodeId prev_root_id {id};
         prev_root_id.set_block_id(prev_block_id);
+        current_version(&prev_root_id);
         Node_ptr prev_root_node = nullptr;
 
         Result<Node_ptr, int> res = gadgets_->alloc.load_node(&prev_root_id);
@@ -117,10 +290,8 @@ Result<Node_ptr, int> Ledger::get_root(
             prev_root_node = res.unwrap();
         }
 
-        std::vector<byte> cannon_bytes = prev_root_node->to_bytes();
-        ByteSlice bytes(cannon_bytes);
-
-        Node_ptr node = create_branch(gadgets_, &id, &bytes);
+        Node_ptr node = prev_root_node->clone();
+        node->set_id(&id);
         gadgets_->alloc.cache_node(node);
 
         return node;
@@ -141,7 +312,297 @@ bool Ledger::in_shard(const Hash* h) {
         }
         ++matched;
     }
-    return matched == path_size;
+    if (matched != path_size) return false;
+
+    std::shared_lock lock(shard_mux_);
+    if (shards_.empty() || path_size >= 32) return true;
+    return held_.is_set(h->h[path_size]);
+}
+
+int Ledger::set_shards(const std::vector<ShardRange> &shards) {
+    {
+        std::unique_lock lock(shard_mux_);
+        shards_ = shards;
+    }
+
+    // cached proofs may be of keys no longer held
+    proof_cache_.invalidate_all();
+    return drop_outside_shards();
+}
+
+int Ledger::drop_outside_shards() {
+    Result<Node_ptr, int> res = get_root(&shard_prefix_, 0);
+    if (res.is_err()) return res.unwrap_err();
+
+    // the root is always a branch
+    Node_ptr node = res.unwrap();
+    Branch* root = static_cast<Branch*>(node.get());
+
+    std::unique_lock lock(shard_mux_);
+    if (shards_.empty()) return OK;
+
+    held_.reset();
+    if (!root->is_split()) {
+        for (size_t nib = 0; nib < BRANCH_ORDER; nib++) held_.set(nib);
+        return OK;
+    }
+
+    std::vector<byte> dropping;
+    for (auto &range: root->get_ranges()) {
+        bool held = std::any_of(shards_.begin(), shards_.end(), [&](const ShardRange &s) {
+            return s.first <= range.end && range.anchor <= s.last;
+        });
+
+        if (!held) {
+            dropping.push_back(range.anchor);
+            continue;
+        }
+        for (size_t nib = range.anchor; nib <= range.end; nib++) held_.set(nib);
+    }
+    if (dropping.empty()) return OK;
+
+    // proofs through the dropped ranges can't be served anymore
+    proof_cache_.invalidate_all();
+
+    for (byte anchor: dropping) {
+        int rc = root->drop_range(anchor);
+        if (rc != OK) return rc;
+    }
+    return gadgets_->alloc.write_nodes({node});
+}
+
+bool Ledger::is_sharded() {
+    std::shared_lock lock(shard_mux_);
+    return !shards_.empty();
+}
+
+bool Ledger::holds_range(byte first, byte last) {
+    std::shared_lock lock(shard_mux_);
+    if (shards_.empty()) return true;
+
+    return std::any_of(shards_.begin(), shards_.end(), [&](const ShardRange &s) {
+        return s.first <= last && first <= s.last;
+    });
+}
+
+void Ledger::shard_finalized(uint16_t block_id) {
+    std::unique_lock lock(shard_mux_);
+    pending_shards_[block_id].finalized = true;
+}
+
+void Ledger::shard_received(uint16_t block_id, byte anchor) {
+    std::unique_lock lock(shard_mux_);
+    pending_shards_[block_id].received.set(anchor);
+}
+
+std::vector<ShardRange> Ledger::missing_shards(
+    uint16_t block_id, 
+    const std::vector<Child> &ranges
+) {
+    std::vector<ShardRange> missing;
+    for (auto &range: ranges) {
+        if (holds_range(range.anchor, range.end)) continue;
+
+        std::shared_lock lock(shard_mux_);
+        auto it = pending_shards_.find(block_id);
+        if (it == pending_shards_.end() || !it->second.received.is_set(range.anchor)) 
+            missing.push_back({range.anchor, range.end});
+    }
+    return missing;
+}
+
+bool Ledger::shards_complete(uint16_t block_id, const std::vector<Child> &ranges) {
+    {
+        std::shared_lock lock(shard_mux_);
+        auto it = pending_shards_.find(block_id);
+        if (it == pending_shards_.end() || !it->second.finalized) return false;
+    }
+    return missing_shards(block_id, ranges).empty();
+}
+
+void Ledger::set_justify_mode(JustifyMode mode) {
+    std::unique_lock lock(remap_mux_);
+    justify_mode_ = mode;
+}
+
+JustifyMode Ledger::get_justify_mode() {
+    std::shared_lock lock(remap_mux_);
+    return justify_mode_;
+}
+
+void Ledger::current_version(NodeId* id) {
+    if (id->get_block_id() != 0) return;
+
+    std::shared_lock lock(remap_mux_);
+    resolve_version(id);
+}
+
+void Ledger::resolve_version(NodeId* id) {
+    if (id->get_block_id() != 0) return;
+
+    auto it = remapped_.find(*id);
+    if (it != remapped_.end()) id->set_block_id(it->second);
+}
+
+int Ledger::remap_block(uint16_t block_id) {
+    NodeId root_id {&shard_prefix_, 0};
+    BulletDB &db = gadgets_->alloc.db_;
+
+    std::unique_lock lock(remap_mux_);
+    uint64_t serial = serial_++;
+
+    // so a restart knows to settle it
+    void* trx = db.start_txn();
+    int rc = db.put_remap(serial, block_id, trx);
+    db.end_txn(trx, rc);
+    if (rc != OK) return rc;
+
+    remapped_[root_id] = block_id;
+    unsettled_.push_back({serial, block_id});
+
+    return OK;
+}
+
+int Ledger::settle_versions(size_t max_blocks) {
+    NodeAllocator &alloc = gadgets_->alloc;
+
+    for (size_t settled{}; max_blocks == 0 || settled < max_blocks; settled++) {
+        Remap next;
+        {
+            std::shared_lock lock(remap_mux_);
+            if (unsettled_.empty()) return OK;
+            next = unsettled_.front();
+        }
+        uint16_t block_id = next.block_id;
+
+        std::vector<NodeId> versions;
+        int rc = alloc.block_versions(block_id, versions);
+        if (rc != OK) return rc;
+
+        std::vector<Node_ptr> nodes;
+        nodes.reserve(versions.size());
+        for (auto &id: versions) {
+            Result<Node_ptr, int> res = alloc.load_node(&id);
+            if (res.is_err()) {
+                rc = res.unwrap_err();
+                if (rc == MDB_NOTFOUND) continue;
+                return rc;
+            }
+
+            rc = res.unwrap()->justify(block_id);
+            if (rc != OK && rc != DELETED) return rc;
+            nodes.push_back(res.unwrap());
+        }
+
+        // the block's own versions stay, blocks built 
+        // since it was remapped still link to them
+        rc = alloc.copy_versions(nodes);
+        if (rc != OK) return rc;
+
+        void* trx = alloc.db_.start_txn();
+        rc = alloc.db_.del_remap(next.serial, trx);
+        alloc.db_.end_txn(trx, rc);
+        if (rc != OK) return rc;
+
+        {
+            std::unique_lock lock(remap_mux_);
+            unsettled_.pop_front();
+
+            for (auto it = remapped_.begin(); it != remapped_.end();) {
+                if (it->second == block_id) it = remapped_.erase(it);
+                else it++;
+            }
+
+            born_.erase(block_id);
+            retiring_.push_back({serial_++, block_id});
+        }
+
+        rc = retire_versions();
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+int Ledger::release_block(uint16_t block_id) {
+    {
+        std::unique_lock lock(remap_mux_);
+        born_.erase(block_id);
+    }
+    return retire_versions();
+}
+
+int Ledger::retire_versions() {
+    std::vector<uint16_t> dropping;
+    {
+        std::unique_lock lock(remap_mux_);
+
+        uint64_t oldest = UINT64_MAX;
+        for (auto &[block_id, serial]: born_) oldest = std::min(oldest, serial);
+
+        for (auto it = retiring_.begin(); it != retiring_.end();) {
+            if (it->serial > oldest) { it++; continue; }
+
+            dropping.push_back(it->block_id);
+            it = retiring_.erase(it);
+        }
+    }
+
+    for (uint16_t block_id: dropping) {
+        int rc = gadgets_->alloc.drop_versions(block_id);
+        if (rc != OK) return rc;
+    }
+    return OK;
+}
+
+int Ledger::resume_remaps() {
+    BulletDB &db = gadgets_->alloc.db_;
+
+    std::vector<std::pair<uint64_t, uint16_t>> remaps;
+    void* trx = db.start_rd_txn();
+    int rc = db.get_remaps(remaps, trx);
+    db.end_txn(trx, rc);
+    if (rc != OK) return rc;
+
+    for (auto &[serial, block_id]: remaps) {
+        unsettled_.push_back({serial, block_id});
+        serial_ = serial + 1;
+    }
+
+    rc = settle_versions();
+    if (rc != OK) return rc;
+
+    // none of the last process's blocks are left to link to anything,
+    // so settled versions went as they settled. the rest never will
+    return db.clear_versions();
+}
+
+void Ledger::forget_shards(uint16_t block_id) {
+    std::unique_lock lock(shard_mux_);
+    pending_shards_.erase(block_id);
+}
+
+void Ledger::set_split_weight(const Weight &max) {
+    std::unique_lock lock(shard_mux_);
+    split_weight_ = max;
+}
+
+int Ledger::split_heavy(uint16_t block_id) {
+    Weight max;
+    {
+        std::shared_lock lock(shard_mux_);
+
+        // the other shards have to agree on the ranges
+        if (!shards_.empty()) return OK;
+        max = split_weight_;
+    }
+    if (!max.leaves && !max.bytes) return OK;
+
+    Result<Node_ptr, int> res = get_root(&shard_prefix_, block_id);
+    if (res.is_err()) return res.unwrap_err();
+
+    // the root is always a branch
+    Node_ptr root = res.unwrap();
+    return static_cast<Branch*>(root.get())->split_heavy(max, block_id);
 }
 
 int Ledger::store_value( 
@@ -209,7 +670,7 @@ int Ledger::put(
 
     if (!in_shard(&key_hash)) return NOT_IN_SHARD;
 
-    uint16_t block_id = get_block_id(block_hash);
+    uint16_t block_id = changing_block(block_hash);
     uint16_t prev_block_id = get_block_id(prev_block_hash, false);
 
     Result<Node_ptr, int> root = get_root(nullptr, block_id, prev_block_id);
@@ -232,7 +693,7 @@ int Ledger::replace(
 
     if (!in_shard(&key_hash)) return NOT_IN_SHARD;
 
-    uint16_t block_id = get_block_id(block_hash);
+    uint16_t block_id = changing_block(block_hash);
     uint16_t prev_block_id = get_block_id(prev_block_hash, false);
 
     Result<Node_ptr, int> r = get_root(nullptr, block_id, prev_block_id);
@@ -242,6 +703,27 @@ int Ledger::replace(
     return root->replace(&key_hash, val_hash, prev_val_hash, block_id);
 }
 
+int Ledger::remove(
+    const ByteSlice &key, 
+    uint8_t idx,
+    const Hash* block_hash,
+    const Hash* prev_block_hash
+) {
+    Hash key_hash;
+    derive_hash(key_hash.h, key);
+    key_hash.h[32-1] = idx;
+
+    if (!in_shard(&key_hash)) return NOT_IN_SHARD;
+
+    uint16_t block_id = changing_block(block_hash);
+    uint16_t prev_block_id = get_block_id(prev_block_hash, false);
+
+    Result<Node_ptr, int> root = get_root(nullptr, block_id, prev_block_id);
+    if (root.is_err()) return root.unwrap_err();
+
+    return root.unwrap()->remove(&key_hash, block_id);
+}
+
 
 int Ledger::create_account(
     const ByteSlice &key, 
@@ -254,7 +736,7 @@ int Ledger::create_account(
 
     if (!in_shard(&key_hash)) return NOT_IN_SHARD;
 
-    uint16_t block_id = get_block_id(block_hash);
+    uint16_t block_id = changing_block(block_hash);
     uint16_t prev_block_id = get_block_id(prev_block_hash, false);
 
     Result<Node_ptr, int> root = get_root(nullptr, block_id);
@@ -274,7 +756,7 @@ int Ledger::delete_account(
 
     if (!in_shard(&key_hash)) return NOT_IN_SHARD;
 
-    uint16_t block_id = get_block_id(block_hash);
+    uint16_t block_id = changing_block(block_hash);
     uint16_t prev_block_id = get_block_id(prev_block_hash, false);
 
     Result<Node_ptr, int> root = get_root(nullptr, block_id);
@@ -283,3 +765,88 @@ int Ledger::delete_account(
     return root.unwrap()->delete_account(&key_hash, block_id);
 }
 
+int Ledger::apply_batch(
+    const std::vector<LedgerOp> &ops,
+    std::vector<int> &results,
+    const Hash* block_hash,
+    const Hash* prev_block_hash,
+    bool parallel
+) {
+    results.assign(ops.size(), OK);
+    if (ops.empty()) return OK;
+
+    std::vector<TrieOp> trie_ops;
+    std::vector<size_t> op_idx;
+    trie_ops.reserve(ops.size());
+    op_idx.reserve(ops.size());
+
+    for (size_t i{}; i < ops.size(); i++) {
+        const LedgerOp &op = ops[i];
+
+        bool account_op = (
+            op.kind == OP_CREATE_ACCOUNT || 
+            op.kind == OP_DELETE_ACCOUNT
+        );
+
+        TrieOp t{op.kind, {}, op.val_hash, op.prev_val_hash};
+        derive_hash(t.key.h, op.key);
+        t.key.h[32-1] = account_op ? 0 : op.idx;
+
+        if (!in_shard(&t.key)) {
+            results[i] = NOT_IN_SHARD;
+            continue;
+        }
+
+        trie_ops.push_back(t);
+        op_idx.push_back(i);
+    }
+
+    // sort by account then by position in the list,
+    // so ops on the same account keep their order
+    std::vector<size_t> order(trie_ops.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        int c = std::memcmp(trie_ops[a].key.h, trie_ops[b].key.h, 32 - 1);
+        if (c != 0) return c < 0;
+        return a < b;
+    });
+
+    std::vector<TrieOp> sorted;
+    sorted.reserve(order.size());
+    for (size_t k: order) sorted.push_back(trie_ops[k]);
+
+    uint16_t block_id = changing_block(block_hash);
+    uint16_t prev_block_id = get_block_id(prev_block_hash, false);
+
+    std::vector<int> sorted_results(sorted.size(), OK);
+
+    size_t done{};
+    while (done < sorted.size()) {
+        Result<Node_ptr, int> root = get_root(nullptr, block_id, prev_block_id);
+        if (root.is_err()) {
+            for (size_t k = done; k < sorted.size(); k++) 
+                sorted_results[k] = root.unwrap_err();
+            break;
+        }
+
+        Node_ptr root_node = root.unwrap();
+        if (parallel) {
+            done += root_node->apply_batch_parallel(
+                sorted.data() + done, sorted.size() - done,
+                sorted_results.data() + done,
+                block_id
+            );
+        } else {
+            done += root_node->apply_batch(
+                sorted.data() + done, sorted.size() - done,
+                sorted_results.data() + done,
+                block_id
+            );
+        }
+    }
+
+    for (size_t k{}; k < order.size(); k++) 
+        results[op_idx[order[k]]] = sorted_results[k];
+
+    return OK;
+}
@@ -40,41 +40,260 @@
 */
 
 #pragma once
+#include "bulk_load.h"
 #include "gadgets.h"
 #include "hashing.h"
 #include "node.h"
+#include "proof_cache.h"
+#include "range_iter.h"
+#include "snapshot.h"
+#include "state_sync.h"
+#include <deque>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// a range of the key byte the root splits on, both ends included
+struct ShardRange {
+    byte first;
+    byte last;
+};
+
+// how justify_block makes a block's versions cannonical
+enum JustifyMode : uint8_t {
+    // moves every version to its cannonical id there and then
+    JUSTIFY_COPY = 0,
+
+    // points the cannonical root at the block's and leaves
+    // the moving to settle_versions
+    JUSTIFY_REMAP = 1,
+};
+
+// one entry of a blocks op list, key is unhashed
+struct LedgerOp {
+    OpKind kind;
+    ByteSlice key;
+    uint8_t idx;
+    const Hash* val_hash;
+    const Hash* prev_val_hash;
+};
 
 
 class Ledger {
 private:
     Gadgets_ptr gadgets_;
-    std::vector<std::vector<NodeId>> shards_;
     std::vector<byte> shard_prefix_;
+
+    // key ranges this ledger holds, none is all of them.
+    // held_ is every nib of a root range overlapping one,
+    // a range is held or dropped as a whole
+    mutable std::shared_mutex shard_mux_;
+    std::vector<ShardRange> shards_;
+    Bitmap<BRANCH_ORDER> held_{};
+
+    // a subtree heavier than this splits on finalize, zero never does
+    Weight split_weight_{};
+
+    // blocks whose root waits on other shards' hashes
+    struct PendingShards {
+        // anchors of the ranges whose hash has come in
+        Bitmap<BRANCH_ORDER> received;
+
+        // this ledger's own ranges are committed
+        bool finalized;
+    };
+    std::unordered_map<uint16_t, PendingShards> pending_shards_;
+
+    // readers look blocks up while writers add and drop them
+    mutable std::shared_mutex block_mux_;
     std::unordered_map<Hash, uint16_t, HashHash> block_hash_map_;
     uint16_t current_block_id_;
 
+    // pending blocks unchanged since their last finalize, 
+    // what's on disk for any other is half applied
+    std::unordered_set<uint16_t> finalized_;
+
+    // the block's id, made if need be, as it's about to change
+    uint16_t changing_block(const Hash* block_hash);
+    ProofCache proof_cache_;
+
+    JustifyMode justify_mode_;
+
+    // a remap justified block's versions stand in for the cannonical
+    // ones until it settles. only the cannonical root needs mapping
+    // to the block whose version is current, whatever is under it
+    // is reached through the links of that version
+    mutable std::shared_mutex remap_mux_;
+    std::unordered_map<NodeId, uint16_t, NodeIdHash> remapped_;
+
+    // serials order remaps, settles and blocks being handed ids
+    struct Remap {
+        uint64_t serial;
+        uint16_t block_id;
+    };
+    uint64_t serial_;
+
+    // remapped blocks yet to settle, oldest first
+    std::deque<Remap> unsettled_;
+
+    // current_version with remap_mux_ already held
+    void resolve_version(NodeId* id);
+
+    // settled blocks, by when, whose own versions stay until no 
+    // block that might link to them, one born before, is left
+    std::vector<Remap> retiring_;
+
+    // serial of every block not yet justified or pruned
+    std::unordered_map<uint16_t, uint64_t> born_;
+
+    // settles what the last process left remapped,
+    // and drops every version it had
+    int resume_remaps();
+
+    // what resume_remaps gave when this was opened
+    int open_rc_;
+
+    // drops the versions of retiring blocks nothing can link to now
+    int retire_versions();
+
 public:
     Ledger(
         std::string path,
         size_t cache_size,
         size_t map_size,
         std::string tag,
-        blst_scalar secret_sk
+        blst_scalar secret_sk,
+        // worker threads for finalize, proofs and batches, 0 picks from the core count
+        size_t threads = 0
     );
 
+    // OK unless opening failed, in which case
+    // the ledger is to be dropped without use
+    int open_status() const;
+
     const Gadgets_ptr get_gadgets() const;
+    ProofCache& get_proof_cache();
 
     bool in_shard(const Hash* hash);
 
+    // takes the ranges this ledger holds from now on, 
+    // and drops what the cannonical root has outside them
+    int set_shards(const std::vector<ShardRange> &shards);
+
+    // prunes the cannonical subtrees of root ranges outside 
+    // the held shards. until the root splits it's all kept
+    int drop_outside_shards();
+
+    bool is_sharded();
+
+    // the range overlaps one this ledger holds
+    bool holds_range(byte first, byte last);
+
+    void shard_finalized(uint16_t block_id);
+    void shard_received(uint16_t block_id, byte anchor);
+
+    // of the block's root ranges, those held elsewhere
+    // whose hash hasn't come in yet
+    std::vector<ShardRange> missing_shards(
+        uint16_t block_id, 
+        const std::vector<Child> &ranges
+    );
+
+    // true once the block is finalized here and nothing is missing
+    bool shards_complete(uint16_t block_id, const std::vector<Child> &ranges);
+
+    void forget_shards(uint16_t block_id);
+
+    void set_split_weight(const Weight &max);
+
+    // splits the block's root when it, or one of its ranges,
+    // weighs more than the split weight
+    int split_heavy(uint16_t block_id);
+
     uint16_t get_block_id(const Hash* block_hash, bool create_new = true);
     bool remove_block_id(const Hash* block_hash);
 
+    // what's on disk for the block is all of it until it next changes
+    void block_finalized(uint16_t block_id);
+    bool is_finalized(uint16_t block_id);
+
+    void set_justify_mode(JustifyMode mode);
+    JustifyMode get_justify_mode();
+
+    // a cannonical root id is pointed at the version current for it
+    void current_version(NodeId* id);
+
+    // makes the block's root the cannonical one, in one write
+    int remap_block(uint16_t block_id);
+
+    // copies up to max_blocks remapped blocks' versions, oldest first, 
+    // to their cannonical ids. 0 settles all of them
+    int settle_versions(size_t max_blocks = 0);
+
+    // the block was justified or pruned,
+    // versions kept for it may go
+    int release_block(uint16_t block_id);
+
     Result<Node_ptr, int> get_root(
         std::vector<byte>* path,
         uint16_t block_id,
         uint16_t prev_block_id = 0
     );
 
+    // block_hash is optional, and defaults to cannonical.
+    // a pending block must be finalized, BLOCK_NOT_FINALIZED if not
+    int open_snapshot(
+        std::unique_ptr<Snapshot> &out,
+        const Hash* block_hash = nullptr
+    );
+
+    // value hash stored at key/idx, reads through a one off snapshot.
+    // block_hash is optional, and defaults to cannonical
+    int get(
+        const ByteSlice &key,
+        uint8_t idx,
+        Hash* out,
+        const Hash* block_hash = nullptr
+    );
+
+    // get for n keys through one snapshot, results[i] is what
+    // get would return for keys[i]/idxs[i]. the returned code is
+    // only for opening the snapshot
+    int multi_get(
+        const ByteSlice* keys,
+        const uint8_t* idxs,
+        size_t n,
+        Hash* outs,
+        int* results,
+        const Hash* block_hash = nullptr
+    );
+
+    // (key hash, slot, value hash) under a key hash prefix.
+    // block_hash is optional, and defaults to cannonical
+    int iter(
+        std::unique_ptr<RangeIter> &out,
+        const byte* prefix, size_t prefix_size,
+        const Hash* block_hash = nullptr
+    );
+
+    // chunks of the cannonical trie cut depth levels below the root.
+    // settles every remapped block first
+    int export_chunks(
+        std::unique_ptr<ChunkExporter> &out,
+        uint8_t depth
+    );
+
+    // verified against root_hash before anything is written
+    int import_chunks(
+        const std::vector<ByteSlice> &chunks,
+        const Hash* root_hash
+    );
+
+    // builds the cannonical trie from a sorted stream,
+    // into an empty ledger
+    int bulk_load(std::unique_ptr<BulkLoader> &out);
+
     int get_value(
         const Hash* key_hash, 
         void** out, size_t* out_size
@@ -103,6 +322,13 @@ public:
         const Hash* prev_block_hash = nullptr
     );
 
+    int remove(
+        const ByteSlice &key, 
+        uint8_t idx,
+        const Hash* block_hash,
+        const Hash* prev_block_hash = nullptr
+    );
+
     int create_account(
         const ByteSlice& key,
         const Hash* block_hash,
@@ -115,6 +341,17 @@ public:
         const Hash* prev_block_hash = nullptr
     );
 
+    // applies a whole op list to block_hash in one walk of the trie.
+    // results[i] is the code ops[i] would get from the single op call.
+    // with parallel set the root's children are worked concurrently
+    int apply_batch(
+        const std::vector<LedgerOp> &ops,
+        std::vector<int> &results,
+        const Hash* block_hash,
+        const Hash* prev_block_hash = nullptr,
+        bool parallel = false
+    );
+
 
     ~Ledger();
 };
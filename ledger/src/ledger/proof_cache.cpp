@@ -0,0 +1,93 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "proof_cache.h"
+#include <algorithm>
+
+ProofCache::ProofCache(size_t capacity) :
+    epoch_{},
+    flushed_{},
+    cache_(capacity)
+{}
+
+std::optional<CachedProof> ProofCache::get(const Hash* key_hash, uint8_t* stale) {
+    std::lock_guard lock(mux_);
+
+    CachedProof* entry = cache_.get(*key_hash);
+    if (!entry || entry->epoch < flushed_) return std::nullopt;
+
+    *stale = entry->stale;
+
+    // root has changed since this was opened
+    if (entry->epoch != epoch_ && *stale == 0) *stale = 1;
+
+    return *entry;
+}
+
+void ProofCache::put(const Hash* key_hash, std::vector<byte> bytes) {
+    std::lock_guard lock(mux_);
+
+    auto evicted = cache_.put(*key_hash, {std::move(bytes), 0, epoch_});
+    keys_.insert(*key_hash);
+
+    if (evicted.has_value()) {
+        auto [key, _] = evicted.value();
+        keys_.erase(key);
+    }
+}
+
+void ProofCache::invalidate_all() {
+    std::lock_guard lock(mux_);
+    flushed_ = ++epoch_;
+}
+
+void ProofCache::invalidate(const std::vector<NodeId> &dirty) {
+    if (dirty.empty()) return;
+
+    std::lock_guard lock(mux_);
+
+    // every entry shares the root
+    epoch_++;
+
+    Hash lower;
+    for (auto &id: dirty) {
+        uint8_t level = id.get_level();
+        if (level == 0) continue;
+
+        const byte* path = id.get_full();
+        size_t path_len = std::min<size_t>(level, ID_PATH_SIZE);
+
+        lower = new_hash();
+        std::memcpy(lower.h, path, path_len);
+
+        auto it = keys_.lower_bound(lower);
+        for (; it != keys_.end(); it++) {
+            if (std::memcmp(it->h, path, path_len) != 0) break;
+
+            CachedProof* entry = cache_.peek(*it);
+            if (!entry) continue;
+
+            // this node and everything above it. extensions put fewer
+            // nodes than levels above a node, so level + 1 may re-open 
+            // more than changed but never less. a path that gained a 
+            // node has a different proof length, which is never reused
+            uint8_t stale = level + 1;
+            entry->stale = std::max(entry->stale, stale);
+        }
+    }
+}
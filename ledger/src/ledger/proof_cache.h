@@ -0,0 +1,79 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  Serialized existence proofs against the cannonical root,
+ *  keyed by key hash (the last byte being the value index).
+ *
+ *  A proof is one opening per node along the key's path.
+ *  Justifying a block changes the root, so every entry loses
+ *  at least its top opening, but only entries under a path the
+ *  block touched lose anything deeper than that.
+ *
+ *  So instead of flushing on justify we walk the dirty subtree
+ *  and record per entry how many levels (counted from the root)
+ *  have gone stale. On the next request only those are re-opened.
+ *  The root level is tracked with an epoch so that a justify
+ *  costs O(dirty nodes) rather than O(cache size).
+ *
+ *  RPC threads read and fill it while blocks are justified,
+ *  so every call takes the lock and hits are handed out as copies.
+ */
+
+#pragma once
+#include "hashing.h"
+#include "lru.h"
+#include "nodeid.h"
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+
+struct CachedProof {
+    std::vector<byte> bytes;
+    uint8_t stale;
+    uint64_t epoch;
+};
+
+class ProofCache {
+private:
+    std::mutex mux_;
+    uint64_t epoch_;
+
+    // entries opened before this epoch are misses
+    uint64_t flushed_;
+    LRUCache<Hash, CachedProof, HashHash> cache_;
+
+    // ordered view of cached keys for prefix scans
+    std::set<Hash, HashLess> keys_;
+
+public:
+    explicit ProofCache(size_t capacity);
+
+    // stale is the number of openings from the root that need 
+    // to be re-opened before the entry can be served, an upper 
+    // bound as it's counted in trie levels
+    std::optional<CachedProof> get(const Hash* key_hash, uint8_t* stale);
+
+    void put(const Hash* key_hash, std::vector<byte> bytes);
+
+    void invalidate(const std::vector<NodeId> &dirty);
+
+    // for when what changed isn't known, costs nothing up front
+    void invalidate_all();
+};
@@ -0,0 +1,247 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "range_iter.h"
+#include <algorithm>
+#include <cstring>
+
+// ids are one byte per level so a path can't be longer than a key
+const size_t MAX_ITER_DEPTH = 32;
+
+RangeIter::RangeIter(
+    Gadgets_ptr gadgets,
+    const NodeId &root_id,
+    const byte* prefix, size_t prefix_size
+) :
+    gadgets_(gadgets),
+    trx_(gadgets->alloc.db_.start_rd_txn()),
+    cursor_(nullptr),
+    prefix_(new_hash()),
+    prefix_size_(std::min<size_t>(prefix_size, 32)),
+    first_(nullptr),
+    first_size_{},
+    leaf_(nullptr),
+    leaf_size_{},
+    slot_{},
+    started_{},
+    done_{}
+{
+    if (prefix_size_) std::memcpy(prefix_.h, prefix, prefix_size_);
+    descend(root_id);
+}
+
+RangeIter::~RangeIter() {
+    if (cursor_) gadgets_->alloc.db_.close_cursor(cursor_);
+    // nothing was written, aborting just releases the reader slot
+    gadgets_->alloc.db_.end_txn(trx_, 1);
+}
+
+// point lookups only down to the node covering the prefix
+void RangeIter::descend(const NodeId &root_id) {
+    BulletDB &db = gadgets_->alloc.db_;
+    size_t path_len = std::min(prefix_size_, ID_PATH_SIZE);
+
+    NodeId id {root_id};
+    NodeId next_id;
+
+    // a prefix off this shard has nothing under it
+    size_t shared = std::min<size_t>(path_len, id.get_level());
+    if (std::memcmp(id.get_full(), prefix_.h, shared) != 0) {
+        done_ = true;
+        return;
+    }
+
+    for (size_t depth{}; depth < MAX_ITER_DEPTH; depth++) {
+        const void* data = nullptr;
+        size_t size = 0;
+
+        int rc = db.get_view(id.get_full(), id.size(), &data, &size, trx_);
+        const byte* buf = static_cast<const byte*>(data);
+        if (rc != OK || size == 0) break;
+
+        if (!is_branch_type(buf[0])) {
+            // the whole prefix lives in one leaf,
+            // the slots are filtered on the way out
+            LeafView view(buf, size);
+            if (view.valid()) {
+                first_id_ = id;
+                first_ = buf;
+                first_size_ = size;
+            }
+            break;
+        }
+
+        BranchView view(buf, size);
+        if (!view.valid()) break;
+
+        // the prefix has to agree with the extension as far as it goes
+        if (!view.ext_matches(prefix_.h, id.get_level(), path_len)) break;
+
+        if (view.key_level(id.get_level()) >= path_len) {
+            stack_.push_back({id, view});
+            first_id_ = id;
+            first_ = buf;
+            first_size_ = size;
+            return;
+        }
+
+        if (!view.get_next_id(&id, prefix_.h[view.key_level(id.get_level())], &next_id)) break;
+        id = next_id;
+    }
+
+    // nothing to sweep
+    done_ = true;
+}
+
+// id is either what its parent points at, or something to skip
+bool RangeIter::take(const NodeId &id, const byte* buf, size_t size) {
+    NodeId expect;
+
+    while (true) {
+        Frame &top = stack_.back();
+
+        if (id.is_under(top.id)) {
+            size_t level = top.view.key_level(top.id.get_level());
+            if (level >= ID_PATH_SIZE) return false;
+
+            if (!top.view.get_next_id(&top.id, id.get_full()[level], &expect)) return false;
+            if (!(expect == id)) return false;
+            break;
+        }
+
+        // everything past the subtree root is outside the prefix
+        if (stack_.size() == 1) return false;
+        stack_.pop_back();
+    }
+
+    if (size == 0) return false;
+
+    if (is_branch_type(buf[0])) {
+        BranchView view(buf, size);
+        if (!view.valid()) return false;
+
+        stack_.push_back({id, view});
+        return true;
+    }
+
+    LeafView view(buf, size);
+    return view.valid();
+}
+
+int RangeIter::next(Hash* key_hash, uint8_t* slot, Hash* val_hash) {
+    NodeId id;
+    const byte* buf;
+    size_t size;
+
+    while (true) {
+        if (leaf_) {
+            LeafView view(leaf_, leaf_size_);
+
+            while (slot_ < view.slots_count()) {
+                const byte* s = view.slot_at(slot_++);
+
+                std::memcpy(key_hash->h, view.path(), 32);
+                key_hash->h[32-1] = s[0];
+
+                if (std::memcmp(key_hash->h, prefix_.h, prefix_size_) != 0) continue;
+
+                std::memcpy(val_hash->h, s + 1, 32);
+                if (hash_is_zero(*val_hash)) continue;
+
+                *slot = s[0];
+                return OK;
+            }
+            leaf_ = nullptr;
+        }
+
+        int rc = next_node(&id, &buf, &size);
+        if (rc != OK) return rc;
+
+        if (!is_branch_type(buf[0])) {
+            leaf_ = buf;
+            leaf_size_ = size;
+            slot_ = 0;
+        }
+    }
+}
+
+int RangeIter::next_node(NodeId* id, const byte** buf, size_t* size) {
+    BulletDB &db = gadgets_->alloc.db_;
+
+    if (first_) {
+        *id = first_id_;
+        *buf = first_;
+        *size = first_size_;
+        first_ = nullptr;
+        return OK;
+    }
+
+    while (true) {
+        if (done_) return ITER_END;
+
+        // the run is everything sharing the subtree root's path
+        const NodeId &root = stack_.front().id;
+        size_t path_len = std::min<size_t>(root.get_level(), ID_PATH_SIZE);
+
+        const void* key = nullptr;
+        size_t key_size = 0;
+        const void* data = nullptr;
+        size_t data_size = 0;
+        int rc;
+
+        if (!started_) {
+            started_ = true;
+
+            rc = db.open_cursor(trx_, &cursor_);
+            if (rc != OK) {
+                done_ = true;
+                return rc;
+            }
+
+            byte start[ID_SIZE]{};
+            std::memcpy(start, root.get_full(), path_len);
+            rc = db.cursor_seek(cursor_, start, ID_SIZE, &key, &key_size, &data, &data_size);
+
+        } else {
+            rc = db.cursor_next(cursor_, &key, &key_size, &data, &data_size);
+        }
+
+        if (rc == MDB_NOTFOUND) {
+            done_ = true;
+            return ITER_END;
+        }
+        if (rc != OK) {
+            done_ = true;
+            return rc;
+        }
+
+        // values share the keyspace
+        if (key_size != ID_SIZE) continue;
+
+        const byte* id_bytes = static_cast<const byte*>(key);
+        if (std::memcmp(id_bytes, root.get_full(), path_len) != 0) {
+            done_ = true;
+            return ITER_END;
+        }
+
+        *id = NodeId(id_bytes);
+        *buf = static_cast<const byte*>(data);
+        *size = data_size;
+        if (take(*id, *buf, *size)) return OK;
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  Streams every (key hash, slot, value hash) under a key hash 
+ *  prefix at one block, in key order.
+ *
+ *  Node ids lead with their path bytes so LMDB keeps a subtree in 
+ *  one contiguous run, ordered parent first. Rather than descending 
+ *  to each child with a point lookup, the iterator descends once to 
+ *  the node covering the prefix and then sweeps that run with a 
+ *  cursor.
+ *
+ *  The run holds every version of every node: other pending blocks,
+ *  the cannonical versions a block replaced, values. So the sweep 
+ *  keeps the branches it took on its current path and only takes 
+ *  a node its parent points at, block id included. Following the
+ *  parents is what overlays a pending block on the cannonical trie.
+ *
+ *  Like a Snapshot it holds its own read txn, and sees what is
+ *  on disk when it was opened. One thread at a time.
+ */
+
+#pragma once
+#include "gadgets.h"
+#include "hashing.h"
+#include "node_view.h"
+#include "nodeid.h"
+#include <vector>
+
+class RangeIter {
+private:
+    struct Frame {
+        NodeId id;
+        BranchView view;
+    };
+
+    Gadgets_ptr gadgets_;
+    void* trx_;
+    void* cursor_;
+
+    Hash prefix_;
+    size_t prefix_size_;
+
+    // taken branches from the subtree root down
+    std::vector<Frame> stack_;
+
+    // node covering the prefix, handed out before the sweep
+    NodeId first_id_;
+    const byte* first_;
+    size_t first_size_;
+
+    // leaf being handed out
+    const byte* leaf_;
+    size_t leaf_size_;
+    uint8_t slot_;
+
+    bool started_;
+    bool done_;
+
+    void descend(const NodeId &root_id);
+    bool take(const NodeId &id, const byte* buf, size_t size);
+
+public:
+    // prefix_size is at most 32, the last byte being the slot
+    RangeIter(
+        Gadgets_ptr gadgets,
+        const NodeId &root_id,
+        const byte* prefix, size_t prefix_size
+    );
+    ~RangeIter();
+
+    RangeIter(const RangeIter&) = delete;
+    RangeIter& operator=(const RangeIter&) = delete;
+
+    // OK with the next entry, ITER_END once there are none
+    int next(Hash* key_hash, uint8_t* slot, Hash* val_hash);
+
+    // every live node under the prefix in key order, parents first.
+    // buf is only valid for the life of the iterator
+    int next_node(NodeId* id, const byte** buf, size_t* size);
+};
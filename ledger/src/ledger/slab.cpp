@@ -0,0 +1,170 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "slab.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <new>
+
+namespace {
+    // stripes are handed out in the order threads first allocate
+    std::atomic<size_t> next_stripe{0};
+    thread_local size_t tls_stripe = next_stripe.fetch_add(1) % SLAB_STRIPES;
+}
+
+SlabClass::SlabClass(size_t slot_size) :
+    slot_size_(slot_size),
+    slots_per_slab_(SLAB_BYTES / slot_size),
+    free_(nullptr),
+    bump_(nullptr),
+    bump_end_(nullptr)
+{
+    assert(slot_size_ >= sizeof(FreeSlot));
+    assert(slot_size_ % SLAB_ALIGN == 0);
+    if (slots_per_slab_ == 0) slots_per_slab_ = 1;
+}
+
+SlabClass::~SlabClass() {
+    // every slot should have been handed back by now
+    assert(stats().in_use == 0);
+}
+
+void SlabClass::SlabDeleter::operator()(std::byte* p) const {
+    ::operator delete[](p, std::align_val_t(SLAB_ALIGN));
+}
+
+void SlabClass::carve() {
+    size_t bytes = slots_per_slab_ * slot_size_;
+    auto slab = static_cast<std::byte*>(
+        ::operator new[](bytes, std::align_val_t(SLAB_ALIGN))
+    );
+    slabs_.emplace_back(slab);
+
+    bump_ = slab;
+    bump_end_ = slab + bytes;
+}
+
+SlabClass::Stripe& SlabClass::own_stripe() {
+    return stripes_[tls_stripe];
+}
+
+void SlabClass::refill(Stripe &s) {
+    std::lock_guard lock(mux_);
+
+    for (size_t k{}; k < SLAB_BATCH && free_; k++) {
+        FreeSlot* slot = free_;
+        free_ = slot->next;
+
+        slot->next = s.free;
+        s.free = slot;
+        s.count++;
+    }
+    if (s.free) return;
+
+    if (bump_ == bump_end_) carve();
+
+    size_t run = std::min<size_t>(SLAB_BATCH, (bump_end_ - bump_) / slot_size_);
+    s.bump = bump_;
+    s.bump_end = bump_ + run * slot_size_;
+    bump_ = s.bump_end;
+}
+
+void SlabClass::drain(Stripe &s) {
+    FreeSlot* first = s.free;
+    FreeSlot* last = first;
+    for (size_t k = 1; k < SLAB_BATCH; k++) last = last->next;
+
+    s.free = last->next;
+    s.count -= SLAB_BATCH;
+
+    std::lock_guard lock(mux_);
+    last->next = free_;
+    free_ = first;
+}
+
+void* SlabClass::allocate() {
+    Stripe &s = own_stripe();
+    std::lock_guard lock(s.mux);
+    s.in_use++;
+
+    if (!s.free && s.bump == s.bump_end) refill(s);
+
+    if (s.free) {
+        FreeSlot* slot = s.free;
+        s.free = slot->next;
+        s.count--;
+        s.recycled++;
+        return slot;
+    }
+
+    void* slot = s.bump;
+    s.bump += slot_size_;
+    return slot;
+}
+
+void SlabClass::deallocate(void* p) {
+    Stripe &s = own_stripe();
+    std::lock_guard lock(s.mux);
+
+    auto slot = static_cast<FreeSlot*>(p);
+    slot->next = s.free;
+    s.free = slot;
+    s.count++;
+    s.in_use--;
+
+    if (s.count > 2 * SLAB_BATCH) drain(s);
+}
+
+SlabStats SlabClass::stats() {
+    size_t in_use{};
+    size_t recycled{};
+    for (auto &s: stripes_) {
+        std::lock_guard lock(s.mux);
+        in_use += s.in_use;
+        recycled += s.recycled;
+    }
+
+    std::lock_guard lock(mux_);
+    return {
+        slot_size_,
+        slabs_.size(),
+        slabs_.size() * slots_per_slab_,
+        in_use,
+        recycled
+    };
+}
+
+SlabAllocator::SlabAllocator() {
+    for (size_t i{}; i < SLAB_CLASSES; i++)
+        classes_[i] = std::make_unique<SlabClass>((i + 1) * SLAB_ALIGN);
+}
+
+SlabClass* SlabAllocator::class_for(size_t size) {
+    if (size == 0 || size > SLAB_MAX_SLOT) return nullptr;
+    return classes_[(size - 1) / SLAB_ALIGN].get();
+}
+
+std::vector<SlabStats> SlabAllocator::stats() {
+    std::vector<SlabStats> out;
+    for (auto &c: classes_) {
+        SlabStats s = c->stats();
+        if (s.slabs) out.push_back(s);
+    }
+    return out;
+}
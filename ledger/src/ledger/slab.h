@@ -0,0 +1,130 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  Size classed slab allocator for trie nodes.
+ *
+ *  Each class hands out fixed size slots carved from
+ *  SLAB_BYTES sized slabs. Freed slots go onto an intrusive
+ *  freelist and are reused before a new slab is carved, 
+ *  so cache churn recycles memory instead of going through malloc.
+ *  Slabs are only released when the allocator is.
+ *
+ *  Every class keeps a freelist per thread stripe, and a thread
+ *  always goes to the same one, so workers applying different
+ *  subtrees don't meet on a lock. A stripe refills from the shared 
+ *  list, or a fresh run of the newest slab, SLAB_BATCH slots at 
+ *  a time, and hands a batch back once it holds too many.
+ */
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+const size_t SLAB_ALIGN = 64;
+const size_t SLAB_CLASSES = 32;
+const size_t SLAB_MAX_SLOT = SLAB_ALIGN * SLAB_CLASSES;
+const size_t SLAB_BYTES = 64 * 1024;
+
+// threads are spread over this many freelists per class
+const size_t SLAB_STRIPES = 16;
+
+// slots a stripe takes from, or gives back to, the shared list at once
+const size_t SLAB_BATCH = 32;
+
+// must match extern.h / ffi.rs
+struct SlabStats {
+    size_t slot_size;
+    size_t slabs;
+    size_t capacity;
+    size_t in_use;
+    size_t recycled;
+};
+
+class SlabClass {
+private:
+    struct FreeSlot { FreeSlot* next; };
+    struct SlabDeleter { void operator()(std::byte* p) const; };
+
+    // one thread's freelist, padded so stripes don't share a line
+    struct alignas(SLAB_ALIGN) Stripe {
+        std::mutex mux;
+        FreeSlot* free{nullptr};
+        size_t count{};
+
+        // a run of fresh slots taken from the newest slab
+        std::byte* bump{nullptr};
+        std::byte* bump_end{nullptr};
+
+        // a slot freed on another stripe counts against this one,
+        // only the sum over stripes means anything
+        size_t in_use{};
+        size_t recycled{};
+    };
+
+    size_t slot_size_;
+    size_t slots_per_slab_;
+
+    std::array<Stripe, SLAB_STRIPES> stripes_;
+
+    std::mutex mux_;
+    std::vector<std::unique_ptr<std::byte[], SlabDeleter>> slabs_;
+
+    // slots stripes have handed back, then untouched ones of the newest slab
+    FreeSlot* free_;
+    std::byte* bump_;
+    std::byte* bump_end_;
+
+    void carve();
+
+    Stripe& own_stripe();
+
+    // up to SLAB_BATCH recycled slots, or else fresh ones, into s
+    void refill(Stripe &s);
+
+    // SLAB_BATCH of s's free slots back to the shared list
+    void drain(Stripe &s);
+
+public:
+    explicit SlabClass(size_t slot_size);
+    ~SlabClass();
+
+    void* allocate();
+    void deallocate(void* p);
+
+    size_t slot_size() const { return slot_size_; }
+    SlabStats stats();
+};
+
+class SlabAllocator {
+private:
+    std::array<std::unique_ptr<SlabClass>, SLAB_CLASSES> classes_;
+
+public:
+    SlabAllocator();
+
+    // nullptr if size is too big for any class
+    SlabClass* class_for(size_t size);
+
+    // only classes that have carved a slab
+    std::vector<SlabStats> stats();
+};
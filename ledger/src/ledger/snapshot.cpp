@@ -0,0 +1,196 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "snapshot.h"
+#include "node_view.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// ids are one byte per level so a path can't be longer than a key
+const size_t MAX_READ_DEPTH = 32;
+
+Snapshot::Snapshot(Gadgets_ptr gadgets, const NodeId &root_id) :
+    gadgets_(gadgets),
+    root_id_(root_id),
+    trx_(gadgets->alloc.db_.start_rd_txn())
+{}
+
+Snapshot::~Snapshot() {
+    // nothing was written, aborting just releases the reader slot
+    gadgets_->alloc.db_.end_txn(trx_, 1);
+}
+
+// lookups in flight at once in multi_get
+const size_t MULTI_GET_WIDTH = 8;
+
+// step result meaning the lookup moves on to next
+const int DESCEND = -1;
+
+const size_t CACHE_LINE = 64;
+
+// lines of a node prefetched into cache. a node bigger than 
+// this, a dense branch on overflow pages, has its pages read
+// ahead by the kernel instead
+const size_t PREFETCH_LINES = 64;
+
+// mdb_get only finds where a node is, for one on overflow pages
+// the data is untouched until read. starts it coming in so the
+// other lanes' turns hide the miss or fault
+static void prefetch_node(const byte* buf, size_t size) {
+    size_t lines = std::min(size, PREFETCH_LINES * CACHE_LINE);
+    for (size_t off{}; off < lines; off += CACHE_LINE) 
+        __builtin_prefetch(buf + off, 0, 1);
+
+    if (size <= lines) return;
+
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = reinterpret_cast<uintptr_t>(buf) & ~(page - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(buf) + size;
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+}
+
+// one level of a lookup, on a node already fetched
+static int read_step(
+    const NodeId &id,
+    const Hash* key_hash,
+    const byte* buf, size_t size,
+    NodeId* next,
+    Hash* out
+) {
+    if (size == 0) return INVALID_NODE;
+
+    if (is_branch_type(buf[0])) {
+        BranchView view(buf, size);
+        if (!view.valid()) return INVALID_NODE;
+
+        uint8_t level = id.get_level();
+        if (!view.ext_matches(key_hash->h, level)) return NOT_EXIST;
+
+        if (!view.get_next_id(&id, key_hash->h[view.key_level(level)], next)) 
+            return NOT_EXIST;
+
+        return DESCEND;
+    }
+
+    LeafView view(buf, size);
+    if (!view.valid()) return INVALID_NODE;
+    if (!view.matches(key_hash, id.get_level())) return NOT_EXIST;
+
+    const byte* val = view.get_value(key_hash->h[31]);
+    if (!val) return NOT_EXIST;
+
+    std::memcpy(out->h, val, 32);
+    if (hash_is_zero(*out)) return NOT_EXIST;
+
+    return OK;
+}
+
+int Snapshot::get(const Hash* key_hash, Hash* out) const {
+    BulletDB &db = gadgets_->alloc.db_;
+    std::lock_guard lock(mux_);
+
+    NodeId id {root_id_};
+    NodeId next_id;
+
+    for (size_t depth{}; depth < MAX_READ_DEPTH; depth++) {
+        const void* data = nullptr;
+        size_t size = 0;
+
+        int rc = db.get_view(id.get_full(), id.size(), &data, &size, trx_);
+        if (rc == MDB_NOTFOUND) return NOT_EXIST;
+        if (rc != OK) return rc;
+
+        rc = read_step(id, key_hash, static_cast<const byte*>(data), size, &next_id, out);
+        if (rc != DESCEND) return rc;
+
+        id = next_id;
+    }
+
+    return INVALID_NODE;
+}
+
+struct Descent {
+    size_t key;
+    NodeId id;
+    const byte* buf;
+    size_t size;
+    size_t depth;
+};
+
+void Snapshot::multi_get(
+    const Hash* key_hashes, size_t n,
+    Hash* outs, int* results
+) const {
+    BulletDB &db = gadgets_->alloc.db_;
+    std::lock_guard lock(mux_);
+
+    Descent lanes[MULTI_GET_WIDTH];
+    size_t active{};
+    size_t next_key{};
+
+    while (active < MULTI_GET_WIDTH && next_key < n) 
+        lanes[active++] = {next_key++, root_id_, nullptr, 0, 0};
+
+    NodeId next_id;
+    while (active) {
+        for (size_t l{}; l < active;) {
+            Descent &d = lanes[l];
+            int rc{DESCEND};
+
+            if (!d.buf) {
+                // find the node and prefetch it, then come 
+                // back once the other lanes have had a turn
+                const void* data = nullptr;
+                rc = db.get_view(d.id.get_full(), d.id.size(), &data, &d.size, trx_);
+
+                if (rc == OK) {
+                    d.buf = static_cast<const byte*>(data);
+                    prefetch_node(d.buf, d.size);
+                    l++;
+                    continue;
+                }
+                if (rc == MDB_NOTFOUND) rc = NOT_EXIST;
+
+            } else {
+                rc = read_step(d.id, &key_hashes[d.key], d.buf, d.size, &next_id, &outs[d.key]);
+
+                if (rc == DESCEND) {
+                    d.id = next_id;
+                    d.buf = nullptr;
+                    if (++d.depth < MAX_READ_DEPTH) {
+                        l++;
+                        continue;
+                    }
+                    rc = INVALID_NODE;
+                }
+            }
+
+            // done, the lane takes the next key or is dropped
+            results[d.key] = rc;
+            if (next_key < n) {
+                d = {next_key++, root_id_, nullptr, 0, 0};
+                l++;
+            } else {
+                d = lanes[--active];
+            }
+        }
+    }
+}
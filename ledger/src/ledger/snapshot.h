@@ -0,0 +1,74 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  A consistent, read only view of one block's trie.
+ *
+ *  Holds an LMDB read txn for its whole life, so every read sees
+ *  the trie as it was on disk when the snapshot was opened whatever
+ *  blocks are applied, finalized or justified meanwhile. Reads walk
+ *  the pages through node views and never touch the node cache.
+ *
+ *  On disk the cannonical trie is current as of its last justify,
+ *  and a pending block as of its finalize. a pending block changed
+ *  since is half applied there, so the ledger won't open one then.
+ *
+ *  An LMDB txn is used by one thread at a time, so reads on the
+ *  same snapshot take turns. Threads wanting to read in parallel
+ *  each open their own, that costs a reader slot and nothing else.
+ */
+
+#pragma once
+#include "gadgets.h"
+#include "hashing.h"
+#include "nodeid.h"
+#include <mutex>
+
+class Snapshot {
+private:
+    Gadgets_ptr gadgets_;
+    NodeId root_id_;
+    void* trx_;
+    mutable std::mutex mux_;
+
+public:
+    Snapshot(Gadgets_ptr gadgets, const NodeId &root_id);
+    ~Snapshot();
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    uint16_t block_id() const { return root_id_.get_block_id(); }
+
+    // value hash under key_hash (last byte the value index),
+    // NOT_EXIST if there isn't one
+    int get(const Hash* key_hash, Hash* out) const;
+
+    /*
+     *  get for n keys at once, results[i] is what get would return.
+     *  several descents take turns a level at a time on this thread,
+     *  all under the one read txn. a lane prefetches the node it
+     *  found, or has the kernel read ahead the overflow pages of a
+     *  big one, and reads it on its next turn, so the other lanes'
+     *  work covers the miss.
+     */
+    void multi_get(
+        const Hash* key_hashes, size_t n,
+        Hash* outs, int* results
+    ) const;
+};
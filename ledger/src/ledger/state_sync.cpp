@@ -0,0 +1,500 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "state_sync.h"
+#include "fft.h"
+#include "helpers.h"
+#include "node_view.h"
+#include "polynomial.h"
+#include "state_types.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <unordered_set>
+
+using Record = ChunkExporter::Record;
+
+const size_t CHUNK_HEADER_SIZE = 1 + 32 + 32 + 1 + sizeof(uint32_t);
+const size_t RECORD_HEADER_SIZE = ID_SIZE + sizeof(uint32_t);
+
+// a forged chunk gets through the combined check with odds 2^-128
+const size_t COMBINE_BYTES = 16;
+
+ChunkExporter::ChunkExporter(
+    Gadgets_ptr gadgets, 
+    const NodeId &root_id, 
+    uint8_t depth
+) :
+    it_(gadgets, root_id, nullptr, 0),
+    cut_level_(root_id.get_level() + depth),
+    pending_{},
+    has_pending_{},
+    exported_{}
+{}
+
+static void write_chunk(
+    const std::vector<Record> &boundary,
+    const std::vector<Record> &nodes,
+    std::vector<byte> &out
+) {
+    const NodeId &top = nodes.front().id;
+    size_t path_len = std::min<size_t>(top.get_level(), ID_PATH_SIZE);
+
+    size_t size = CHUNK_HEADER_SIZE;
+    for (auto &r: boundary) size += RECORD_HEADER_SIZE + r.size;
+    for (auto &r: nodes) size += RECORD_HEADER_SIZE + r.size;
+
+    out.resize(size);
+    byte* cursor = out.data();
+
+    *cursor++ = CHUNK_VERSION;
+
+    // everything under the top node's path
+    std::memcpy(cursor, top.get_full(), path_len);
+    std::memset(cursor + path_len, 0x00, 32 - path_len);
+    cursor += 32;
+
+    std::memcpy(cursor, top.get_full(), path_len);
+    std::memset(cursor + path_len, 0xff, 32 - path_len);
+    cursor += 32;
+
+    *cursor++ = boundary.size();
+
+    uint32_t count = nodes.size();
+    std::memcpy(cursor, &count, sizeof(count));
+    cursor += sizeof(count);
+
+    auto put_record = [&](const Record &r) {
+        std::memcpy(cursor, r.id.get_full(), ID_SIZE);
+        cursor += ID_SIZE;
+
+        uint32_t len = r.size;
+        std::memcpy(cursor, &len, sizeof(len));
+        cursor += sizeof(len);
+
+        std::memcpy(cursor, r.buf, r.size);
+        cursor += r.size;
+    };
+    for (auto &r: boundary) put_record(r);
+    for (auto &r: nodes) put_record(r);
+}
+
+int ChunkExporter::next(std::vector<byte> &out) {
+    std::vector<Record> boundary;
+    std::vector<Record> nodes;
+
+    while (true) {
+        Record r;
+        if (has_pending_) {
+            r = pending_;
+            has_pending_ = false;
+        } else {
+            int rc = it_.next_node(&r.id, &r.buf, &r.size);
+            if (rc == ITER_END) break;
+            if (rc != OK) return rc;
+        }
+
+        uint8_t level = r.id.get_level();
+        bool above = level < cut_level_ && is_branch_type(r.buf[0]);
+
+        // nodes come parent first, so the chunk ends with the
+        // next node at or above the cut
+        if (level <= cut_level_ && !nodes.empty()) {
+            pending_ = r;
+            has_pending_ = true;
+            break;
+        }
+
+        while (!path_.empty() && path_.back().id.get_level() >= level) 
+            path_.pop_back();
+
+        if (above) {
+            path_.push_back(r);
+            continue;
+        }
+
+        if (nodes.empty()) boundary = path_;
+        nodes.push_back(r);
+    }
+
+    if (nodes.empty()) {
+        // nothing below the cut, the root is the whole trie
+        if (exported_ || path_.empty()) return ITER_END;
+        nodes.push_back(path_.front());
+    }
+
+    exported_ = true;
+    write_chunk(boundary, nodes, out);
+    return OK;
+}
+
+
+struct ParsedChunk {
+    Hash start;
+    Hash end;
+    // boundary first, root down
+    size_t boundary;
+    std::vector<Record> records;
+};
+
+static int parse_chunk(const ByteSlice &chunk, ParsedChunk &out) {
+    const byte* cursor = chunk.data();
+    const byte* end = cursor + chunk.size();
+
+    if (chunk.size() < CHUNK_HEADER_SIZE) return INVALID_CHUNK;
+    if (*cursor++ != CHUNK_VERSION) return INVALID_CHUNK;
+
+    std::memcpy(out.start.h, cursor, 32);
+    cursor += 32;
+    std::memcpy(out.end.h, cursor, 32);
+    cursor += 32;
+
+    out.boundary = *cursor++;
+
+    uint32_t count;
+    std::memcpy(&count, cursor, sizeof(count));
+    cursor += sizeof(count);
+    if (count == 0) return INVALID_CHUNK;
+
+    size_t total = out.boundary + count;
+    out.records.reserve(total);
+
+    for (size_t i{}; i < total; i++) {
+        if (size_t(end - cursor) < RECORD_HEADER_SIZE) return INVALID_CHUNK;
+
+        Record r;
+        r.id = NodeId(cursor);
+        cursor += ID_SIZE;
+
+        uint32_t len;
+        std::memcpy(&len, cursor, sizeof(len));
+        cursor += sizeof(len);
+        if (len == 0 || size_t(end - cursor) < len) return INVALID_CHUNK;
+
+        r.buf = cursor;
+        r.size = len;
+        cursor += len;
+
+        bool valid = is_branch_type(r.buf[0]) 
+            ? BranchView(r.buf, r.size).valid() 
+            : LeafView(r.buf, r.size).valid();
+        if (!valid) return INVALID_CHUNK;
+
+        out.records.push_back(r);
+    }
+
+    if (cursor != end) return INVALID_CHUNK;
+    return OK;
+}
+
+static Commitment record_commitment(const Record &r) {
+    if (is_branch_type(r.buf[0])) return BranchView(r.buf, r.size).commitment();
+    return LeafView(r.buf, r.size).commitment();
+}
+
+static void record_evals(const Record &r, Polynomial &Fx) {
+    if (is_branch_type(r.buf[0])) BranchView(r.buf, r.size).get_evals(Fx);
+    else LeafView(r.buf, r.size).get_evals(Fx);
+}
+
+static size_t live_children(const Record &r) {
+    BranchView view(r.buf, r.size);
+
+    size_t live{};
+    for (int k{}; k < view.children_count(); k++) {
+        blst_scalar sk;
+        BranchView::child_sk(view.child_at(k), &sk);
+        if (!scalar_is_zero(sk)) live++;
+    }
+    return live;
+}
+
+// a split commits to its ranges rather than its children, each
+// range has to be the hashed commitment to the children in it.
+// a range with none here was dropped, nothing below depends on it
+static bool ranges_bound(const KZGSettings &settings, const Record &r) {
+    BranchView view(r.buf, r.size);
+
+    for (int k{}; k < view.ranges_count(); k++) {
+        const byte* range = view.range_at(k);
+
+        Polynomial Fx(BRANCH_ORDER, ZERO_SK);
+        view.get_range_evals(range, Fx);
+        if (std::all_of(Fx.begin(), Fx.end(), scalar_is_zero)) continue;
+
+        Commitment c = commit_evals(std::move(Fx), settings);
+
+        blst_scalar sk, expect;
+        hash_p1_to_scalar(&c, &sk, &settings.tag);
+        BranchView::child_sk(range, &expect);
+        if (!equal_scalars(sk, expect)) return false;
+    }
+    return true;
+}
+
+// child hangs off parent under its own id, with its scalar
+static bool is_linked(const Record &parent, const Record &child, const blst_scalar &child_sk) {
+    if (!is_branch_type(parent.buf[0])) return false;
+    BranchView view(parent.buf, parent.size);
+
+    size_t level = view.key_level(parent.id.get_level());
+    if (level >= ID_PATH_SIZE) return false;
+    byte nib = child.id.get_full()[level];
+
+    NodeId expect;
+    if (!view.get_next_id(&parent.id, nib, &expect)) return false;
+    if (!(expect == child.id)) return false;
+
+    blst_scalar sk;
+    BranchView::child_sk(view.get_child(nib), &sk);
+    return equal_scalars(sk, child_sk);
+}
+
+// sum r_i * C_i against the commitment to sum r_i * Fx_i
+static bool check_commitments(
+    const KZGSettings &settings,
+    const std::vector<Record> &recs,
+    const std::vector<Commitment> &commits
+) {
+    size_t n = recs.size();
+    std::random_device rd;
+
+    std::vector<blst_scalar> rs(n);
+    Polynomial combined(BRANCH_ORDER, ZERO_SK);
+    Polynomial Fx(BRANCH_ORDER);
+
+    for (size_t i{}; i < n; i++) {
+        byte seed[COMBINE_BYTES];
+        for (auto &b: seed) b = static_cast<byte>(rd());
+        blst_scalar_from_le_bytes(&rs[i], seed, COMBINE_BYTES);
+
+        std::fill(Fx.begin(), Fx.end(), ZERO_SK);
+        record_evals(recs[i], Fx);
+
+        for (size_t j{}; j < BRANCH_ORDER; j++) {
+            if (scalar_is_zero(Fx[j])) continue;
+
+            blst_scalar tmp;
+            blst_sk_mul_n_check(&tmp, &Fx[j], &rs[i]);
+            blst_sk_add_n_check(&combined[j], &combined[j], &tmp);
+        }
+    }
+
+    inverse_fft_in_place(combined, settings.roots.inv_roots);
+
+    Commitment expect;
+    commit_g1_msm(&expect, combined, settings.setup);
+
+    // the point at infinity has no affine form, and adds nothing
+    std::vector<const blst_p1*> finite;
+    std::vector<blst_scalar> finite_rs;
+    for (size_t i{}; i < n; i++) {
+        if (blst_p1_is_inf(&commits[i])) continue;
+        finite.push_back(&commits[i]);
+        finite_rs.push_back(rs[i]);
+    }
+
+    Commitment got = new_p1();
+    if (!finite.empty()) {
+        std::vector<blst_p1_affine> affs(finite.size());
+        blst_p1s_to_affine(affs.data(), finite.data(), finite.size());
+
+        std::vector<limb_t> scratch(
+            blst_p1s_mult_pippenger_scratch_sizeof(finite.size()) / sizeof(limb_t)
+        );
+
+        // a null second entry means the first points at a contiguous array
+        const blst_p1_affine* points[2] = {affs.data(), nullptr};
+        const byte* scalars[2] = {finite_rs.data()->b, nullptr};
+
+        blst_p1s_mult_pippenger(
+            &got, points, finite.size(), 
+            scalars, COMBINE_BYTES * 8, 
+            scratch.data()
+        );
+    }
+
+    return blst_p1_is_equal(&got, &expect);
+}
+
+static int verify_chunk(
+    const Gadgets_ptr &gadgets,
+    const NodeId &root_id,
+    const ParsedChunk &chunk,
+    const Hash* root_hash
+) {
+    const KZGSettings &settings = gadgets->settings;
+    const std::vector<Record> &recs = chunk.records;
+    size_t n = recs.size();
+    size_t top = chunk.boundary;
+
+    std::vector<Commitment> commits(n);
+    std::vector<blst_scalar> sks(n);
+    for (size_t i{}; i < n; i++) {
+        commits[i] = record_commitment(recs[i]);
+        hash_p1_to_scalar(&commits[i], &sks[i], &settings.tag);
+    }
+
+    // the boundary runs from the root down to the top of the chunk
+    if (!(recs[0].id == root_id)) return INVALID_CHUNK;
+    if (std::memcmp(sks[0].b, root_hash->h, 32) != 0) return INVALID_CHUNK;
+
+    for (size_t i = 1; i <= top; i++) 
+        if (!is_linked(recs[i - 1], recs[i], sks[i])) return INVALID_CHUNK;
+
+    for (auto &r: recs) 
+        if (is_branch_type(r.buf[0]) && !ranges_bound(settings, r)) return INVALID_CHUNK;
+
+    // the range is the one the top node covers
+    const NodeId &top_id = recs[top].id;
+    size_t path_len = std::min<size_t>(top_id.get_level(), ID_PATH_SIZE);
+
+    Hash start = new_hash();
+    Hash end;
+    std::memset(end.h, 0xff, 32);
+    std::memcpy(start.h, top_id.get_full(), path_len);
+    std::memcpy(end.h, top_id.get_full(), path_len);
+
+    if (std::memcmp(start.h, chunk.start.h, 32) != 0) return INVALID_CHUNK;
+    if (std::memcmp(end.h, chunk.end.h, 32) != 0) return INVALID_CHUNK;
+
+    // below the top every live child is there, so open
+    // branches count theirs off as they are passed
+    struct Open {
+        size_t rec;
+        size_t live;
+        size_t seen;
+    };
+    std::vector<Open> open;
+
+    for (size_t i = top; i < n; i++) {
+        const Record &r = recs[i];
+
+        if (i > top) {
+            while (!open.empty() && !r.id.is_under(recs[open.back().rec].id)) {
+                if (open.back().seen != open.back().live) return INVALID_CHUNK;
+                open.pop_back();
+            }
+            if (open.empty()) return INVALID_CHUNK;
+
+            if (!is_linked(recs[open.back().rec], r, sks[i])) return INVALID_CHUNK;
+            open.back().seen++;
+        }
+
+        if (is_branch_type(r.buf[0])) {
+            open.push_back({i, live_children(r), 0});
+            continue;
+        }
+
+        // the stem is committed in slot 0, the id has to agree with it
+        uint8_t level = std::min<size_t>(r.id.get_level(), ID_PATH_SIZE);
+        if (std::memcmp(LeafView(r.buf, r.size).path(), r.id.get_full(), level) != 0) 
+            return INVALID_CHUNK;
+    }
+
+    for (; !open.empty(); open.pop_back()) 
+        if (open.back().seen != open.back().live) return INVALID_CHUNK;
+
+    if (!check_commitments(settings, recs, commits)) return INVALID_CHUNK;
+
+    return OK;
+}
+
+// every live child of every boundary branch is the top of a chunk or
+// a record in one. each chunk only vouches for what's under its top,
+// a subset of them would leave the boundary linking to nothing
+static bool chunks_cover(const std::vector<ParsedChunk> &parsed) {
+    std::unordered_set<NodeId, NodeIdHash> ids;
+    for (auto &chunk: parsed) 
+        for (auto &r: chunk.records) ids.insert(r.id);
+
+    // boundaries repeat across chunks, each is checked once
+    std::unordered_set<NodeId, NodeIdHash> checked;
+    NodeId child;
+
+    for (auto &chunk: parsed) {
+        for (size_t i{}; i < chunk.boundary; i++) {
+            const Record &r = chunk.records[i];
+            if (!checked.insert(r.id).second) continue;
+
+            BranchView view(r.buf, r.size);
+            for (int k{}; k < view.children_count(); k++) {
+                const byte* c = view.child_at(k);
+
+                blst_scalar sk;
+                BranchView::child_sk(c, &sk);
+                if (scalar_is_zero(sk)) continue;
+
+                if (!view.get_next_id(&r.id, BranchView::child_anchor(c), &child)) return false;
+                if (!ids.count(child)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+int import_chunks(
+    const Gadgets_ptr &gadgets,
+    const NodeId &root_id,
+    const std::vector<ByteSlice> &chunks,
+    const Hash* root_hash
+) {
+    size_t n = chunks.size();
+
+    std::vector<ParsedChunk> parsed(n);
+    std::vector<int> codes(n, OK);
+    {
+        TaskGroup tasks(gadgets->pool);
+        for (size_t i{}; i < n; i++) {
+            tasks.spawn([&, i] {
+                codes[i] = parse_chunk(chunks[i], parsed[i]);
+                if (codes[i] == OK) 
+                    codes[i] = verify_chunk(gadgets, root_id, parsed[i], root_hash);
+            });
+        }
+        tasks.wait();
+    }
+
+    for (int rc: codes) 
+        if (rc != OK) return rc;
+
+    if (!chunks_cover(parsed)) return MISSING_CHUNK;
+
+    // lmdb has the one writer, so the writes go in together.
+    // boundaries repeat across chunks with the same bytes
+    NodeAllocator &alloc = gadgets->alloc;
+    void* trx = alloc.db_.start_txn();
+
+    int rc{OK};
+    for (auto &chunk: parsed) {
+        for (auto &r: chunk.records) {
+            rc = alloc.db_.put(r.id.get_full(), r.id.size(), r.buf, r.size, trx);
+            if (rc != OK) break;
+        }
+        if (rc != OK) break;
+    }
+    alloc.db_.end_txn(trx, rc);
+    if (rc != OK) return rc;
+
+    // whatever was cached under these ids is stale now
+    for (auto &chunk: parsed) 
+        for (auto &r: chunk.records) alloc.evict_node(&r.id);
+
+    return OK;
+}
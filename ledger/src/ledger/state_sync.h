@@ -0,0 +1,94 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  Bootstrapping a replica from chunks of the cannonical trie
+ *  instead of replaying its history.
+ *
+ *  The trie is cut a fixed depth below the shard root. A chunk is
+ *  one subtree at that depth (or a leaf above it) with every live
+ *  node under it, plus the branches above it back to the root as 
+ *  its boundary proof. Nodes travel with their commitments, so a 
+ *  chunk checks out against the root hash alone:
+ *      - the root's scalar is the root hash
+ *      - every node hangs off its parent under its own id,
+ *        with the scalar of its commitment
+ *      - every branch below the cut has all its live children
+ *      - stored commitments are those of the nodes' evaluations.
+ *        that is checked for the whole chunk at once through a 
+ *        random linear combination, one msm a chunk not one a node
+ *
+ *  Layout, node records in key order and the boundary first:
+ *      version         1 byte
+ *      start, end      32 bytes each, the key range covered
+ *      boundary count  1 byte
+ *      node count      4 bytes
+ *      records         [id 16][size 4][node bytes] ...
+ */
+
+#pragma once
+#include "gadgets.h"
+#include "hashing.h"
+#include "nodeid.h"
+#include "range_iter.h"
+#include <vector>
+
+const uint8_t CHUNK_VERSION = 1;
+
+class ChunkExporter {
+public:
+    struct Record {
+        NodeId id;
+        const byte* buf;
+        size_t size;
+    };
+
+private:
+    RangeIter it_;
+    uint8_t cut_level_;
+
+    // branches above the cut on the current path
+    std::vector<Record> path_;
+
+    // read ahead, the first node of the next chunk
+    Record pending_;
+    bool has_pending_;
+    bool exported_;
+
+public:
+    // depth is how far below the shard root the trie is cut,
+    // more depth means more, smaller chunks
+    ChunkExporter(Gadgets_ptr gadgets, const NodeId &root_id, uint8_t depth);
+
+    // OK with the next chunk, ITER_END once there are none
+    int next(std::vector<byte> &out);
+};
+
+/*
+ *  Verifies every chunk against root_hash, in parallel, 
+ *  then writes them all in one txn. Nothing is written unless 
+ *  every chunk checks out, and together they hold every live
+ *  node under the root (MISSING_CHUNK if not). Meant for a 
+ *  fresh ledger.
+ */
+int import_chunks(
+    const Gadgets_ptr &gadgets,
+    const NodeId &root_id,
+    const std::vector<ByteSlice> &chunks,
+    const Hash* root_hash
+);
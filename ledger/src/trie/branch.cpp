@@ -21,81 +21,164 @@
 #include "hashing.h"
 #include "helpers.h"
 #include "leaf.h"
+#include "node_view.h"
 #include "polynomial.h"
 #include "state_types.h"
 #include <cstring>
 
+// anchor, end, scalar and block id for each, then each ones weight
+static const size_t ENTRY_SIZE = 2 * sizeof(uint8_t) + sizeof(blst_scalar) + sizeof(uint16_t);
+
+static byte* read_entries(byte* cursor, std::vector<Child> &out, bool weighted) {
+    for (auto &child: out) {
+        child.anchor = *cursor++;
+        child.end = *cursor++;
+
+        blst_scalar_from_le_bytes(&child.sk, cursor, sizeof(blst_scalar));
+        cursor += sizeof(blst_scalar);
+
+        std::memcpy(&child.blk_id, cursor, sizeof(uint16_t));
+        cursor += sizeof(uint16_t);
+    }
+    if (!weighted) return cursor;
+
+    for (auto &child: out) {
+        std::memcpy(&child.weight.leaves, cursor, sizeof(uint32_t));
+        cursor += sizeof(uint32_t);
+        std::memcpy(&child.weight.bytes, cursor, sizeof(uint64_t));
+        cursor += sizeof(uint64_t);
+    }
+    return cursor;
+}
+
+static byte* write_entries(byte* cursor, const std::vector<Child> &entries) {
+    for (auto &child: entries) {
+        *cursor++ = child.anchor;
+        *cursor++ = child.end;
+
+        std::memcpy(cursor, &child.sk.b, sizeof(blst_scalar));
+        cursor += sizeof(blst_scalar);
+
+        std::memcpy(cursor, &child.blk_id, sizeof(uint16_t));
+        cursor += sizeof(uint16_t);
+    }
+    for (auto &child: entries) {
+        std::memcpy(cursor, &child.weight.leaves, sizeof(uint32_t));
+        cursor += sizeof(uint32_t);
+        std::memcpy(cursor, &child.weight.bytes, sizeof(uint64_t));
+        cursor += sizeof(uint64_t);
+    }
+    return cursor;
+}
+
 Branch::Branch(
     Gadgets_ptr gadgets, 
     const NodeId* id, 
     const ByteSlice* buff
 ) :
     id_(id),
-    commit_{new_inf_p1()},
     is_split_{false},
     gadgets_{gadgets}
 {
     if (buff == nullptr) { return; }
 
     byte* cursor = buff->data(); 
-    cursor++;
+    byte type = *cursor++;
 
     is_split_ = *cursor++;
 
-    commit_ = p1_from_bytes(cursor); 
-    cursor += blst_p1_sizeof();
+    bool v2 = type == BRANCH_V2;
+    if (v2) {
+        commit_.read_v2(cursor);
+        cursor += COMMIT_V2_SIZE;
+
+        uint8_t ext_size = *cursor++;
+        ext_.assign(cursor, cursor + ext_size);
+        cursor += ext_size;
+    } else {
+        commit_.read_compressed(cursor);
+        cursor += blst_p1_sizeof();
+    }
 
     uint8_t children_count = *cursor++; 
     children_.assign(children_count, {});
+    cursor = read_entries(cursor, children_, v2);
 
-    for (auto &child: children_) {
-         child.anchor = *cursor++;
-         child.end = *cursor++;
+    for (auto &child: children_) anchors_.set(child.anchor);
 
-        blst_scalar_from_le_bytes(&child.sk, cursor, sizeof(blst_scalar));
-        cursor += sizeof(blst_scalar);
+    // only a v2 split has its ranges written
+    if (!v2 || !is_split_) return;
 
-        std::memcpy(&child.blk_id, cursor, sizeof(uint16_t));
-        cursor += sizeof(uint16_t);
-    }
+    uint8_t ranges_count = *cursor++;
+    ranges_.assign(ranges_count, {});
+    read_entries(cursor, ranges_, true);
 }
 
 
-std::vector<byte> Branch::to_bytes() const {
-
-    std::vector<byte> buffer(
-        sizeof(BRANCH) + 
-        sizeof(is_split_) +
-        blst_p1_sizeof() + 
+size_t branch_encoded_size(
+    size_t ext_size, 
+    size_t children, 
+    bool is_split, 
+    size_t ranges
+) {
+    return (
+        sizeof(BRANCH_V2) + 
+        sizeof(is_split) +
+        COMMIT_V2_SIZE + 
+        sizeof(uint8_t) + ext_size +
         sizeof(uint8_t) +
-        (children_.size() * (
-            (2 * sizeof(uint8_t)) + 
-            sizeof(blst_scalar) + 
-            sizeof(uint16_t)
-        ))
+        children * (ENTRY_SIZE + WEIGHT_SIZE) +
+        (is_split ? sizeof(uint8_t) + ranges * (ENTRY_SIZE + WEIGHT_SIZE) : 0)
     );
+}
 
-    byte* cursor = buffer.data();
+size_t encode_branch(
+    byte* out,
+    bool is_split,
+    const LazyCommitment &commit,
+    const std::string* tag,
+    const byte* ext, size_t ext_size,
+    const std::vector<Child> &children,
+    const std::vector<Child> &ranges
+) {
+    byte* cursor = out;
 
-    *cursor++ = BRANCH; 
+    *cursor++ = BRANCH_V2; 
 
-    *cursor++ = is_split_; 
+    *cursor++ = is_split; 
 
-    blst_p1_compress(cursor, &commit_); 
-    cursor += blst_p1_sizeof();
+    commit.write_v2(cursor, tag); 
+    cursor += COMMIT_V2_SIZE;
 
-    *cursor++ = children_.size(); 
-    for (auto &child: children_) {
-        *cursor++ = child.anchor;
-        *cursor++ = child.end;
+    *cursor++ = ext_size;
+    if (ext_size) std::memcpy(cursor, ext, ext_size);
+    cursor += ext_size;
 
-        std::memcpy(cursor, &child.sk.b, sizeof(blst_scalar));
-        cursor += sizeof(blst_scalar);
+    *cursor++ = children.size(); 
+    cursor = write_entries(cursor, children);
 
-        std::memcpy(cursor, &child.blk_id, sizeof(uint16_t));
-        cursor += sizeof(uint16_t);
+    if (is_split) {
+        *cursor++ = ranges.size(); 
+        cursor = write_entries(cursor, ranges);
     }
 
+    return cursor - out;
+}
+
+size_t Branch::encoded_size() const {
+    return branch_encoded_size(ext_.size(), children_.size(), is_split_, ranges_.size());
+}
+
+size_t Branch::encode(byte* out) const {
+    return encode_branch(
+        out, is_split_, commit_, &gadgets_->settings.tag,
+        ext_.data(), ext_.size(), children_, ranges_
+    );
+}
+
+std::vector<byte> Branch::to_bytes() const {
+    std::vector<byte> buffer(encoded_size());
+    encode(buffer.data());
     return buffer;
 }
 
@@ -108,20 +191,13 @@ void Branch::insert_child(
     if (!end.has_value()) end = nib;
 
     Child* child = get_child(nib);
-    if (!child && !is_split_) {
-
-        int i{};
-        for (; i < children_.size(); i++)
-            if (nib < children_[i].anchor) break;
+    if (!child) {
 
-        children_.resize(children_.size() + 1);
-
-        Child tmp = {nib, end.value(), ZERO_SK, block_id};
+        Child tmp = {nib, end.value(), ZERO_SK, block_id, {}};
         tmp.sk.b[0] = 1;
 
-        for (; i < children_.size(); i++) {
-            std::swap(tmp, children_[i]);
-        }
+        children_.insert(children_.begin() + anchors_.rank(nib), tmp);
+        anchors_.set(nib);
 
         return;
     }
@@ -131,32 +207,22 @@ void Branch::insert_child(
 }
 
 void Branch::delete_child(byte nib) {
-    int i{};
-    for (; i < children_.size(); i++) {
-        Child* child = &children_[i];
-
-        if (child->anchor <= nib && nib <= child->end) 
-            break;
-    }
-
-    i++;
-
-    for (; i < children_.size(); i++) {
-        std::swap(children_[i - 1], children_[i]);
-    }
+    Child* child = get_child(nib);
+    if (!child) return;
 
-    children_.pop_back();
+    anchors_.clear(child->anchor);
+    children_.erase(children_.begin() + (child - children_.data()));
 }
 
 
 Child* Branch::get_child(byte nib) {
+    size_t i = anchors_.rank(nib + 1);
+    if (i == 0) return nullptr;
+
+    // closest anchor at or below nib
+    Child* child = &children_[i - 1];
+    if (nib <= child->end) return child;
 
-    // find child such that i < child.end && child.anchor < i
-    for (int k{}; k < children_.size(); k++) {
-        auto &child = children_[k];
-        if (child.anchor <= nib && nib <= child.end) 
-            return &child;
-    }
     return nullptr;
 }
 
@@ -167,47 +233,59 @@ const NodeId* Branch::get_next_id(byte nib) {
 
     if (scalar_is_zero(child->sk)) return nullptr;
 
-    tmp_id_ = id_;
-    tmp_id_.set_block_id(child->blk_id);
+    child_id(nib, child->blk_id, &tmp_id_);
+    return &tmp_id_;
+}
 
-    tmp_id_.set_child_nibble(nib);
-    if (!is_split_) tmp_id_.increment_level();
+void Branch::child_id(byte nib, uint16_t block_id, NodeId* out) const {
+    *out = id_;
+    out->set_block_id(block_id);
 
-    return &tmp_id_;
+    // the extension's bytes are part of every child's path
+    out->append_path(ext_.data(), ext_.size());
+    out->append_path(&nib, 1);
 }
 
 int Branch::generate_proof(
     const Hash* key,
     std::vector<Polynomial> &Fxs,
     std::vector<blst_p1> &Cs,
-    Bitmap<8>* split_map
+    ProofShape* shape
 ) {
     uint8_t lvl = id_.get_level();
+    if (!ext_matches(key)) return NOT_EXIST;
 
-    byte child_nib = key->h[lvl];
+    byte child_nib = key->h[key_level()];
 
     const NodeId* next_id = get_next_id(child_nib);
     if (!next_id) return NOT_EXIST;
 
-    Result<Node_ptr, int> res = gadgets_->alloc.load_node(next_id);
-    if (res.is_err()) return res.unwrap_err();
-
     if (is_split_) {
-        split_map->set(lvl);
+        shape->split_map.set(lvl);
     }
 
-    int rc = res.unwrap()->generate_proof(key, Fxs, Cs, split_map);
+    // read only, so uncached nodes below are read through views
+    int rc = read_generate_proof(gadgets_, next_id, key, Fxs, Cs, shape);
     if (rc != OK) return rc;
 
-    Polynomial Fx(BRANCH_ORDER, ZERO_SK);
-    for (auto &child: children_) {
-        for (int i = child.anchor; i <= child.end; i++) {
-            Fx[i] = child.sk;
-        }
+    // the key's range goes between this and the child, 
+    // opened at the same key byte as this
+    if (is_split_) {
+        Polynomial range_Fx(BRANCH_ORDER, ZERO_SK);
+        fill_range_evals(*get_range(child_nib), range_Fx);
+
+        shape->skips.push_back(0);
+        Cs.push_back(commit_evals(range_Fx, gadgets_->settings));
+        Fxs.push_back(std::move(range_Fx));
     }
 
+    Polynomial Fx(BRANCH_ORDER, ZERO_SK);
+    fill_evals(Fx);
+
+    shape->skips.push_back(ext_.size());
+
     Fxs.push_back(Fx);
-    Cs.push_back(commit_);
+    Cs.push_back(*commit_.get());
 
     return OK;
 }
@@ -217,111 +295,312 @@ int Branch::replace(
     const Hash* val_hash,
     const Hash* prev_val_hash,
     uint16_t block_id
-) {
-
-    // if this is a split we pass the same nibble to get_next_id
-    // in get_next_id we skip incrementing the level
-    // this means the child id is a duplicate plus an additional nibble
-    // that way when it tries to grab a nibble from the key using level 
-    // it is not off by one
-
-    uint8_t lvl = id_.get_level();
-    byte child_nib = key->h[(is_split_) ? lvl - 1 : lvl];
+) { 
+    if (!ext_matches(key)) return NOT_EXIST;
+    byte nib = child_nib(key);
 
-    const NodeId* next_id = get_next_id(child_nib);
+    const NodeId* next_id = get_next_id(nib);
     if (!next_id) return NOT_EXIST;
 
     Result<Node_ptr, int> res = gadgets_->alloc.load_node(next_id);
     if (res.is_err()) return res.unwrap_err();
 
     int rc = res.unwrap()->replace(key, val_hash, prev_val_hash, block_id);
-    if (rc != OK) return rc;
 
-    if (id_.get_block_id() != block_id) {
-        rc = recache(block_id);
-        if (rc != OK) return rc;
-    }
-
-    insert_child(child_nib, block_id);
-
-    return OK;
+    return settle_child(nib, false, rc, block_id);
 }
 
 int Branch::remove(
     const Hash* key,
     uint16_t block_id
-) {
-
-    // if this is a split we pass the same nibble to get_next_id
-    // in get_next_id we skip incrementing the level
-    // this means the child id is a duplicate plus an additional nibble
-    // that way when it tries to grab a nibble from the key using level 
-    // it is not off by one
-
-    uint8_t lvl = id_.get_level();
-    byte child_nib = key->h[(is_split_) ? lvl - 1 : lvl];
+) { 
+    if (!ext_matches(key)) return NOT_EXIST;
+    byte nib = child_nib(key);
 
-    const NodeId* next_id = get_next_id(child_nib);
+    const NodeId* next_id = get_next_id(nib);
     if (!next_id) return NOT_EXIST;
 
     Result<Node_ptr, int> res = gadgets_->alloc.load_node(next_id);
     if (res.is_err()) return res.unwrap_err();
 
     int rc = res.unwrap()->remove(key, block_id);
-    if (rc != DELETED && rc != OK) return rc;
+
+    return settle_child(nib, true, rc, block_id);
+}
+
+byte Branch::child_nib(const Hash* key) const {
+    return key->h[key_level()];
+}
+
+int Branch::settle_child(
+    byte nib, 
+    bool removing, 
+    int rc, 
+    uint16_t block_id
+) {
+    if (rc != OK && !(removing && rc == DELETED)) return rc;
 
     // ensure new cached node to be modified
     if (id_.get_block_id() != block_id) {
-        rc = recache(block_id);
-        if (rc != OK) return rc;
+        int cache_rc = recache(block_id);
+        if (cache_rc != OK) return cache_rc;
     }
 
+    if (!removing) {
+        insert_child(nib, block_id);
+        return settle_weight(nib, block_id);
+    }
 
-    Child* child = get_child(child_nib);
+    Child* child = get_child(nib);
     if (!child || scalar_is_zero(child->sk)) 
         return ALREADY_DELETED;
 
     child->blk_id = block_id;
 
-    if (rc == DELETED) {
+    if (rc != DELETED) return settle_weight(nib, block_id);
 
-        delete_child(child_nib);
+    delete_child(nib);
 
-        if (children_.size() == 0) {
-            auto res = gadgets_->alloc.delete_node(&id_);
-            if (res.is_err() && res.unwrap_err() != MDB_NOTFOUND) 
-                return res.unwrap_err();
+    if (should_delete()) {
+        auto res = gadgets_->alloc.delete_node(&id_);
+        if (res.is_err() && res.unwrap_err() != MDB_NOTFOUND) 
+            return res.unwrap_err();
 
-            return DELETED;
-        }
+        return DELETED;
     }
 
+    if (!is_split_) return OK;
+
+    Child* range = get_range(nib);
+    range->blk_id = block_id;
+    range->weight = range_weight(*range);
+
+    return OK;
+}
+
+int Branch::settle_weight(byte nib, uint16_t block_id) {
+    Child* child = get_child(nib);
+
+    // the node at the childs id may have changed under it
+    NodeId id;
+    child_id(nib, block_id, &id);
+    Result<Node_ptr, int> res = gadgets_->alloc.load_node(&id);
+    if (res.is_err()) return res.unwrap_err();
+
+    child->weight = res.unwrap()->get_weight();
+
+    if (!is_split_) return OK;
+
+    Child* range = get_range(nib);
+    range->blk_id = block_id;
+    range->weight = range_weight(*range);
+
     return OK;
 }
 
+Weight Branch::get_weight() const {
+    Weight weight{0, encoded_size()};
+
+    // a split may not hold every range's children
+    for (auto &child: is_split_ ? ranges_ : children_) weight += child.weight;
+    return weight;
+}
+
+void Branch::set_child_weight(byte nib, const Weight &weight) {
+    Child* child = get_child(nib);
+    if (child) child->weight = weight;
+}
+
+Child* Branch::get_range(byte nib) {
+    for (auto &range: ranges_) {
+        if (range.anchor <= nib && nib <= range.end) return &range;
+    }
+    return nullptr;
+}
+
+Weight Branch::range_weight(const Child &range) const {
+    Weight weight{};
+
+    size_t end = anchors_.rank(range.end + 1);
+    for (size_t i = anchors_.rank(range.anchor); i < end; i++) 
+        weight += children_[i].weight;
+
+    return weight;
+}
+
+void Branch::fill_range_evals(const Child &range, Polynomial &poly) const {
+    size_t end = anchors_.rank(range.end + 1);
+    for (size_t i = anchors_.rank(range.anchor); i < end; i++) 
+        poly[children_[i].anchor] = children_[i].sk;
+}
+
+size_t Branch::apply_batch(
+    const TrieOp* ops, size_t n,
+    int* results,
+    uint16_t block_id
+) {
+    size_t i{};
+    while (i < n) {
+        // off the extension there is nothing below to share
+        if (!ext_matches(&ops[i].key)) {
+            results[i] = apply_op(this, ops[i], block_id);
+
+            // a new branch took this id
+            bool split = ops[i].kind == OP_CREATE_ACCOUNT && results[i] == OK;
+            if (split) return i + 1;
+            i++;
+            continue;
+        }
+
+        byte nib = child_nib(&ops[i].key);
+
+        // ops are sorted so everything under nib is contiguous
+        size_t group_end = i + 1;
+        while (
+            group_end < n && 
+            ext_matches(&ops[group_end].key) &&
+            child_nib(&ops[group_end].key) == nib
+        ) group_end++;
+
+        while (i < group_end) {
+            const NodeId* next_id = get_next_id(nib);
+
+            if (!next_id) {
+                // nothing below to share, this may create it
+                results[i] = apply_op(this, ops[i], block_id);
+                if (results[i] == DELETED) return i + 1;
+                i++;
+                continue;
+            }
+
+            Result<Node_ptr, int> res = gadgets_->alloc.load_node(next_id);
+            if (res.is_err()) {
+                results[i] = res.unwrap_err();
+                i++;
+                continue;
+            }
+
+            // child is loaded once for the whole group
+            size_t done = res.unwrap()->apply_batch(
+                ops + i, group_end - i, results + i, block_id
+            );
+
+            for (size_t k = i; k < i + done; k++) {
+                bool removing = (
+                    ops[k].kind == OP_REMOVE || 
+                    ops[k].kind == OP_DELETE_ACCOUNT
+                );
+                results[k] = settle_child(nib, removing, results[k], block_id);
+
+                // this branch is gone
+                if (results[k] == DELETED) return k + 1;
+            }
+            i += done;
+        }
+    }
+    return n;
+}
+
+size_t Branch::apply_batch_parallel(
+    const TrieOp* ops, size_t n,
+    int* results,
+    uint16_t block_id
+) {
+    struct Group {
+        byte nib;
+        size_t begin;
+        size_t end;
+        Node_ptr child;
+        size_t done;
+    };
+
+    // sorted, so with both ends on the extension every op is
+    if (!ext_matches(&ops[0].key) || !ext_matches(&ops[n - 1].key))
+        return apply_batch(ops, n, results, block_id);
+
+    std::vector<Group> groups;
+    size_t loaded{};
+
+    size_t i{};
+    while (i < n) {
+        byte nib = child_nib(&ops[i].key);
+
+        size_t group_end = i + 1;
+        while (group_end < n && child_nib(&ops[group_end].key) == nib) 
+            group_end++;
+
+        // children are resolved here since 
+        // get_next_id writes to tmp_id_
+        Group group{nib, i, group_end, nullptr, 0};
+        const NodeId* next_id = get_next_id(nib);
+        if (next_id) {
+            Result<Node_ptr, int> res = gadgets_->alloc.load_node(next_id);
+            if (res.is_ok()) {
+                group.child = res.unwrap();
+                loaded++;
+            }
+        }
+        groups.push_back(std::move(group));
+        i = group_end;
+    }
+
+    if (loaded < 2) return apply_batch(ops, n, results, block_id);
+
+    // subtrees under different children share no nodes
+    TaskGroup tasks(gadgets_->pool);
+    for (Group &group: groups) {
+        if (!group.child) continue;
+        tasks.spawn([ops, results, &group, block_id] {
+            group.done = group.child->apply_batch(
+                ops + group.begin, group.end - group.begin, 
+                results + group.begin, 
+                block_id
+            );
+        });
+    }
+    tasks.wait();
+
+    // settle in key order, as apply_batch would have
+    for (Group &group: groups) {
+        size_t k = group.begin;
+
+        for (; k < group.begin + group.done; k++) {
+            bool removing = (
+                ops[k].kind == OP_REMOVE || 
+                ops[k].kind == OP_DELETE_ACCOUNT
+            );
+            results[k] = settle_child(group.nib, removing, results[k], block_id);
+
+            // this branch is gone
+            if (results[k] == DELETED) return k + 1;
+        }
+
+        // the child was replaced or missing, finish the group serially
+        if (k < group.end) {
+            size_t done = apply_batch(ops + k, group.end - k, results + k, block_id);
+            k += done;
+            if (done > 0 && results[k - 1] == DELETED) return k;
+        }
+    }
+    return n;
+}
+
 int Branch::create_account(
     const Hash* key,
     uint16_t block_id
 ) { 
+    if (!ext_matches(key)) return split_ext(key, block_id);
 
-    // if this is a split we pass the same nibble to get_next_id
-    // in get_next_id we skip incrementing the level
-    // this means the child id is a duplicate plus an additional nibble
-    // that way when it tries to grab a nibble from the key using level 
-    // it is not off by one
-
-    uint8_t lvl = id_.get_level();
-    byte child_nib = key->h[(is_split_) ? lvl - 1 : lvl];
+    byte nib = child_nib(key);
+    int rc{OK};
 
-    const NodeId* next_id = get_next_id(child_nib);
+    const NodeId* next_id = get_next_id(nib);
     if (next_id) {
 
         Result<Node_ptr, int> res = gadgets_->alloc.load_node(next_id);
         if (res.is_err()) return res.unwrap_err();
 
-        int rc = res.unwrap()->create_account(key, block_id);
-        if (rc != OK) return rc;
-
+        rc = res.unwrap()->create_account(key, block_id);
 
     } else {
 
@@ -331,26 +610,191 @@ int Branch::create_account(
         // are heavy there is no need to do it here.
 
         // create and fill leaf
-        tmp_id_ = id_;
-        tmp_id_.set_block_id(block_id);
-        tmp_id_.set_child_nibble(child_nib);
-        tmp_id_.increment_level();
+        child_id(nib, block_id, &tmp_id_);
 
         auto leaf = create_leaf(gadgets_, &tmp_id_, nullptr);
         leaf->set_path(key);
         gadgets_->alloc.cache_node(leaf);
     }
 
+    return settle_child(nib, false, rc, block_id);
+}
+
+int Branch::split_ext(const Hash* key, uint16_t block_id) {
+    uint8_t lvl = id_.get_level();
+
+    size_t at{};
+    while (key->h[lvl + at] == ext_[at]) at++;
+
+    NodeId upper_id = id_;
+    upper_id.set_block_id(block_id);
+
+    auto upper = create_branch(gadgets_, &upper_id, nullptr);
+    upper->set_ext(ext_.data(), at);
+
+    // INSERT NEW LEAF INTO UPPER BRANCH
+    NodeId new_id = upper_id;
+    new_id.append_path(key->h + lvl, at + 1);
+
+    auto leaf = create_leaf(gadgets_, &new_id, nullptr);
+    leaf->set_path(key);
+    gadgets_->alloc.cache_node(leaf);
+    upper->insert_child(key->h[lvl + at], block_id);
+    upper->set_child_weight(key->h[lvl + at], leaf->get_weight());
+
+    // MOVE THIS BELOW IT, children keep their ids
+    // since the bytes above them are the same
+    byte nib = ext_[at];
+    new_id = upper_id;
+    new_id.append_path(ext_.data(), at + 1);
+
+    // recache keeps another block's version as a clone taken before
+    // the trim, so that copy still has the whole extension. a version
+    // of this block is left for upper to replace under id_
+    int cache_res = gadgets_->alloc.recache(this, &id_, &new_id);
+    if (cache_res != OK) return cache_res;
+    ext_.erase(ext_.begin(), ext_.begin() + at + 1);
+    upper->insert_child(nib, block_id);
+    upper->set_child_weight(nib, get_weight());
+
+    // upper has this* old id_, so it's cached 
+    // only after this* has been recached under a new id 
+    gadgets_->alloc.cache_node(upper);
+
+    return OK;
+}
+
+// a proof marks split key bytes in a byte
+const size_t SPLIT_LEVELS = 8;
+
+// the count is written in a byte
+const size_t MAX_RANGES = BRANCH_ORDER - 1;
+
+int Branch::split_heavy(const Weight &max, uint16_t block_id) {
+    if (!ext_.empty() || key_level() >= SPLIT_LEVELS) return OK;
+
+    bool heavy = !is_split_ && children_.size() > 1 && get_weight().exceeds(max);
+    for (auto &range: ranges_) heavy |= range.weight.exceeds(max);
+    if (!heavy) return OK;
+
+    // ensure new cached node to be modified
     if (id_.get_block_id() != block_id) {
-        int rc = recache(block_id);
+        int cache_rc = recache(block_id);
+        if (cache_rc != OK) return cache_rc;
+    }
+
+    if (!is_split_) {
+        // one range over everything, halved below
+        Child all{0, BRANCH_ORDER - 1, ZERO_SK, block_id, {}};
+        all.weight = range_weight(all);
+
+        ranges_.assign(1, all);
+        is_split_ = true;
+    }
+
+    size_t k{};
+    while (k < ranges_.size()) {
+        if (!ranges_[k].weight.exceeds(max) || !divide_range(k, max, block_id)) k++;
+    }
+
+    return OK;
+}
+
+bool Branch::divide_range(size_t k, const Weight &max, uint16_t block_id) {
+    if (ranges_.size() >= MAX_RANGES) return false;
+
+    Child &range = ranges_[k];
+    size_t first = anchors_.rank(range.anchor);
+    size_t last = anchors_.rank(range.end + 1);
+    if (last - first < 2) return false;
+
+    // balanced on whichever it is over
+    bool by_leaves = max.leaves && range.weight.leaves > max.leaves;
+    auto measure = [by_leaves](const Weight &w) -> uint64_t { 
+        return by_leaves ? w.leaves : w.bytes; 
+    };
+
+    uint64_t total{};
+    for (size_t i = first; i < last; i++) total += measure(children_[i].weight);
+
+    // first child of the upper half, neither half is left empty
+    size_t cut = first + 1;
+    uint64_t lower{};
+    for (; cut < last - 1; cut++) {
+        lower += measure(children_[cut - 1].weight);
+        if (2 * lower >= total) break;
+    }
+
+    byte at = children_[cut].anchor;
+    Child upper{at, range.end, ZERO_SK, block_id, {}};
+
+    range.end = at - 1;
+    range.blk_id = block_id;
+    range.weight = range_weight(range);
+    upper.weight = range_weight(upper);
+
+    ranges_.insert(ranges_.begin() + k + 1, upper);
+    return true;
+}
+
+int Branch::commit_ranges(uint16_t block_id) {
+    const KZGSettings &settings = gadgets_->settings;
+
+    // ranges given by another shard are never this block's
+    for (auto &range: ranges_) {
+        if (range.blk_id != block_id) continue;
+
+        Polynomial poly(BRANCH_ORDER, ZERO_SK);
+        fill_range_evals(range, poly);
+
+        Commitment c = commit_evals(poly, settings);
+        hash_p1_to_scalar(&c, &range.sk, &settings.tag);
+    }
+
+    return OK;
+}
+
+int Branch::drop_range(byte anchor) {
+    Child* range = get_range(anchor);
+    if (!range) return NOT_EXIST;
+
+    size_t first = anchors_.rank(range->anchor);
+    size_t last = anchors_.rank(range->end + 1);
+
+    for (size_t i = first; i < last; i++) {
+        NodeId id;
+        child_id(children_[i].anchor, children_[i].blk_id, &id);
+
+        auto res = gadgets_->alloc.load_node(&id);
+        if (res.is_err()) {
+            int rc = res.unwrap_err();
+            if (rc == MDB_NOTFOUND) continue;
+            return rc;
+        }
+
+        int rc = res.unwrap()->prune(children_[i].blk_id);
         if (rc != OK) return rc;
     }
 
-    insert_child(child_nib, block_id);
+    for (size_t i = first; i < last; i++) anchors_.clear(children_[i].anchor);
+    children_.erase(children_.begin() + first, children_.begin() + last);
 
     return OK;
 }
 
+bool Branch::set_range_scalar(byte first, byte last, const blst_scalar &sk) {
+    Child* range = get_range(first);
+    if (!range || range->anchor != first || range->end != last) return false;
+
+    range->sk = sk;
+    return true;
+}
+
+// a dirty child whose subtree holds fewer leaves than this is
+// finalized by the thread that reaches it, under a handful of 
+// leaves there is less work than handing it to the pool costs
+const uint32_t FINALIZE_FORK_LEAVES = 16;
+
 int Branch::finalize(
     const Hash* shard_path,
     uint16_t block_id,
@@ -361,12 +805,7 @@ int Branch::finalize(
 ) {
     if (end == 0) end = BRANCH_ORDER;
 
-    NodeId tmp {id_};
-    tmp.set_block_id(block_id);
-    tmp.increment_level();
-
-    Commitment child_commit;
-
+    std::vector<Child*> dirty;
     for (auto &child: children_) {
         if (child.anchor < start) continue;
         if (end < child.end) break;
@@ -375,40 +814,51 @@ int Branch::finalize(
             scalar_is_zero(child.sk)) 
             continue;
 
-        tmp.set_self_nibble(child.anchor);
-        assert(tmp != id_);
-
-        auto loaded = gadgets_->alloc.load_node(&tmp, true);
-        if (loaded.is_err()) {
-            if (!is_split_) return LOAD_NODE_ERR;
-
-            // TODO -- if child is out of shard path.
-            // then we don't need to report an error here.
-            if (tmp.cmp(shard_path) != 0)
-                return LOAD_NODE_ERR;
-
-        } else {
+        dirty.push_back(&child);
+    }
 
-            Node_ptr child_node = loaded.unwrap();
+    std::vector<size_t> heavy, light;
+    for (size_t k{}; k < dirty.size(); k++) {
+        bool big = dirty[k]->weight.leaves >= FINALIZE_FORK_LEAVES;
+        (big ? heavy : light).push_back(k);
+    }
 
-            int rc = child_node->finalize(shard_path, block_id, &child_commit);
-            if (rc != OK) return rc;
+    // this thread keeps one heavy subtree if it has nothing else
+    if (light.empty() && !heavy.empty()) {
+        light.push_back(heavy.back());
+        heavy.pop_back();
+    }
 
-            hash_p1_to_scalar(
-                &child_commit, 
-                &child.sk, 
-                &gadgets_->settings.tag
-            );
+    // the heavy ones are up for stealing 
+    // while this thread works the rest
+    std::vector<int> rcs(dirty.size(), OK);
+    {
+        TaskGroup tasks(gadgets_->pool);
+        for (size_t k: heavy) {
+            tasks.spawn([this, &dirty, &rcs, k, shard_path, block_id] {
+                rcs[k] = finalize_child(*dirty[k], shard_path, block_id);
+            });
         }
+        for (size_t k: light) 
+            rcs[k] = finalize_child(*dirty[k], shard_path, block_id);
+        tasks.wait();
+    }
+
+    for (size_t k{}; k < dirty.size(); k++) {
+        if (rcs[k] != OK) return rcs[k];
 
         if (Fx && !out) {
             // fill in range from in fx if available
+            Child &child = *dirty[k];
             for (int i = child.anchor; i <= child.end; i++) {
                 Fx->at(i) = child.sk;
             }
         }
     }
 
+    int rc = commit_ranges(block_id);
+    if (rc != OK) return rc;
+
     if (!Fx && out) {
         *out = *derive_commitment();
     }
@@ -416,17 +866,77 @@ int Branch::finalize(
     return OK;
 }
 
-int Branch::prune(uint16_t block_id) {
+int Branch::finalize_child(
+    Child &child,
+    const Hash* shard_path,
+    uint16_t block_id
+) {
+    Node_ptr child_node;
+    int rc = load_dirty_child(child, shard_path, block_id, child_node);
+    if (rc != OK || !child_node) return rc;
+
+    Commitment child_commit;
+    rc = child_node->finalize(shard_path, block_id, &child_commit);
+    if (rc != OK) return rc;
+
+    // cached on the child, and written with it
+    child.sk = *child_node->get_scalar();
+
+    return OK;
+}
+
+int Branch::load_dirty_child(
+    const Child &child,
+    const Hash* shard_path,
+    uint16_t block_id,
+    Node_ptr &out
+) {
+    NodeId tmp;
+    child_id(child.anchor, block_id, &tmp);
+    assert(tmp != id_);
+
+    auto loaded = gadgets_->alloc.load_node(&tmp);
+    if (loaded.is_err()) {
+        if (!is_split_) return LOAD_NODE_ERR;
+
+        // TODO -- if child is out of shard path.
+        // then we don't need to report an error here.
+        if (tmp.cmp(shard_path) != 0)
+            return LOAD_NODE_ERR;
+
+        return OK;
+    }
+
+    out = loaded.unwrap();
+    return OK;
+}
+
+void Branch::set_child_scalar(
+    byte anchor, 
+    uint16_t block_id, 
+    const blst_scalar &sk
+) {
+    // same children finalize would have descended into
+    Child* child = get_child(anchor);
+    if (!child || child->anchor != anchor) return;
+    if (child->blk_id != block_id || scalar_is_zero(child->sk)) return;
 
-    tmp_id_ = id_;
-    tmp_id_.set_block_id(block_id);
-    tmp_id_.increment_level();
+    child->sk = sk;
+}
+
+void Branch::discard() {
+    children_.clear();
+    anchors_.reset();
+    ranges_.clear();
+}
+
+int Branch::prune(uint16_t block_id) {
 
     for (auto &child: children_) {
 
         if (child.blk_id != block_id) continue;
 
-        tmp_id_.set_self_nibble(child.anchor);
+        child_id(child.anchor, block_id, &tmp_id_);
 
         auto res = gadgets_->alloc.load_node(&tmp_id_);
         if (res.is_err()) {
@@ -441,8 +951,7 @@ int Branch::prune(uint16_t block_id) {
     }
 
     // should_delete() evals to true now
-    children_.clear();
-
+    discard();
 
     // delete
     auto res = gadgets_->alloc.delete_node(&id_);
@@ -452,60 +961,13 @@ int Branch::prune(uint16_t block_id) {
     return OK;
 }
 
-/// TODO -- thinking about block ids here with split nodes...
-/// NOT SURE WHAT TO DO THERE...
-
 int Branch::justify(uint16_t block_id) {
-    tmp_id_ = id_;
-    tmp_id_.increment_level();
-
-    // change all child block ids != 0 -> 0
-    for (auto &child: children_) {
-        if (child.blk_id == 0) continue;
-
-        tmp_id_.set_block_id(child.blk_id);
-        tmp_id_.set_self_nibble(child.anchor);
-
-        Result<Node_ptr, int> res = gadgets_->alloc.load_node(&tmp_id_);
-        if (res.is_err()) return res.unwrap_err();
-
-        int just_res = res.unwrap()->justify(block_id);
-        if (just_res != OK && just_res != DELETED) return just_res;
-
-        child.blk_id = 0;
-    }
-
-    if (id_.get_block_id() == block_id) {
-
-        // delete self under this id
-        auto del_res = gadgets_->alloc.delete_node(&id_, true);
-        if (del_res.is_err()) return del_res.unwrap_err();
-
-        // if have no children
-        if (should_delete()) return DELETED;
-
-        id_.set_block_id(0);
-
-        Node_ptr new_self = del_res.unwrap();
-
-        // this* and new_self should point to same addr
-        //assert(std::addressof(*this) == std::addressof(*new_self.get()));
-        //not true because we couldve been kicked out of the cache
-
-        gadgets_->alloc.cache_node(new_self);
-
-    } else {
-        // if have no children
-        if (should_delete()) return DELETED;
-
-        uint16_t prev_block_id = id_.get_block_id();
-        id_.set_block_id(0);
-        
-        gadgets_->alloc.persist_node(this);
-
-        id_.set_block_id(prev_block_id);
-    }
+    // children this block made are justified alongside,
+    // every other one is cannonical already
+    for (auto &child: children_) child.blk_id = 0;
+    for (auto &range: ranges_) range.blk_id = 0;
 
+    if (should_delete()) return DELETED;
     return OK;
 }
 
@@ -513,16 +975,18 @@ bool Branch::commit_is_in_path(
     const Hash* key,
     const Commitment &commitment
 ) {
-    if (blst_p1_is_equal(&commit_, &commitment)) return true;
+    if (blst_p1_is_equal(commit_.get(), &commitment)) return true;
+    if (!ext_matches(key)) return false;
 
-
-    Child* child = get_child(key->h[id_.get_level()]);
+    Child* child = get_child(key->h[key_level()]);
     if (!child) return false;
 
     const NodeId* next_id = get_next_id(child->anchor);
     if (next_id) {
 
-        Result<Node_ptr, int> res = gadgets_->alloc.load_node(next_id);
+        Result<bool, int> res = read_commit_is_in_path(
+            gadgets_, next_id, key, commitment
+        );
         if (res.is_err()) {
             // this happens when this node is the split into other shards
             // so we dont have the rest of the shard we can just check 
@@ -536,7 +1000,7 @@ bool Branch::commit_is_in_path(
             return res.unwrap_err();
         }
 
-        return res.unwrap()->commit_is_in_path(key, commitment);
+        return res.unwrap();
     }
 
     return false;
@@ -67,6 +67,7 @@
 #include "fft.h"
 #include "gadgets.h"
 #include "helpers.h"
+#include "lazy_commitment.h"
 #include "node.h"
 #include "nodeid.h"
 #include "state_types.h"
@@ -75,11 +76,27 @@ class Branch : public Node {
 private:
     NodeId id_;
 
-    Commitment commit_;
+    LazyCommitment commit_;
 
+    // children_ is packed and sorted by anchor.
+    // a childs index is the number of anchors below it,
+    // and for splits the range is carried in child.end
+    Bitmap<BRANCH_ORDER> anchors_;
     std::vector<Child> children_;
     bool is_split_;
 
+    // a split's halves aren't nodes of their own. each range is
+    // committed to like a branch holding only the children in it,
+    // and the split commits to the ranges. they cover every nib,
+    // sorted by anchor. a range whose children live on another
+    // shard keeps the scalar and weight it was given
+    std::vector<Child> ranges_;
+
+    // path bytes below id_ that every child shares. the branch
+    // goes down on the key byte after them, so a run of single
+    // child levels is this one node. splits never have one
+    std::vector<byte> ext_;
+
     Gadgets_ptr gadgets_;
 
     NodeId tmp_id_;
@@ -91,7 +108,7 @@ public:
         const ByteSlice* buff
     );
     ~Branch() {
-        if (should_delete()) return;
+        if (should_delete() || synced_) return;
         gadgets_->alloc.persist_node(this); 
     };
 
@@ -99,31 +116,76 @@ public:
     const NodeId* get_id() const override { return &id_; }
     void set_id(const NodeId* h) override { id_ = *h; }
 
+    Node_ptr clone() const override { return gadgets_->alloc.make_node<Branch>(*this); }
+
     int recache(uint16_t block_id) {
         tmp_id_ = id_;
         tmp_id_.set_block_id(block_id);
 
-        int cache_res = gadgets_->alloc.recache(&id_, &tmp_id_);
+        int cache_res = gadgets_->alloc.recache(this, &id_, &tmp_id_);
         if (cache_res != OK) return cache_res;
         return OK;
     }
 
-    const Commitment* derive_commitment() override {
-        Polynomial poly(BRANCH_ORDER, ZERO_SK);
-        for (auto &child: children_) {
+    void fill_evals(Polynomial &poly) const override {
+        const std::vector<Child> &entries = is_split_ ? ranges_ : children_;
+        for (auto &child: entries) {
             for (int i = child.anchor; i <= child.end; i++) {
                 poly[i] = child.sk;
             }
         }
+    }
+
+    const Commitment* derive_commitment() override {
+        Polynomial poly(BRANCH_ORDER, ZERO_SK);
+        fill_evals(poly);
+
         inverse_fft_in_place(poly, gadgets_->settings.roots.inv_roots);
-        commit_g1(&commit_, poly, gadgets_->settings.setup);
-        return &commit_;
+
+        Commitment c;
+        commit_g1(&c, poly, gadgets_->settings.setup);
+        commit_.set(c);
+        return commit_.get();
+    }
+
+    const blst_scalar* get_scalar() const override { 
+        return commit_.scalar(&gadgets_->settings.tag); 
+    }
+
+    const Commitment* get_commitment() const override { return commit_.get(); }
+    void set_commitment(const Commitment &c) override { commit_.set(c); }
+    void set_commitment(const Commitment &c, const blst_p1_affine &aff) override { 
+        commit_.set(c, aff); 
     }
 
-    const Commitment* get_commitment() const override { return &commit_; }
-    void set_commitment(const Commitment &c) override { commit_ = c; }
+    bool should_delete() const override { return children_.empty() && ranges_.empty(); }
+    void discard() override;
+
+    Weight get_weight() const override;
+
+    void set_ext(const byte* bytes, size_t len) { ext_.assign(bytes, bytes + len); }
+    void set_child_weight(byte nib, const Weight &weight);
+
+    bool is_split() const { return is_split_; }
 
-    bool should_delete() const override { return children_.size() == 0; }
+    // empty unless this is a split
+    const std::vector<Child>& get_ranges() const { return ranges_; }
+
+    // turns this into a split once it weighs more than max, then
+    // halves every range still heavier, as long as it holds more
+    // than one child. for a branch without an extension whose 
+    // key byte a proof can mark as split, any other is left be
+    int split_heavy(const Weight &max, uint16_t block_id);
+
+    int commit_ranges(uint16_t block_id) override;
+
+    // prunes the cannonical subtrees under the range at anchor,
+    // which keeps its scalar and weight so this still commits to them
+    int drop_range(byte anchor);
+
+    // takes another shard's scalar for its range, false 
+    // when no range here runs from first to last
+    bool set_range_scalar(byte first, byte last, const blst_scalar &sk);
 
     Child* get_child(byte nib);
     void insert_child(
@@ -136,6 +198,8 @@ public:
     const NodeId* get_next_id(byte nib) override;
 
     std::vector<byte> to_bytes() const override;
+    size_t encoded_size() const override;
+    size_t encode(byte* out) const override;
 
     int put(
         const Hash* key,
@@ -173,7 +237,7 @@ public:
         const Hash* key,
         std::vector<Polynomial> &Fxs,
         std::vector<blst_p1> &Cs,
-        Bitmap<8>* split_map
+        ProofShape* shape
     ) override;
 
 
@@ -190,16 +254,101 @@ public:
 
     int justify(uint16_t block_id) override;
 
+    void set_child_scalar(
+        byte anchor, 
+        uint16_t block_id, 
+        const blst_scalar &sk
+    ) override;
+
     bool commit_is_in_path(
         const Hash* key,
         const Commitment &commitment
     ) override;
+
+    size_t apply_batch(
+        const TrieOp* ops, size_t n,
+        int* results,
+        uint16_t block_id
+    ) override;
+
+    // each child's group runs as its own task on the pool,
+    // bookkeeping on this node stays on the calling thread
+    size_t apply_batch_parallel(
+        const TrieOp* ops, size_t n,
+        int* results,
+        uint16_t block_id
+    ) override;
+
+private:
+    // nibble a key goes down at this node
+    byte child_nib(const Hash* key) const;
+
+    // level of the key byte child_nib reads
+    uint8_t key_level() const { return id_.get_level() + ext_.size(); }
+
+    bool ext_matches(const Hash* key) const {
+        return std::memcmp(key->h + id_.get_level(), ext_.data(), ext_.size()) == 0;
+    }
+
+    // id of the child at nib under block_id's version
+    void child_id(byte nib, uint16_t block_id, NodeId* out) const;
+
+    // key leaves the extension partway, a branch goes in 
+    // where it does above this one and the key's new leaf
+    int split_ext(const Hash* key, uint16_t block_id);
+
+    // bookkeeping after an op was applied to the child at nib,
+    // rc is what the child returned
+    int settle_child(byte nib, bool removing, int rc, uint16_t block_id);
+
+    // reads the childs weight back off it, and marks its range
+    int settle_weight(byte nib, uint16_t block_id);
+
+    Child* get_range(byte nib);
+    Weight range_weight(const Child &range) const;
+
+    // the range's children at their nibs, zero elsewhere
+    void fill_range_evals(const Child &range, Polynomial &poly) const;
+
+    // moves the range at k's upper half by weight into a range
+    // of its own, false when it has less than two children
+    bool divide_range(size_t k, const Weight &max, uint16_t block_id);
+
+    // finalizes the block's version of child and takes its scalar
+    int finalize_child(Child &child, const Hash* shard_path, uint16_t block_id);
+
+    // out is left empty when the child is 
+    // legitimately missing (outside the shard path)
+    int load_dirty_child(
+        const Child &child, 
+        const Hash* shard_path, 
+        uint16_t block_id,
+        Node_ptr &out
+    );
 };
 
-inline std::shared_ptr<Branch> create_branch(
+inline Ref<Branch> create_branch(
     Gadgets_ptr gadgets, 
     const NodeId* id, 
     const ByteSlice* buff
 ) {
-    return std::make_shared<Branch>(gadgets, id, buff);
+    return gadgets->alloc.make_node<Branch>(gadgets, id, buff);
 }
+
+// the BRANCH_V2 layout Branch::encode writes, for branches put
+// together without a Branch. ranges only go in for a split
+size_t branch_encoded_size(
+    size_t ext_size, 
+    size_t children, 
+    bool is_split, 
+    size_t ranges
+);
+size_t encode_branch(
+    byte* out,
+    bool is_split,
+    const LazyCommitment &commit,
+    const std::string* tag,
+    const byte* ext, size_t ext_size,
+    const std::vector<Child> &children,
+    const std::vector<Child> &ranges
+);
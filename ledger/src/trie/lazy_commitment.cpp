@@ -0,0 +1,141 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "lazy_commitment.h"
+#include "hashing.h"
+#include "helpers.h"
+#include <cstring>
+
+LazyCommitment::LazyCommitment() :
+    point_{new_inf_p1()},
+    has_point_{true},
+    raw_{},
+    raw_kind_{NONE},
+    sk_{},
+    has_sk_{false}
+{}
+
+LazyCommitment::LazyCommitment(const LazyCommitment &other) : LazyCommitment() {
+    *this = other;
+}
+
+LazyCommitment& LazyCommitment::operator=(const LazyCommitment &other) {
+    if (this == &other) return *this;
+    std::lock_guard lock(other.mux_);
+
+    point_ = other.point_;
+    has_point_.store(other.has_point_.load(std::memory_order_relaxed));
+    std::memcpy(raw_, other.raw_, AFFINE_SIZE);
+    raw_kind_ = other.raw_kind_;
+    sk_ = other.sk_;
+    has_sk_.store(other.has_sk_.load(std::memory_order_relaxed));
+
+    return *this;
+}
+
+void LazyCommitment::set(const Commitment &c) {
+    point_ = c;
+    has_point_ = true;
+    raw_kind_ = NONE;
+    has_sk_ = false;
+}
+
+void LazyCommitment::set(const Commitment &c, const blst_p1_affine &aff) {
+    set(c);
+    blst_p1_affine_serialize(raw_, &aff);
+    raw_kind_ = AFFINE;
+}
+
+void LazyCommitment::read_compressed(const byte* in) {
+    std::memcpy(raw_, in, COMPRESSED_SIZE);
+    raw_kind_ = COMPRESSED;
+    has_point_ = false;
+    has_sk_ = false;
+}
+
+void LazyCommitment::read_v2(const byte* in) {
+    std::memcpy(raw_, in, AFFINE_SIZE);
+    raw_kind_ = AFFINE;
+    has_point_ = false;
+
+    blst_scalar_from_le_bytes(&sk_, in + AFFINE_SIZE, sizeof(blst_scalar));
+    has_sk_ = true;
+}
+
+const Commitment* LazyCommitment::get() const {
+    if (has_point_.load(std::memory_order_acquire)) return &point_;
+
+    std::lock_guard lock(mux_);
+    if (has_point_.load(std::memory_order_relaxed)) return &point_;
+
+    blst_p1_affine aff;
+    if (raw_kind_ == AFFINE) blst_p1_deserialize(&aff, raw_);
+    else blst_p1_uncompress(&aff, raw_);
+
+    blst_p1_from_affine(&point_, &aff);
+    has_point_.store(true, std::memory_order_release);
+
+    return &point_;
+}
+
+void LazyCommitment::make_affine() const {
+    if (raw_kind_ == AFFINE) return;
+
+    blst_p1_affine aff;
+    if (raw_kind_ == COMPRESSED) blst_p1_uncompress(&aff, raw_);
+    else blst_p1_to_affine(&aff, &point_);
+
+    blst_p1_affine_serialize(raw_, &aff);
+    raw_kind_ = AFFINE;
+}
+
+const blst_scalar* LazyCommitment::scalar(const std::string* tag) const {
+    if (has_sk_.load(std::memory_order_acquire)) return &sk_;
+
+    std::lock_guard lock(mux_);
+    if (has_sk_.load(std::memory_order_relaxed)) return &sk_;
+
+    byte c_bytes[COMPRESSED_SIZE];
+
+    if (raw_kind_ == COMPRESSED) {
+        std::memcpy(c_bytes, raw_, COMPRESSED_SIZE);
+
+    } else {
+        // pay the one inversion here so write_v2 gets it for free
+        make_affine();
+
+        blst_p1_affine aff;
+        blst_p1_deserialize(&aff, raw_);
+        blst_p1_affine_compress(c_bytes, &aff);
+    }
+
+    hash_compressed_to_scalar(c_bytes, &sk_, tag);
+    has_sk_.store(true, std::memory_order_release);
+
+    return &sk_;
+}
+
+void LazyCommitment::write_v2(byte* out, const std::string* tag) const {
+    const blst_scalar* sk = scalar(tag);
+
+    std::lock_guard lock(mux_);
+    make_affine();
+
+    std::memcpy(out, raw_, AFFINE_SIZE);
+    std::memcpy(out + AFFINE_SIZE, sk->b, sizeof(blst_scalar));
+}
@@ -0,0 +1,81 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  A node commitment that is only decoded when read.
+ *
+ *  Old nodes carry the point compressed, which costs a sqrt to decode.
+ *  V2 nodes carry it affine uncompressed (no sqrt, just an on curve check)
+ *  next to its hashed scalar. Whatever was read is kept as is, so a node
+ *  whose commitment never changed writes the same bytes back without
+ *  converting from jacobian (an inversion).
+ *
+ *  Reads may decode from several threads at once (finalize and proofs
+ *  share nodes), so decoding happens once under a lock and is published 
+ *  through the atomic flags. Setting is a write to the node and isn't.
+ */
+
+#pragma once
+#include "blst.h"
+#include "state_types.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+
+const size_t AFFINE_SIZE = 96;
+const size_t COMPRESSED_SIZE = 48;
+const size_t COMMIT_V2_SIZE = AFFINE_SIZE + sizeof(blst_scalar);
+
+class LazyCommitment {
+private:
+    enum RawKind : uint8_t { NONE, COMPRESSED, AFFINE };
+
+    mutable Commitment point_;
+    mutable std::atomic<bool> has_point_;
+
+    mutable byte raw_[AFFINE_SIZE];
+    mutable RawKind raw_kind_;
+
+    mutable blst_scalar sk_;
+    mutable std::atomic<bool> has_sk_;
+
+    // held while decoding, raw_ is only read or written under it
+    mutable std::mutex mux_;
+
+    // raw_ becomes the affine encoding, mux_ held
+    void make_affine() const;
+
+public:
+    LazyCommitment();
+    LazyCommitment(const LazyCommitment &other);
+    LazyCommitment& operator=(const LazyCommitment &other);
+
+    void set(const Commitment &c);
+    void set(const Commitment &c, const blst_p1_affine &aff);
+
+    void read_compressed(const byte* in);
+
+    // COMMIT_V2_SIZE bytes
+    void read_v2(const byte* in);
+    void write_v2(byte* out, const std::string* tag) const;
+
+    const Commitment* get() const;
+
+    // hash_p1_to_scalar of the commitment
+    const blst_scalar* scalar(const std::string* tag) const;
+};
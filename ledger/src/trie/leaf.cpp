@@ -29,26 +29,28 @@ Leaf::Leaf(
 ) : 
     id_(id),
     path_(ZERO_HASH),
-    commit_{new_inf_p1()},
     count_{},
     is_deleted_{false},
-    children_(LEAF_ORDER, ZERO_HASH), 
-    child_block_ids_(LEAF_ORDER, {}), 
     gadgets_{gadgets}
 {
     if (id) id_ = *id;
     if (buff == nullptr) { return; }
 
     const size_t PATH_SIZE = sizeof(path_.h);
-    const size_t CHILD_SIZE = sizeof(children_[0]);
-    const size_t BLOCK_ID_SIZE = sizeof(child_block_ids_[0]);
+    const size_t CHILD_SIZE = sizeof(LeafSlot::hash);
+    const size_t BLOCK_ID_SIZE = sizeof(LeafSlot::blk_id);
     const size_t COUNT_SIZE = sizeof(count_);
 
     byte* cursor = buff->data(); 
-    cursor++;
+    byte type = *cursor++;
 
-    commit_ = p1_from_bytes(cursor); 
-    cursor += blst_p1_sizeof();
+    if (is_v2_type(type)) {
+        commit_.read_v2(cursor);
+        cursor += COMMIT_V2_SIZE;
+    } else {
+        commit_.read_compressed(cursor);
+        cursor += blst_p1_sizeof();
+    }
 
     std::memcpy(path_.h, cursor, PATH_SIZE); 
     cursor += PATH_SIZE;
@@ -64,51 +66,76 @@ Leaf::Leaf(
         byte nib = *cursor;
         cursor++;
 
-        std::memcpy(children_[nib].h, cursor, CHILD_SIZE);
+        LeafSlot* slot = get_or_insert_slot(nib);
+
+        std::memcpy(slot->hash.h, cursor, CHILD_SIZE);
         cursor += CHILD_SIZE;
 
-        std::memcpy(&child_block_ids_[nib], cursor, BLOCK_ID_SIZE);
+        std::memcpy(&slot->blk_id, cursor, BLOCK_ID_SIZE);
         cursor += BLOCK_ID_SIZE;
     }
 }
 
 Leaf::~Leaf() { 
-    if (should_delete()) return;
+    if (should_delete() || synced_) return;
     gadgets_->alloc.persist_node(this); 
 }
 
-std::vector<byte> Leaf::to_bytes() const {
+// slots that are both empty and justified aren't written
+static inline bool slot_is_written(const LeafSlot &slot) {
+    return !hash_is_zero(slot.hash) || slot.blk_id != 0;
+}
 
-    const size_t PATH_SIZE = sizeof(path_.h);
-    const size_t CHILD_SIZE = sizeof(children_[0]);
+size_t leaf_encoded_size(const LeafSlot* slots, size_t n) {
+
+    const size_t PATH_SIZE = sizeof(Hash::h);
+    const size_t CHILD_SIZE = sizeof(LeafSlot::hash);
     const size_t NIB_SIZE = sizeof(uint8_t);
-    const size_t BLOCK_ID_SIZE = sizeof(child_block_ids_[0]);
+    const size_t BLOCK_ID_SIZE = sizeof(LeafSlot::blk_id);
 
-    std::vector<byte> buffer(
-        sizeof(LEAF) + 
-        blst_p1_sizeof() + 
+    size_t written{};
+    for (size_t i{}; i < n; i++) 
+        if (slot_is_written(slots[i])) written++;
+
+    return (
+        sizeof(LEAF_V2) + 
+        COMMIT_V2_SIZE + 
         PATH_SIZE +
-        sizeof(count_) +
-        sizeof(count_) +
-        (LEAF_ORDER * (
+        sizeof(uint8_t) +
+        sizeof(uint8_t) +
+        (written * (
             NIB_SIZE + 
             CHILD_SIZE +
             BLOCK_ID_SIZE
         ))
     );
+}
+
+size_t encode_leaf(
+    byte* out,
+    const LazyCommitment &commit,
+    const std::string* tag,
+    const Hash &path,
+    uint8_t count,
+    const LeafSlot* slots, size_t n
+) {
 
-    byte* cursor = buffer.data();
+    const size_t PATH_SIZE = sizeof(path.h);
+    const size_t CHILD_SIZE = sizeof(LeafSlot::hash);
+    const size_t BLOCK_ID_SIZE = sizeof(LeafSlot::blk_id);
 
-    *cursor = LEAF; 
+    byte* cursor = out;
+
+    *cursor = LEAF_V2; 
     cursor++;
 
-    blst_p1_compress(cursor, &commit_); 
-    cursor += blst_p1_sizeof();
+    commit.write_v2(cursor, tag); 
+    cursor += COMMIT_V2_SIZE;
 
-    std::memcpy(cursor, path_.h, PATH_SIZE); 
+    std::memcpy(cursor, path.h, PATH_SIZE); 
     cursor += PATH_SIZE;
 
-    *cursor = count_; 
+    *cursor = count; 
     cursor++;
 
     byte* count2_cursor = cursor;
@@ -116,26 +143,41 @@ std::vector<byte> Leaf::to_bytes() const {
 
     uint8_t count2{};
 
-    for (int i{}; i < LEAF_ORDER; i++) {
-        if (hash_is_zero(children_[i]) &&
-            child_block_ids_[i] == 0) continue;
+    for (size_t i{}; i < n; i++) {
+        const LeafSlot &slot = slots[i];
+        if (!slot_is_written(slot)) continue;
 
         count2++;
 
-        *cursor = i; 
+        *cursor = slot.nib; 
         cursor++;
 
-        std::memcpy(cursor, children_[i].h, CHILD_SIZE);
+        std::memcpy(cursor, slot.hash.h, CHILD_SIZE);
         cursor += CHILD_SIZE;
 
-        std::memcpy(cursor, &child_block_ids_[i], BLOCK_ID_SIZE);
+        std::memcpy(cursor, &slot.blk_id, BLOCK_ID_SIZE);
         cursor += BLOCK_ID_SIZE;
     }
 
     *count2_cursor = count2;
 
-    buffer.resize(cursor - buffer.data());
+    return cursor - out;
+}
 
+size_t Leaf::encoded_size() const {
+    return leaf_encoded_size(slots_.data(), slots_.size());
+}
+
+size_t Leaf::encode(byte* out) const {
+    return encode_leaf(
+        out, commit_, &gadgets_->settings.tag, 
+        path_, count_, slots_.data(), slots_.size()
+    );
+}
+
+std::vector<byte> Leaf::to_bytes() const {
+    std::vector<byte> buffer(encoded_size());
+    encode(buffer.data());
     return buffer;
 }
 
@@ -147,14 +189,29 @@ void Leaf::set_path(const Hash* path) {
 }
 
 
+LeafSlot* Leaf::get_slot(byte nib) {
+    if (!occupied_.is_set(nib)) return nullptr;
+    return &slots_[occupied_.rank(nib)];
+}
+
+LeafSlot* Leaf::get_or_insert_slot(byte nib) {
+    size_t i = occupied_.rank(nib);
+    if (!occupied_.is_set(nib)) {
+        slots_.insert(i, {nib, 0, ZERO_HASH});
+        occupied_.set(nib);
+    }
+    return &slots_[i];
+}
+
 void Leaf::insert_child(
     byte nib, 
     const Hash* val_hash, 
     uint16_t block_id
 ) {
-    if (hash_is_zero(children_[nib])) count_++;
-    children_[nib] = *val_hash;
-    child_block_ids_[nib] = block_id;
+    LeafSlot* slot = get_or_insert_slot(nib);
+    if (hash_is_zero(slot->hash)) count_++;
+    slot->hash = *val_hash;
+    slot->blk_id = block_id;
 }
 
 std::optional<size_t> Leaf::matching_path(const Hash* key) {
@@ -178,22 +235,22 @@ int Leaf::generate_proof(
     const Hash* key,
     std::vector<Polynomial> &Fxs,
     std::vector<blst_p1> &Cs,
-    Bitmap<8>* split_map
+    ProofShape* shape
 ) { 
 
     std::optional<size_t> matching = matching_path(key);
     if (matching.has_value()) return NOT_EXIST;
-    if (hash_is_zero(children_[key->h[31]])) return NOT_EXIST;
+    LeafSlot* val = get_slot(key->h[31]);
+    if (!val || hash_is_zero(val->hash)) return NOT_EXIST;
 
     Polynomial Fx(BRANCH_ORDER, ZERO_SK);
-    for (int i{}; i < LEAF_ORDER; i++)
-        blst_scalar_from_le_bytes(&Fx[i], children_[i].h, 32);
+    fill_evals(Fx);
 
     Fxs.push_back(Fx);
 
     // need to push back two because two proofs are given for this
-    Cs.push_back(commit_);
-    Cs.push_back(commit_);
+    Cs.push_back(*commit_.get());
+    Cs.push_back(*commit_.get());
 
     return OK; 
 }
@@ -212,7 +269,9 @@ int Leaf::replace(
     if (matching.has_value()) return NOT_EXIST;
 
     if (prev_val_hash) {
-        if (children_[nib] != *prev_val_hash) {
+        LeafSlot* slot = get_slot(nib);
+        const Hash &current = slot ? slot->hash : ZERO_HASH;
+        if (current != *prev_val_hash) {
             return INVALID_PREV_VAL_HASH;
         }
     }
@@ -233,16 +292,21 @@ int Leaf::remove(
     std::optional<size_t> matching = matching_path(key);
     if (matching.has_value()) return NOT_EXIST;
 
-    byte nib = key->h[32];
-    if (!hash_is_zero(children_[nib])) {
-
+    byte nib = key->h[31];
+    LeafSlot* slot = get_slot(nib);
+    if (slot && !hash_is_zero(slot->hash)) {
 
         if (id_.get_block_id() != block_id) recache(block_id);
 
-        if (!hash_is_zero(children_[nib])) count_--;
+        count_--;
 
-        // remove child
-        children_[nib] = ZERO_HASH;
+        // remove child, a pending slot stays until justify
+        // so the value stored under its block can be dropped
+        slot->hash = ZERO_HASH;
+        if (slot->blk_id == 0) {
+            occupied_.clear(nib);
+            slots_.erase(occupied_.rank(nib));
+        }
 
         return OK;
     }
@@ -257,51 +321,42 @@ int Leaf::create_account(
     std::optional<size_t> matching = matching_path(key);
     if (!matching.has_value()) return ALREADY_EXISTS; // Already Exists
 
-    // Each character of a shared key path allocates a branch.
-    // each branch refrences the next through the associated path nibble
+    // The shared part of the path is one branch's extension,
+    // the branch then goes down on the first byte that differs
     size_t shared_path = matching.value();
-    std::vector<std::shared_ptr<Branch>> branches(shared_path + 1);
-
-    NodeId new_id = id_;
-    new_id.set_block_id(block_id);
-
-
-    for (int k = 0; k <= shared_path; k++) {
+    uint8_t start = id_.get_level();
+    uint8_t lvl = start + shared_path;
+    assert(key->h[lvl] != path_.h[lvl]);
 
-        branches[k] = create_branch(gadgets_, &new_id, nullptr);
+    NodeId branch_id = id_;
+    branch_id.set_block_id(block_id);
 
-        if (k < shared_path) {
-            byte nib = key->h[new_id.get_level()];
-            branches[k]->insert_child(nib, block_id);
+    auto branch = create_branch(gadgets_, &branch_id, nullptr);
+    branch->set_ext(key->h + start, shared_path);
 
-            new_id.set_child_nibble(nib);
-            new_id.increment_level();
-        }
-    }
-
-    uint8_t lvl = new_id.get_level();
-    assert(key->h[lvl] != path_.h[lvl]);
-    
-    new_id.increment_level();
 
-    // INSERT NEW LEAF INTO LAST BRANCH
-    new_id.set_self_nibble(key->h[lvl]);
+    // INSERT NEW LEAF INTO BRANCH
+    NodeId new_id = branch_id;
+    new_id.append_path(key->h + start, shared_path + 1);
     auto leaf = create_leaf(gadgets_, &new_id, nullptr);
     leaf->set_path(key);
     gadgets_->alloc.cache_node(leaf);
-    branches.back()->insert_child(key->h[lvl], block_id);
+    branch->insert_child(key->h[lvl], block_id);
+    branch->set_child_weight(key->h[lvl], leaf->get_weight());
 
 
-    // INSERT OLD LEAF INTO LAST BRANCH
-    new_id.set_self_nibble(path_.h[lvl]);
-    int cache_res = gadgets_->alloc.recache(&id_, &new_id);
+    // INSERT OLD LEAF INTO BRANCH
+    new_id = branch_id;
+    new_id.append_path(path_.h + start, shared_path + 1);
+    int cache_res = gadgets_->alloc.recache(this, &id_, &new_id);
     if (cache_res != OK) return cache_res;
-    branches.back()->insert_child(path_.h[lvl], block_id);
+    branch->insert_child(path_.h[lvl], block_id);
+    branch->set_child_weight(path_.h[lvl], get_weight());
 
 
-    // due to the fact that one of these branches has this* id_
+    // due to the fact that the branch has this* id_
     // we have to wait to cache until after this* has been recached under a new id 
-    for (auto &branch: branches) gadgets_->alloc.cache_node(branch);
+    gadgets_->alloc.cache_node(branch);
 
     return OK;
 }
@@ -324,26 +379,8 @@ inline int Leaf::delete_account(
 
 int Leaf::prune(uint16_t block_id) {
 
-    NodeId tmp = id_;
-    tmp.set_block_id(block_id);
-    tmp.increment_level();
-
-    for (int i{}; i < LEAF_ORDER; i++) {
-        if (child_block_ids_[i] != block_id) continue;
-
-        tmp.set_self_nibble(i);
-
-        void* trx = gadgets_->alloc.db_.start_txn();
-        int rc = gadgets_->alloc.db_.del(
-            tmp.get_full(), tmp.size(), trx
-        );
-        gadgets_->alloc.db_.end_txn(trx, rc);
-        if (rc != OK && rc != MDB_NOTFOUND) 
-            return DELETE_VALUE_ERR;
-    }
-
     // should_delete() evals to true now
-    is_deleted_ = true;
+    discard();
 
     // delete
     auto res = gadgets_->alloc.delete_node(&id_);
@@ -354,95 +391,37 @@ int Leaf::prune(uint16_t block_id) {
 }
 
 int Leaf::justify(uint16_t block_id) {
-
-    NodeId child_id = id_; 
-    child_id.increment_level();
-
-    // change all child block ids != 0 -> 0
-    for (int i{}; i < LEAF_ORDER; i++) {
-        if (child_block_ids_[i] == 0) continue;
-
-        child_id.set_block_id(child_block_ids_[i]);
-        child_id.set_self_nibble(i);
-
-        /*  
-         *  if self is being deleted delete every value 
-         *  else rename value 
-         *  if not found just continue 
-         *      (could be trying to delete ZERO_HASH)
-        */
-        if (should_delete() || hash_is_zero(children_[i])) {
-
-            void* trx = gadgets_->alloc.db_.start_txn();
-            int rc = gadgets_->alloc.db_.del(
-                child_id.get_full(), child_id.size(), trx
-            );
-            gadgets_->alloc.db_.end_txn(trx, rc);
-            if (rc != OK && rc != MDB_NOTFOUND) 
-                return DELETE_VALUE_ERR;
-
-        } else {
-
-            void* out_data = nullptr;
-            size_t size = 0;
-
-            // GET
-            void* trx = gadgets_->alloc.db_.start_rd_txn();
-            int rc = gadgets_->alloc.db_.get_raw(
-                child_id.get_full(), child_id.size(),
-                &out_data, &size, trx
-            );
-            gadgets_->alloc.db_.end_txn(trx, rc);
-            if (rc != OK && rc != MDB_NOTFOUND) {
-                free(out_data);
-                return rc;
-            }
-
-            child_id.set_block_id(0);
-
-            // PUT
-            trx = gadgets_->alloc.db_.start_txn();
-            rc = gadgets_->alloc.db_.put(
-                child_id.get_full(), child_id.size(),
-                out_data, size, 
-                trx
-            );
-            gadgets_->alloc.db_.end_txn(trx, rc);
-            free(out_data);
-            if (rc != OK) return rc;
+    // values are inline, so only the slots need moving
+    for (size_t i{}; i < slots_.size();) {
+        LeafSlot &slot = slots_[i];
+        if (slot.blk_id == 0) { i++; continue; }
+
+        slot.blk_id = 0;
+
+        // nothing left to track
+        if (hash_is_zero(slot.hash)) {
+            occupied_.clear(slot.nib);
+            slots_.erase(i);
+            continue;
         }
-
-        child_block_ids_[i] = 0;
+        i++;
     }
 
-    if (id_.get_block_id() == block_id) {
-
-        // delete self under this id
-        auto del_res = gadgets_->alloc.delete_node(&id_, true);
-        if (del_res.is_err()) return del_res.unwrap_err();
-
-        // if have no children
-        if (should_delete()) return DELETED;
-
-        id_.set_block_id(0);
-
-        Node_ptr new_self = del_res.unwrap();
-
-        // this* and new_self should point to same addr
-        assert(std::addressof(*this) == std::addressof(*new_self.get()));
-
-        gadgets_->alloc.cache_node(new_self);
-
-    } else {
-        // if have no children
-        if (should_delete()) return DELETED;
+    if (should_delete()) return DELETED;
+    return OK;
+}
 
-        uint16_t prev_block_id = id_.get_block_id();
-        id_.set_block_id(0);
-        
-        gadgets_->alloc.persist_node(this);
+size_t Leaf::apply_batch(
+    const TrieOp* ops, size_t n,
+    int* results,
+    uint16_t block_id
+) {
+    for (size_t i{}; i < n; i++) {
+        results[i] = apply_op(this, ops[i], block_id);
 
-        id_.set_block_id(prev_block_id);
+        // this id now holds the branches above both accounts
+        bool split = ops[i].kind == OP_CREATE_ACCOUNT && results[i] == OK;
+        if (split || should_delete()) return i + 1;
     }
-    return OK;
+    return n;
 }
@@ -20,21 +20,37 @@
 #include "fft.h"
 #include "gadgets.h"
 #include "helpers.h"
+#include "lazy_commitment.h"
+#include "small_vec.h"
 
-// TODO -- make children vector cleaner...like branch
+// most accounts hold only a handful of values
+const size_t LEAF_INLINE_SLOTS = 8;
+
+struct LeafSlot {
+    byte nib;
+    uint16_t blk_id;
+    Hash hash;
+};
 
 class Leaf : public Node {
 private:
     NodeId id_;
     Hash path_;
 
-    Commitment commit_;
+    LazyCommitment commit_;
 
     uint8_t count_;
     bool is_deleted_;
 
-    std::vector<Hash> children_;
-    std::vector<uint16_t> child_block_ids_;
+    // occupied_ marks which nibs have a slot,
+    // slots_ is packed and sorted by nib.
+    // a slot outlives its value (zero hash) until
+    // its block id is justified back to 0
+    Bitmap<LEAF_ORDER> occupied_;
+    SmallVec<LeafSlot, LEAF_INLINE_SLOTS> slots_;
+
+    LeafSlot* get_slot(byte nib);
+    LeafSlot* get_or_insert_slot(byte nib);
 
     Gadgets_ptr gadgets_;
 
@@ -59,36 +75,59 @@ public:
         NodeId tmp_id_ = id_;
         tmp_id_.set_block_id(block_id);
 
-        int cache_res = gadgets_->alloc.recache(&id_, &tmp_id_);
+        int cache_res = gadgets_->alloc.recache(this, &id_, &tmp_id_);
         if (cache_res != OK) return cache_res;
         return OK;
     }
 
     bool should_delete() const override { return is_deleted_; };
+    void discard() override { is_deleted_ = true; }
+
+    const Commitment* get_commitment() const override { return commit_.get(); };
+    void set_commitment(const Commitment &c) override { commit_.set(c); };
+    void set_commitment(const Commitment &c, const blst_p1_affine &aff) override { 
+        commit_.set(c, aff); 
+    }
+
+    const blst_scalar* get_scalar() const override { 
+        return commit_.scalar(&gadgets_->settings.tag); 
+    }
+
+    void fill_evals(Polynomial &poly) const override {
+        for (auto &slot: slots_) {
+            if (!hash_is_zero(slot.hash))
+                blst_scalar_from_le_bytes(&poly[slot.nib], slot.hash.h, 32);
+        }
+    }
 
-    const Commitment* get_commitment() const override { return &commit_; };
-    void set_commitment(const Commitment &c) override { commit_ = c; };
     const Commitment* derive_commitment() override {
         Polynomial poly(BRANCH_ORDER, ZERO_SK);
-        for (int i{}; i < LEAF_ORDER; i++) {
-            if (!hash_is_zero(children_[i]))
-                blst_scalar_from_le_bytes(&poly[i], children_[i].h ,32);
-        }
+        fill_evals(poly);
 
         inverse_fft_in_place(poly, gadgets_->settings.roots.inv_roots);
-        commit_g1(&commit_, poly, gadgets_->settings.setup);
-        return &commit_;
+
+        Commitment c;
+        commit_g1(&c, poly, gadgets_->settings.setup);
+        commit_.set(c);
+        return commit_.get();
     }
 
     const NodeId* get_id() const override { return &id_; }
     void set_id(const NodeId* h) override { id_ = *h; }
+
+    Node_ptr clone() const override { return gadgets_->alloc.make_node<Leaf>(*this); }
     void set_path(const Hash* path);
 
     std::optional<size_t> matching_path(const Hash* key);
 
     const NodeId* get_next_id(byte nib) override { return nullptr; }
 
+    // one account, and its slots
+    Weight get_weight() const override { return {1, encoded_size()}; }
+
     std::vector<byte> to_bytes() const override;
+    size_t encoded_size() const override;
+    size_t encode(byte* out) const override;
 
     inline int put(
         const Hash* key,
@@ -124,7 +163,7 @@ public:
         const Hash* key,
         std::vector<Polynomial> &Fxs,
         std::vector<blst_p1> &Cs,
-        Bitmap<8>* split_map
+        ProofShape* shape
     ) override;
 
     inline int finalize(
@@ -147,14 +186,32 @@ public:
         const Hash* key,
         const Commitment &commitment
     ) override {
-        return blst_p1_is_equal(&commit_, &commitment);
+        return blst_p1_is_equal(commit_.get(), &commitment);
     }
+
+    size_t apply_batch(
+        const TrieOp* ops, size_t n,
+        int* results,
+        uint16_t block_id
+    ) override;
 };
 
-inline std::shared_ptr<Leaf> create_leaf(
+inline Ref<Leaf> create_leaf(
     Gadgets_ptr gadgets, 
     const NodeId* id, 
     const ByteSlice* buff
 ) {
-    return std::make_shared<Leaf>(gadgets, id, buff);
+    return gadgets->alloc.make_node<Leaf>(gadgets, id, buff);
 }
+
+// the LEAF_V2 layout Leaf::encode writes, for leaves put together
+// without a Leaf. slots both empty and justified are left out
+size_t leaf_encoded_size(const LeafSlot* slots, size_t n);
+size_t encode_leaf(
+    byte* out,
+    const LazyCommitment &commit,
+    const std::string* tag,
+    const Hash &path,
+    uint8_t count,
+    const LeafSlot* slots, size_t n
+);
@@ -21,15 +21,63 @@
 #include "nodeid.h"
 #include "state_types.h"
 #include "polynomial.h"
-#include <memory>
+#include "ref.h"
+#include "slab.h"
+#include <atomic>
 
 class Node;
-using Node_ptr = std::shared_ptr<Node>;
+using Node_ptr = Ref<Node>;
+
+enum OpKind : uint8_t {
+    OP_PUT = 0,
+    OP_REPLACE = 1,
+    OP_REMOVE = 2,
+    OP_CREATE_ACCOUNT = 3,
+    OP_DELETE_ACCOUNT = 4,
+};
+
+// one state op with its key already hashed (last byte the value index)
+struct TrieOp {
+    OpKind kind;
+    Hash key;
+    const Hash* val_hash;
+    const Hash* prev_val_hash;
+};
+
+// what a proof carries besides its openings, enough for
+// a verifier to tell which key byte each level was opened at
+struct ProofShape {
+    // levels that reuse their parent's nibble
+    Bitmap<8> split_map{};
+
+    // path bytes each branch's extension skipped, leaf end first
+    std::vector<uint8_t> skips;
+};
 
 class Node {
+protected:
+    Node() = default;
+
+    // a copy starts unreferenced, make_node gives it its own slab
+    Node(const Node&) {}
+
 public:
     virtual ~Node() = default;
 
+    // intrusive count behind Node_ptr
+    std::atomic<uint32_t> refs_{0};
+
+    // slab this node was carved from, nullptr if from the heap
+    SlabClass* slab_{nullptr};
+
+    // what is stored under its id already, so it isn't written back.
+    // only cannonical versions have it, nothing changes those in place
+    // without writing them
+    bool synced_{false};
+
+    // member-wise copy under the same id, not synced
+    virtual Node_ptr clone() const = 0;
+
     virtual const NodeId* get_id() const = 0;
     virtual void set_id(const NodeId* id) = 0;
 
@@ -37,11 +85,34 @@ public:
     virtual void set_commitment(const Commitment &c) = 0;
     virtual const Commitment* derive_commitment() = 0;
 
+    // when the affine form is already known, saves an inversion later
+    virtual void set_commitment(
+        const Commitment &c, 
+        const blst_p1_affine &aff
+    ) = 0;
+
+    // what this node commits to, evaluated over the BRANCH_ORDER roots
+    virtual void fill_evals(Polynomial &poly) const = 0;
+
+    // hashed commitment, what a parent stores for this node
+    virtual const blst_scalar* get_scalar() const = 0;
+
     virtual bool should_delete() const = 0;
 
+    // empties the node so should_delete() holds 
+    // and it is never written back
+    virtual void discard() = 0;
+
+    // of this node and everything under it
+    virtual Weight get_weight() const = 0;
+
     virtual const NodeId* get_next_id(byte nib) = 0;
     virtual std::vector<byte> to_bytes() const = 0;
 
+    // encode writes exactly encoded_size() bytes into out
+    virtual size_t encoded_size() const = 0;
+    virtual size_t encode(byte* out) const = 0;
+
     virtual int put(
         const Hash* key,
         const Hash* val_hash,
@@ -74,7 +145,7 @@ public:
         const Hash* key,
         std::vector<Polynomial> &Fxs,
         std::vector<blst_p1> &Cs,
-        Bitmap<8>* split_map
+        ProofShape* shape
     ) = 0;
 
 
@@ -87,13 +158,83 @@ public:
         Polynomial* Fx = nullptr
     ) = 0;
 
+    // deletes this node and the subtree under it of block_id
     virtual int prune(uint16_t block_id) = 0;
 
+    // points this node, one of block_id's versions, at the cannonical
+    // ids of its children. moving the node itself is up to the allocator
     virtual int justify(uint16_t block_id) = 0;
 
+    // stores a finalized child's scalar, if the child at 
+    // anchor is this block's. nodes without children ignore it
+    virtual void set_child_scalar(
+        [[maybe_unused]] byte anchor, 
+        [[maybe_unused]] uint16_t block_id, 
+        [[maybe_unused]] const blst_scalar &sk
+    ) {}
+
+    // commits what a node derives from its children ahead of
+    // its own commitment, once their scalars are all in. 
+    // only a split has anything, its ranges
+    virtual int commit_ranges([[maybe_unused]] uint16_t block_id) { return OK; }
+
     virtual bool commit_is_in_path(
         const Hash* key,
         const Commitment &commitment
     ) = 0;
+
+    /*
+     *  applies ops (sorted by key) in order, results[i] is what
+     *  the single op call would have returned for ops[i].
+     *  returns how many were applied, which is less than n when
+     *  an op changes what node lives at this id (a leaf splitting
+     *  into branches, a node deleting itself). the caller
+     *  re-resolves the id and carries on with the rest.
+     */
+    virtual size_t apply_batch(
+        const TrieOp* ops, size_t n,
+        int* results,
+        uint16_t block_id
+    ) = 0;
+
+    // same contract as apply_batch, but nodes that can
+    // hand disjoint subtrees to separate threads do so
+    virtual size_t apply_batch_parallel(
+        const TrieOp* ops, size_t n,
+        int* results,
+        uint16_t block_id
+    ) {
+        return apply_batch(ops, n, results, block_id);
+    }
 };
 
+inline int apply_op(Node* node, const TrieOp &op, uint16_t block_id) {
+    switch (op.kind) {
+        case OP_PUT: 
+            return node->put(&op.key, op.val_hash, block_id);
+        case OP_REPLACE: 
+            return node->replace(&op.key, op.val_hash, op.prev_val_hash, block_id);
+        case OP_REMOVE: 
+            return node->remove(&op.key, block_id);
+        case OP_CREATE_ACCOUNT: 
+            return node->create_account(&op.key, block_id);
+        case OP_DELETE_ACCOUNT: 
+            return node->delete_account(&op.key, block_id);
+    }
+    return NOT_EXIST;
+}
+
+inline void ref_retain(Node* node) {
+    node->refs_.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void ref_release(Node* node) {
+    if (node->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    // destructor may persist, so it runs before the slot is recycled
+    SlabClass* slab = node->slab_;
+    node->~Node();
+
+    if (slab) slab->deallocate(node);
+    else ::operator delete(node);
+}
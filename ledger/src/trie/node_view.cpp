@@ -0,0 +1,326 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "node_view.h"
+#include "helpers.h"
+#include <cstring>
+
+bool BranchView::valid() const {
+    if (size_ < 1 || !is_branch_type(buf_[0])) return false;
+
+    // the extension size, or the count, has to be there first
+    if (size_ < 2 + commit_size(buf_[0]) + 1) return false;
+    if (size_ < header_size()) return false;
+
+    size_t end = header_size() + children_size();
+    if (size_ < end) return false;
+    if (buf_[0] != BRANCH_V2 || !is_split()) return true;
+
+    // and the ranges
+    if (size_ < end + 1) return false;
+    return size_ >= end + 1 + ranges_count() * (CHILD_SIZE + WEIGHT_SIZE);
+}
+
+// entries are sorted by anchor, find the last anchor <= nib
+static const byte* find_entry(const byte* entries, size_t count, byte nib) {
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (entries[mid * BranchView::CHILD_SIZE] <= nib) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return nullptr;
+
+    const byte* entry = entries + (lo - 1) * BranchView::CHILD_SIZE;
+    if (nib <= entry[1]) return entry;
+
+    return nullptr;
+}
+
+const byte* BranchView::get_child(byte nib) const {
+    return find_entry(buf_ + header_size(), children_count(), nib);
+}
+
+uint8_t BranchView::ranges_count() const {
+    if (buf_[0] != BRANCH_V2 || !is_split()) return 0;
+    return buf_[header_size() + children_size()];
+}
+
+const byte* BranchView::get_range(byte nib) const {
+    if (ranges_count() == 0) return nullptr;
+    return find_entry(range_at(0), ranges_count(), nib);
+}
+
+void BranchView::get_range_evals(const byte* range, Polynomial &Fx) const {
+    const byte* child = buf_ + header_size();
+    for (int k{}; k < children_count(); k++, child += CHILD_SIZE) {
+        if (child[0] < range[0] || range[1] < child[0]) continue;
+        child_sk(child, &Fx[child[0]]);
+    }
+}
+
+bool BranchView::ext_matches(const byte* path, uint8_t level, size_t len) const {
+    // nothing branches on the slot byte
+    if (key_level(level) >= 32 - 1) return false;
+    if (level >= len) return true;
+
+    size_t n = std::min<size_t>(ext_size(), len - level);
+    return std::memcmp(path + level, ext(), n) == 0;
+}
+
+void BranchView::child_sk(const byte* child, blst_scalar* out) {
+    blst_scalar_from_le_bytes(out, child + 2, sizeof(blst_scalar));
+}
+
+uint16_t BranchView::child_blk_id(const byte* child) {
+    uint16_t blk_id;
+    std::memcpy(&blk_id, child + 2 + sizeof(blst_scalar), sizeof(uint16_t));
+    return blk_id;
+}
+
+bool BranchView::get_next_id(const NodeId* self, byte nib, NodeId* out) const {
+    const byte* child = get_child(nib);
+    if (!child) return false;
+
+    blst_scalar sk;
+    child_sk(child, &sk);
+    if (scalar_is_zero(sk)) return false;
+
+    *out = *self;
+    out->set_block_id(child_blk_id(child));
+
+    out->append_path(ext(), ext_size());
+    out->append_path(&nib, 1);
+
+    return true;
+}
+
+void BranchView::get_evals(Polynomial &Fx) const {
+    bool ranges = ranges_count() > 0;
+    const byte* child = ranges ? range_at(0) : buf_ + header_size();
+    int count = ranges ? ranges_count() : children_count();
+
+    for (int k{}; k < count; k++, child += CHILD_SIZE) {
+        blst_scalar sk;
+        child_sk(child, &sk);
+
+        for (int i = child[0]; i <= child[1]; i++) Fx[i] = sk;
+    }
+}
+
+
+bool LeafView::valid() const {
+    if (size_ < 1 || (buf_[0] != LEAF && buf_[0] != LEAF_V2)) return false;
+    if (size_ < header_size()) return false;
+    return size_ >= header_size() + slots_count() * CHILD_SIZE;
+}
+
+bool LeafView::matches(const Hash* key, uint8_t level) const {
+    // Last byte of key is a value index, so ignore it
+    const size_t KEY_SIZE = 32 - 1;
+    if (level >= KEY_SIZE) return true;
+
+    return std::memcmp(path() + level, key->h + level, KEY_SIZE - level) == 0;
+}
+
+const byte* LeafView::get_value(byte nib) const {
+    const byte* slot = buf_ + header_size();
+    for (int k{}; k < slots_count(); k++, slot += CHILD_SIZE) {
+        if (slot[0] == nib) return slot + 1;
+
+        // slots are written in nib order
+        if (slot[0] > nib) break;
+    }
+    return nullptr;
+}
+
+void LeafView::get_evals(Polynomial &Fx) const {
+    const byte* slot = buf_ + header_size();
+    for (int k{}; k < slots_count(); k++, slot += CHILD_SIZE)
+        blst_scalar_from_le_bytes(&Fx[slot[0]], slot + 1, 32);
+}
+
+
+int read_generate_proof(
+    Gadgets_ptr gadgets,
+    const NodeId* id,
+    const Hash* key,
+    std::vector<Polynomial> &Fxs,
+    std::vector<blst_p1> &Cs,
+    ProofShape* shape
+) {
+    NodeAllocator &alloc = gadgets->alloc;
+
+    Node_ptr cached = alloc.peek_node(id);
+    if (cached) return cached->generate_proof(key, Fxs, Cs, shape);
+
+    Polynomial Fx(BRANCH_ORDER, ZERO_SK);
+    Commitment C;
+    NodeId next_id;
+    bool is_leaf{};
+    uint8_t skip{};
+
+    // a split's range, between it and the child
+    std::optional<Polynomial> range_Fx;
+
+    const void* data = nullptr;
+    size_t size = 0;
+
+    // pull out what this level contributes and release 
+    // the txn before descending, the view dies with it
+    void* trx = alloc.db_.start_rd_txn();
+    int rc = alloc.db_.get_view(id->get_full(), id->size(), &data, &size, trx);
+    if (rc == OK) {
+        const byte* buf = static_cast<const byte*>(data);
+
+        if (is_branch_type(buf[0])) {
+            BranchView view(buf, size);
+            uint8_t lvl = id->get_level();
+
+            if (!view.valid()) rc = INVALID_NODE;
+            else if (!view.ext_matches(key->h, lvl)) rc = NOT_EXIST;
+            else if (!view.get_next_id(id, key->h[view.key_level(lvl)], &next_id)) rc = NOT_EXIST;
+            else {
+                if (view.is_split()) shape->split_map.set(lvl);
+
+                const byte* range = view.get_range(key->h[view.key_level(lvl)]);
+                if (range) {
+                    range_Fx.emplace(BRANCH_ORDER, ZERO_SK);
+                    view.get_range_evals(range, *range_Fx);
+                }
+
+                skip = view.ext_size();
+                view.get_evals(Fx);
+                C = view.commitment();
+            }
+
+        } else {
+            LeafView view(buf, size);
+            is_leaf = true;
+
+            if (!view.valid()) rc = INVALID_NODE;
+            else if (!view.matches(key, id->get_level())) rc = NOT_EXIST;
+            else {
+                const byte* val = view.get_value(key->h[31]);
+                if (!val || hash_is_zero(new_hash(val))) rc = NOT_EXIST;
+                else {
+                    view.get_evals(Fx);
+                    C = view.commitment();
+                }
+            }
+        }
+    }
+    alloc.db_.end_txn(trx, rc);
+    if (rc != OK) return rc;
+
+    if (is_leaf) {
+        Fxs.push_back(Fx);
+
+        // need to push back two because two proofs are given for this
+        Cs.push_back(C);
+        Cs.push_back(C);
+        return OK;
+    }
+
+    rc = read_generate_proof(gadgets, &next_id, key, Fxs, Cs, shape);
+    if (rc != OK) return rc;
+
+    if (range_Fx) {
+        shape->skips.push_back(0);
+        Cs.push_back(commit_evals(*range_Fx, gadgets->settings));
+        Fxs.push_back(std::move(*range_Fx));
+    }
+
+    shape->skips.push_back(skip);
+    Fxs.push_back(Fx);
+    Cs.push_back(C);
+
+    return OK;
+}
+
+Result<bool, int> read_commit_is_in_path(
+    Gadgets_ptr gadgets,
+    const NodeId* id,
+    const Hash* key,
+    const Commitment &commitment
+) {
+    NodeAllocator &alloc = gadgets->alloc;
+
+    Node_ptr cached = alloc.peek_node(id);
+    if (cached) return cached->commit_is_in_path(key, commitment);
+
+    std::optional<bool> found;
+    bool is_split{};
+    blst_scalar child_sk = ZERO_SK;
+    NodeId next_id;
+
+    const void* data = nullptr;
+    size_t size = 0;
+
+    void* trx = alloc.db_.start_rd_txn();
+    int rc = alloc.db_.get_view(id->get_full(), id->size(), &data, &size, trx);
+    if (rc == OK) {
+        const byte* buf = static_cast<const byte*>(data);
+
+        if (is_branch_type(buf[0])) {
+            BranchView view(buf, size);
+
+            if (!view.valid()) rc = INVALID_NODE;
+            else {
+                uint8_t lvl = id->get_level();
+                Commitment C = view.commitment();
+                const byte* child = view.ext_matches(key->h, lvl) 
+                    ? view.get_child(key->h[view.key_level(lvl)]) 
+                    : nullptr;
+
+                if (blst_p1_is_equal(&C, &commitment)) found = true;
+                else if (!child) found = false;
+                else if (!view.get_next_id(id, BranchView::child_anchor(child), &next_id)) 
+                    found = false;
+                else {
+                    is_split = view.is_split();
+                    BranchView::child_sk(child, &child_sk);
+                }
+            }
+
+        } else {
+            LeafView view(buf, size);
+
+            if (!view.valid()) rc = INVALID_NODE;
+            else {
+                Commitment C = view.commitment();
+                found = blst_p1_is_equal(&C, &commitment);
+            }
+        }
+    }
+    alloc.db_.end_txn(trx, rc);
+    if (rc != OK) return rc;
+
+    if (found.has_value()) return found.value();
+
+    Result<bool, int> res = read_commit_is_in_path(gadgets, &next_id, key, commitment);
+    if (res.is_ok() || !is_split) return res;
+
+    // this node is the split into other shards
+    // so we dont have the rest of the shard we can just check 
+    // the specified child hash and thats all
+    blst_scalar sk;
+    hash_p1_to_scalar(&commitment, &sk, &gadgets->settings.tag);
+    return equal_scalars(sk, child_sk);
+}
@@ -0,0 +1,184 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  Borrowed, read only views over a serialized node.
+ *
+ *  A view never copies the node out of the page it lives on,
+ *  so it is only valid for as long as the read txn that produced it.
+ *  Read only traversals (proofs, commit_is_in_path) use them to walk
+ *  the parts of a path that are not already in the node cache
+ *  without building and caching a Branch or Leaf for each step.
+ *
+ *  Layouts are the ones written by Branch::to_bytes and Leaf::to_bytes,
+ *  in either commitment encoding.
+ */
+
+#pragma once
+#include "alloc.h"
+#include "fft.h"
+#include "gadgets.h"
+#include "helpers.h"
+#include "lazy_commitment.h"
+#include "polynomial.h"
+#include "state_types.h"
+
+inline size_t commit_size(byte type) {
+    return is_v2_type(type) ? COMMIT_V2_SIZE : blst_p1_sizeof();
+}
+
+inline Commitment commit_from_bytes(byte type, const byte* buf) {
+    if (!is_v2_type(type)) return p1_from_bytes(buf);
+
+    blst_p1_affine aff;
+    blst_p1_deserialize(&aff, buf);
+
+    Commitment c;
+    blst_p1_from_affine(&c, &aff);
+    return c;
+}
+
+// what a node with these evals over the BRANCH_ORDER roots commits to
+inline Commitment commit_evals(Polynomial poly, const KZGSettings &settings) {
+    inverse_fft_in_place(poly, settings.roots.inv_roots);
+
+    Commitment c;
+    commit_g1(&c, poly, settings.setup);
+    return c;
+}
+
+class BranchView {
+private:
+    const byte* buf_;
+    size_t size_;
+
+public:
+    static constexpr size_t CHILD_SIZE = 2 + sizeof(blst_scalar) + sizeof(uint16_t);
+
+    // type, is_split, commitment, [extension size, extension], count
+    size_t header_size() const { 
+        size_t ext = buf_[0] == BRANCH_V2 ? 1 + ext_size() : 0;
+        return 2 + commit_size(buf_[0]) + ext + 1; 
+    }
+
+    // children then, for v2, their weights. a v2 split's ranges follow
+    // as their count, then laid out the same
+    size_t children_size() const { 
+        size_t weights = buf_[0] == BRANCH_V2 ? WEIGHT_SIZE : 0;
+        return children_count() * (CHILD_SIZE + weights); 
+    }
+
+    BranchView(const byte* buf, size_t size) : buf_(buf), size_(size) {}
+
+    bool valid() const;
+    bool is_split() const { return buf_[1]; }
+    Commitment commitment() const { return commit_from_bytes(buf_[0], buf_ + 2); }
+
+    // path bytes skipped before branching, only v2 has any
+    uint8_t ext_size() const { 
+        return buf_[0] == BRANCH_V2 ? buf_[2 + commit_size(buf_[0])] : 0; 
+    }
+    const byte* ext() const { return buf_ + 3 + commit_size(buf_[0]); }
+
+    // level of the key byte the branch at level goes down on
+    size_t key_level(uint8_t level) const { return level + ext_size(); }
+
+    // path agrees with the extension, as far as its first len bytes go.
+    // false when the extension runs into the slot byte
+    bool ext_matches(const byte* path, uint8_t level, size_t len = 32 - 1) const;
+
+    uint8_t children_count() const { return buf_[header_size() - 1]; }
+
+    // child covering nib or nullptr
+    const byte* get_child(byte nib) const;
+
+    // k'th child in anchor order
+    const byte* child_at(uint8_t k) const { return buf_ + header_size() + k * CHILD_SIZE; }
+
+    static byte child_anchor(const byte* child) { return child[0]; }
+    static void child_sk(const byte* child, blst_scalar* out);
+    static uint16_t child_blk_id(const byte* child);
+
+    // mirrors Branch::get_next_id, false if there is no live child
+    bool get_next_id(const NodeId* self, byte nib, NodeId* out) const;
+
+    // what the node commits to, a split's are its ranges
+    void get_evals(Polynomial &Fx) const;
+
+    // zero unless a v2 split
+    uint8_t ranges_count() const;
+    const byte* range_at(uint8_t k) const { 
+        return buf_ + header_size() + children_size() + 1 + k * CHILD_SIZE; 
+    }
+
+    // range covering nib, nullptr if not a split
+    const byte* get_range(byte nib) const;
+
+    // the children under range, as the range commits to them
+    void get_range_evals(const byte* range, Polynomial &Fx) const;
+};
+
+class LeafView {
+private:
+    const byte* buf_;
+    size_t size_;
+
+public:
+    static constexpr size_t CHILD_SIZE = 1 + 32 + sizeof(uint16_t);
+
+    // type, commitment, path, count, slots count
+    size_t header_size() const { return 1 + commit_size(buf_[0]) + 32 + 2; }
+
+    LeafView(const byte* buf, size_t size) : buf_(buf), size_(size) {}
+
+    bool valid() const;
+    Commitment commitment() const { return commit_from_bytes(buf_[0], buf_ + 1); }
+    const byte* path() const { return buf_ + 1 + commit_size(buf_[0]); }
+    uint8_t slots_count() const { return buf_[header_size() - 1]; }
+
+    // the key's path matches from level on
+    bool matches(const Hash* key, uint8_t level) const;
+
+    // value hash at nib or nullptr
+    const byte* get_value(byte nib) const;
+
+    // k'th slot in nib order, nib then value hash
+    const byte* slot_at(uint8_t k) const { return buf_ + header_size() + k * CHILD_SIZE; }
+
+    void get_evals(Polynomial &Fx) const;
+};
+
+// same contract as Node::generate_proof for the node at id,
+// cached nodes are used as is, anything else is read through a view
+int read_generate_proof(
+    Gadgets_ptr gadgets,
+    const NodeId* id,
+    const Hash* key,
+    std::vector<Polynomial> &Fxs,
+    std::vector<blst_p1> &Cs,
+    ProofShape* shape
+);
+
+// same contract as Node::commit_is_in_path for the node at id,
+// errs when the node can't be read
+Result<bool, int> read_commit_is_in_path(
+    Gadgets_ptr gadgets,
+    const NodeId* id,
+    const Hash* key,
+    const Commitment &commitment
+);
@@ -51,6 +51,10 @@ NodeId::NodeId(const std::vector<byte>* key, uint16_t block_id) {
     std::memcpy(&buff_[BLOCK_ID_OFF], &block_id, BLOCK_ID_SIZE);
 }
 
+NodeId::NodeId(const byte* bytes) {
+    std::memcpy(buff_, bytes, ID_SIZE);
+}
+
 NodeId::~NodeId() {}
 
 bool NodeId::operator==(const NodeId& other) const noexcept {
@@ -99,10 +103,27 @@ void NodeId::set_self_nibble(byte nib) {
     buff_[buff_[LEVEL_OFF] - 1] = nib; 
 }
 
+void NodeId::append_path(const byte* bytes, size_t len) {
+    for (size_t i{}; i < len; i++) {
+        if (buff_[LEVEL_OFF] < PATH_SIZE) buff_[buff_[LEVEL_OFF]] = bytes[i];
+        buff_[LEVEL_OFF] += 1;
+    }
+}
+
 int NodeId::cmp(const Hash* b) {
     return std::memcmp(buff_, b->h, buff_[LEVEL_OFF]);
 }
 
+bool NodeId::is_under(const NodeId &ancestor) const {
+    if (*this == ancestor) return false;
+
+    uint8_t level = ancestor.get_level();
+    if (get_level() < level) return false;
+
+    size_t path_len = std::min<size_t>(level, PATH_SIZE);
+    return std::memcmp(buff_, ancestor.get_full(), path_len) == 0;
+}
+
 size_t NodeId::size() const { return ID_SIZE; }
 
 const byte* NodeId::get_full() const { 
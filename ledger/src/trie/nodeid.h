@@ -25,6 +25,7 @@
 
 // 13 bytes for path, 1 for level, and 2 for block_id
 const size_t ID_SIZE = 13 + 1 + 2;
+const size_t ID_PATH_SIZE = 13;
 
 class NodeId {
 private:
@@ -34,6 +35,8 @@ public:
     NodeId(const NodeId* other);
     NodeId(const Hash* key, uint8_t level, uint16_t block_id);
     NodeId(const std::vector<byte>* key, uint16_t block_id);
+    // ID_SIZE bytes as stored
+    explicit NodeId(const byte* bytes);
 
     bool operator ==(const NodeId& other) const noexcept;
     std::string to_string() const;
@@ -50,10 +53,16 @@ public:
     void set_child_nibble(byte nib);
     void set_self_nibble(byte nib);
 
+    // one level per byte, bytes past the stored path only count
+    void append_path(const byte* bytes, size_t len);
+
     const byte* get_full() const;
     std::array<byte, ID_SIZE> get_full_array() const;
 
     int cmp(const Hash* b);
+
+    // somewhere below ancestor in the trie, by path
+    bool is_under(const NodeId &ancestor) const;
     size_t size() const;
 };
 
@@ -28,6 +28,17 @@ constexpr uint64_t LEAF_ORDER   = 128;
 constexpr byte BRANCH = static_cast<byte>(69);
 constexpr byte LEAF   = static_cast<byte>(71);
 
+// commitment stored affine uncompressed with its hashed scalar,
+// the above are still read but only these are written.
+// a v2 branch has its extension after the commitment, the size
+// then the path bytes it skips before branching (zero without one),
+// its children's weights after them and a split's ranges last
+constexpr byte BRANCH_V2 = static_cast<byte>(70);
+constexpr byte LEAF_V2   = static_cast<byte>(72);
+
+inline bool is_branch_type(byte t) { return t == BRANCH || t == BRANCH_V2; }
+inline bool is_v2_type(byte t) { return t == BRANCH_V2 || t == LEAF_V2; }
+
 const uint64_t ROOT_NODE_ID = 0;
 
 inline Hash new_zero_hash() {
@@ -41,16 +52,42 @@ inline bool hash_is_zero(const Hash& h) {
     return std::memcmp(h.h, ZERO_HASH.h, 32) == 0;
 }
 
+// how much state is under a node, leaves being accounts
+// and bytes what its nodes take encoded
+struct Weight {
+    uint32_t leaves;
+    uint64_t bytes;
+
+    Weight& operator +=(const Weight &other) {
+        leaves += other.leaves;
+        bytes += other.bytes;
+        return *this;
+    }
+
+    // zero in max is no limit
+    bool exceeds(const Weight &max) const {
+        return (max.leaves && leaves > max.leaves) || (max.bytes && bytes > max.bytes);
+    }
+};
+constexpr size_t WEIGHT_SIZE = sizeof(uint32_t) + sizeof(uint64_t);
+
 struct Child {
     uint8_t anchor;
     uint8_t end;
     blst_scalar sk;
     uint16_t blk_id;
+
+    // of the subtree under it, for branches read 
+    // from a layout without weights this is zero
+    Weight weight;
 };
 
+// a shard root's hashed commitment, for the range
+// of the root's key byte that shard holds
 struct ShardVote {
+    byte first;
+    byte last;
     Hash hash;
-    Hash path;
 };
 
 inline bool paths_equal(const Hash* a, const Hash* b, int i) {
@@ -82,4 +119,14 @@ enum LedgerCodes {
     NULL_PARAMETER = 18,
     VAL_IDX_RANGE = 19,
     BLOCK_NOT_EXIST = 20,
+    INVALID_NODE = 21,
+    INVALID_OPS_BUFFER = 22,
+    ITER_END = 23,
+    INVALID_CHUNK = 24,
+    UNSORTED_KEYS = 25,
+    SHARDS_PENDING = 26,
+    INVALID_SHARD = 27,
+    INVALID_JUSTIFY_MODE = 28,
+    BLOCK_NOT_FINALIZED = 29,
+    MISSING_CHUNK = 30,
 };
@@ -18,6 +18,7 @@
 
 #pragma once
 #include <array>
+#include <bit>
 #include <cstdint>
 #include <cstring>
 #include <stdexcept>
@@ -64,14 +65,34 @@ public:
         data[byte_index] ^= (uint8_t(1) << bit_index);
     }
 
-    size_t count() const {
+    size_t count() const { return rank(BIT_SIZE); }
+
+    // number of set bits strictly below bit
+    size_t rank(size_t bit) const {
+        if (bit > BIT_SIZE)
+            throw std::out_of_range("Bit index out of range");
+
         size_t c = 0;
-        for (size_t i = 0; i < BIT_SIZE; i++) {
-            if (is_set(i)) c++;
+        size_t byte_end = bit / 8;
+        size_t i = 0;
+
+        for (; i + 8 <= byte_end; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, &data[i], sizeof(word));
+            c += std::popcount(word);
+        }
+        for (; i < byte_end; i++) c += std::popcount(data[i]);
+
+        size_t bit_index = bit % 8;
+        if (bit_index) {
+            uint8_t mask = (uint8_t(1) << bit_index) - 1;
+            c += std::popcount(uint8_t(data[byte_end] & mask));
         }
         return c;
     }
 
+    void reset() { data.fill(0); }
+
     // raw pointer interface
     uint8_t* data_ptr() {
         return data.data();
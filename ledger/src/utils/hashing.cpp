@@ -35,11 +35,14 @@ void derive_hash(byte* out, const ByteSlice &value) {
 }
 
 void hash_p1_to_scalar(const blst_p1* p1, blst_scalar* s, const std::string* tag) {
-    BlakeHasher hasher;
-    hasher.update(reinterpret_cast<const byte*>(tag->data()), tag->size());
-
     byte c_bytes[48];
     blst_p1_compress(c_bytes, p1);
+    hash_compressed_to_scalar(c_bytes, s, tag);
+}
+
+void hash_compressed_to_scalar(const byte* c_bytes, blst_scalar* s, const std::string* tag) {
+    BlakeHasher hasher;
+    hasher.update(reinterpret_cast<const byte*>(tag->data()), tag->size());
 
     hasher.update(c_bytes, 48);
 
@@ -56,6 +56,8 @@ Hash new_hash(const byte* h = nullptr);
 void print_hash(const Hash &hash);
 void seeded_hash(Hash* out, int i);
 void hash_p1_to_scalar(const blst_p1* p1, blst_scalar* s, const std::string* tag);
+// same scalar as hash_p1_to_scalar, from an already compressed point
+void hash_compressed_to_scalar(const byte* c_bytes, blst_scalar* s, const std::string* tag);
 
 struct HashHash {
     size_t operator()(const Hash& h) const noexcept {
@@ -67,3 +69,9 @@ struct HashHash {
         return static_cast<size_t>(h1);
     }
 };
+
+struct HashLess {
+    bool operator()(const Hash& a, const Hash& b) const noexcept {
+        return std::memcmp(a.h, b.h, sizeof(a.h)) < 0;
+    }
+};
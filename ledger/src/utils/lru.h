@@ -34,6 +34,14 @@ public:
         return &it->second->second;
     }
 
+    // like get() but leaves the eviction order untouched
+    Value* peek(const Key& key) {
+        auto it = map.find(key);
+        if (it == map.end())
+            return nullptr;
+        return &it->second->second;
+    }
+
     std::optional<std::tuple<Key, Value>> put(const Key& key, Value value) {
         auto it = map.find(key);
         if (it != map.end()) {
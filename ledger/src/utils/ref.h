@@ -0,0 +1,78 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstddef>
+#include <utility>
+
+/*
+ *  Intrusive reference counted pointer.
+ *  T supplies the count, found through ADL:
+ *      void ref_retain(T*)
+ *      void ref_release(T*)    // disposes of T when the count hits 0
+ */
+template <typename T>
+class Ref {
+public:
+    Ref() : ptr_(nullptr) {}
+    Ref(std::nullptr_t) : ptr_(nullptr) {}
+
+    explicit Ref(T* ptr) : ptr_(ptr) { 
+        if (ptr_) ref_retain(ptr_); 
+    }
+
+    Ref(const Ref& other) : ptr_(other.ptr_) { 
+        if (ptr_) ref_retain(ptr_); 
+    }
+    Ref(Ref&& other) noexcept : ptr_(other.ptr_) { 
+        other.ptr_ = nullptr; 
+    }
+
+    // upcasts, Ref<Leaf> -> Ref<Node>
+    template <typename U>
+    Ref(const Ref<U>& other) : ptr_(other.get()) { 
+        if (ptr_) ref_retain(ptr_); 
+    }
+    template <typename U>
+    Ref(Ref<U>&& other) noexcept : ptr_(other.detach()) {}
+
+    ~Ref() { if (ptr_) ref_release(ptr_); }
+
+    Ref& operator=(Ref other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        return *this;
+    }
+
+    T* get() const { return ptr_; }
+    T* operator->() const { return ptr_; }
+    T& operator*() const { return *ptr_; }
+    explicit operator bool() const { return ptr_ != nullptr; }
+
+    bool operator==(std::nullptr_t) const { return ptr_ == nullptr; }
+    bool operator==(const Ref& other) const { return ptr_ == other.ptr_; }
+
+    // hands the reference to the caller
+    T* detach() {
+        T* p = ptr_;
+        ptr_ = nullptr;
+        return p;
+    }
+
+private:
+    T* ptr_;
+};
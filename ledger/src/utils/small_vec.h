@@ -0,0 +1,100 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// vector that keeps up to N elements inline
+// and only spills to the heap past that.
+// T is expected to be trivially copyable.
+template <typename T, size_t N>
+class SmallVec {
+public:
+    SmallVec() : size_{}, inline_{} {}
+
+    // ----- capacity / state -----
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool on_heap() const { return size_ > N; }
+
+    void clear() {
+        size_ = 0;
+        heap_.clear();
+        heap_.shrink_to_fit();
+    }
+
+    // ----- access -----
+    T* data() { return on_heap() ? heap_.data() : inline_.data(); }
+    const T* data() const { return on_heap() ? heap_.data() : inline_.data(); }
+
+    T& operator[](size_t i) { return data()[i]; }
+    const T& operator[](size_t i) const { return data()[i]; }
+
+    T* begin() { return data(); }
+    T* end() { return data() + size_; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size_; }
+
+    // ---- insert ----
+    // places value at idx, shifting the rest up
+    void insert(size_t idx, const T& value) {
+        assert(idx <= size_);
+
+        if (size_ == N) {
+            // spill
+            heap_.assign(inline_.begin(), inline_.end());
+        }
+
+        if (size_ >= N) {
+            heap_.insert(heap_.begin() + idx, value);
+        } else {
+            for (size_t i = size_; i > idx; i--) inline_[i] = inline_[i - 1];
+            inline_[idx] = value;
+        }
+        size_++;
+    }
+
+    void push_back(const T& value) { insert(size_, value); }
+
+    // ---- erase ----
+    void erase(size_t idx) {
+        assert(idx < size_);
+
+        if (on_heap()) {
+            heap_.erase(heap_.begin() + idx);
+
+            if (size_ - 1 == N) {
+                // back inline
+                for (size_t i{}; i < N; i++) inline_[i] = heap_[i];
+                heap_.clear();
+                heap_.shrink_to_fit();
+            }
+        } else {
+            for (size_t i = idx; i + 1 < size_; i++) inline_[i] = inline_[i + 1];
+        }
+        size_--;
+    }
+
+private:
+    size_t size_;
+    std::array<T, N> inline_;
+    std::vector<T> heap_;
+};
@@ -0,0 +1,160 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thread_pool.h"
+
+namespace {
+    // which pool the current thread works for, and its queue
+    thread_local const ThreadPool* tls_pool = nullptr;
+    thread_local size_t tls_index = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads) :
+    stop_{false},
+    queued_{0},
+    next_queue_{0}
+{
+    queues_.reserve(threads);
+    for (size_t i{}; i < threads; i++) 
+        queues_.push_back(std::make_unique<WorkQueue>());
+
+    workers_.reserve(threads);
+    for (size_t i{}; i < threads; i++) 
+        workers_.emplace_back([this, i] { worker_loop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(sleep_mux_);
+        stop_ = true;
+    }
+    sleep_cv_.notify_all();
+
+    for (auto &w: workers_) w.join();
+}
+
+size_t ThreadPool::self_index() const {
+    return tls_pool == this ? tls_index : size();
+}
+
+void ThreadPool::submit(Task task) {
+    if (workers_.empty()) {
+        task();
+        return;
+    }
+
+    // workers keep what they spawn, everyone else spreads it out
+    size_t idx = self_index();
+    if (idx == size()) idx = next_queue_.fetch_add(1) % size();
+
+    {
+        std::lock_guard lock(queues_[idx]->mux);
+        queues_[idx]->tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+
+    // taking the lock orders this against a worker checking queued_
+    { std::lock_guard lock(sleep_mux_); }
+    sleep_cv_.notify_one();
+}
+
+bool ThreadPool::pop(size_t self, Task &out) {
+    if (queued_.load() == 0) return false;
+
+    // newest of our own first
+    if (self < size()) {
+        WorkQueue &q = *queues_[self];
+        std::lock_guard lock(q.mux);
+        if (!q.tasks.empty()) {
+            out = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // then the oldest of someone else's
+    size_t start = self < size() ? self + 1 : 0;
+    for (size_t k{}; k < size(); k++) {
+        size_t victim = (start + k) % size();
+        if (victim == self) continue;
+
+        WorkQueue &q = *queues_[victim];
+        std::lock_guard lock(q.mux);
+        if (!q.tasks.empty()) {
+            out = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::run_one() {
+    Task task;
+    if (!pop(self_index(), task)) return false;
+    task();
+    return true;
+}
+
+void ThreadPool::worker_loop(size_t idx) {
+    tls_pool = this;
+    tls_index = idx;
+
+    Task task;
+    while (true) {
+        if (pop(idx, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock lock(sleep_mux_);
+        sleep_cv_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+        if (stop_) return;
+    }
+}
+
+void TaskGroup::spawn(ThreadPool::Task task) {
+    pending_.fetch_add(1);
+    pool_.submit([this, task = std::move(task)] {
+        task();
+        std::lock_guard lock(done_mux_);
+        if (pending_.fetch_sub(1, std::memory_order_release) == 1) 
+            done_cv_.notify_all();
+    });
+}
+
+void TaskGroup::wait() {
+    size_t spins{};
+    while (pending_.load(std::memory_order_acquire) != 0) {
+        if (pool_.run_one()) {
+            spins = 0;
+            continue;
+        }
+        if (++spins > WAIT_SPINS) break;
+        std::this_thread::yield();
+    }
+
+    // also waits out the notify of a task that just finished
+    std::unique_lock lock(done_mux_);
+    done_cv_.wait(lock, [this] {
+        return pending_.load(std::memory_order_acquire) == 0;
+    });
+}
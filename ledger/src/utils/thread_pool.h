@@ -0,0 +1,110 @@
+/*
+ * Bullet Ledger
+ * Copyright (C) 2025 Joshua Olson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ *  Fixed set of worker threads, each with its own deque.
+ *  Workers pop their own newest task first and steal the oldest
+ *  from the others when they run dry, so a task that spawns
+ *  subtasks keeps them warm on its own thread unless someone is idle.
+ *
+ *  TaskGroup::wait runs queued tasks on the waiting thread, so tasks
+ *  can spawn and wait on tasks of their own without tying up a worker.
+ *  Once nothing is queued and a short spin hasn't seen the group
+ *  finish, the waiter sleeps until the last task wakes it. Whatever
+ *  is left of the group is running by then, so sleeping can't
+ *  strand work only the waiter could pick up.
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    // with zero threads tasks run inline on submit
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    void submit(Task task);
+
+    // runs one queued task on the calling thread,
+    // false if there was nothing to run
+    bool run_one();
+
+private:
+    struct WorkQueue {
+        std::mutex mux;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<bool> stop_;
+    std::atomic<size_t> queued_;
+    std::atomic<size_t> next_queue_;
+
+    std::mutex sleep_mux_;
+    std::condition_variable sleep_cv_;
+
+    // index of the calling thread's queue, or size() if it isn't ours
+    size_t self_index() const;
+
+    bool pop(size_t self, Task &out);
+    void worker_loop(size_t idx);
+};
+
+// tracks a set of spawned tasks so they can be waited on together
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool &pool) : pool_(pool), pending_{0} {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void spawn(ThreadPool::Task task);
+
+    // helps run queued tasks until every spawned task has finished
+    void wait();
+
+private:
+    // times wait finds nothing to run before it sleeps
+    static constexpr size_t WAIT_SPINS = 64;
+
+    ThreadPool &pool_;
+    std::atomic<size_t> pending_;
+
+    // the last task to finish notifies under done_mux_,
+    // so wait can't return while it still touches the group
+    std::mutex done_mux_;
+    std::condition_variable done_cv_;
+};
@@ -17,11 +17,18 @@
  */
 
 #include "bitmap.h"
+#include "branch.h"
+#include "extern.h"
 #include "hashing.h"
 #include "helpers.h"
+#include "leaf.h"
 #include "ledger.h"
 #include "processing.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <numeric>
 
 void main_state_trie() {
     namespace fs = std::filesystem;
@@ -41,6 +48,28 @@ void main_state_trie() {
         seeded_hash(&raw_hashes[i], i);
     }
 
+    // body gets a ledger on an emptied dir, which is 
+    // left behind for a reopen until the caller removes it
+    auto run_fresh = [&](const std::string &dir, auto &&body) {
+        if (fs::exists(dir)) fs::remove_all(dir);
+        fs::create_directory(dir);
+
+        Ledger fresh(dir, CACHE_SIZE, MAP_SIZE, DST, SECRET);
+        body(fresh);
+    };
+
+    // body(ledger, m, root) once per dir, each on a fresh ledger, 
+    // has to leave the same root every time. gives that root
+    auto same_root_runs = [&](const std::vector<std::string> &dirs, auto &&body) {
+        std::vector<Hash> roots(dirs.size());
+        for (size_t m{}; m < dirs.size(); m++) 
+            run_fresh(dirs[m], [&](Ledger &fresh) { body(fresh, m, roots[m]); });
+
+        for (size_t m = 1; m < dirs.size(); m++) 
+            assert(std::memcmp(roots[0].h, roots[m].h, 32) == 0);
+        return roots[0];
+    };
+
 
 
     ///////////////////////////
@@ -106,14 +135,14 @@ void main_state_trie() {
         Hash key_hash = val_hash;
         key_hash.h[31] = idx;
 
-        Bitmap<8> split_map{};
+        ProofShape shape{};
 
-        int res = generate_proof(l, Cs, Pis, &split_map, &key_hash, &block_hash);
+        int res = generate_proof(l, Cs, Pis, &shape, &key_hash, &block_hash);
         printf("GENERATED %d\n", res);
         assert(res == OK);
 
         // PROVING
-        assert(valid_proof(l, &Cs, &Pis, &split_map, &key_hash, &val_hash, idx, &block_hash));
+        assert(valid_proof(l, &Cs, &Pis, &shape, &key_hash, &val_hash, idx, &block_hash));
         printf("PROVED %d\n", res);
 
         Cs.clear();
@@ -129,10 +158,10 @@ void main_state_trie() {
 
     Hash key_hash = val_hash_tmp;
 
-    Bitmap<8> split_map{};
+    ProofShape shape{};
 
     key_hash.h[31] = 32;
-    res = generate_proof(l, Cs, Pis, &split_map, &key_hash, &block_hash);
+    res = generate_proof(l, Cs, Pis, &shape, &key_hash, &block_hash);
     assert(res != OK);
     assert(res == NOT_EXIST);
 
@@ -148,20 +177,596 @@ void main_state_trie() {
     res = justify_block(l, &block_hash);
     assert(res == OK);
 
-    Bitmap<8> split_map1{};
-    res = generate_proof(l, Cs, Pis, &split_map1, &key_hash, nullptr);
+    ProofShape shape1{};
+    res = generate_proof(l, Cs, Pis, &shape1, &key_hash, nullptr);
     assert(res == OK);
-    assert(valid_proof(l, &Cs, &Pis, &split_map1, &key_hash, &val_hash_tmp, idx));
+    assert(valid_proof(l, &Cs, &Pis, &shape1, &key_hash, &val_hash_tmp, idx));
     printf("SUCCESSFUL JUSTIFICATION \n");
 
 
 
+    /////////////////////////
+    // --- READ phase --- //
+    ///////////////////////
+    Hash got;
+    res = l.get(rh, idx, &got);
+    assert(res == OK);
+    assert(std::memcmp(got.h, val_hash_tmp.h, 32) == 0);
+
+    res = l.get(rh, 32, &got);
+    assert(res == NOT_EXIST);
+
+    // pinned before the next block is justified
+    std::unique_ptr<Snapshot> snap;
+    res = l.open_snapshot(snap);
+    assert(res == OK);
+
+    res = snap->get(&key_hash, &got);
+    assert(res == OK);
+    assert(std::memcmp(got.h, val_hash_tmp.h, 32) == 0);
+
+    // a pending block reads once finalized, and not while it changes
+    Hash pending_block;
+    seeded_hash(&pending_block, 1500);
+    res = l.put(rh, &base, idx, &pending_block, nullptr);
+    assert(res == OK);
+
+    res = l.get(rh, idx, &got, &pending_block);
+    assert(res == BLOCK_NOT_FINALIZED);
+
+    Hash pending_root;
+    res = finalize_block(l, &pending_block, &pending_root);
+    assert(res == OK);
+
+    res = l.get(rh, idx, &got, &pending_block);
+    assert(res == OK);
+    assert(std::memcmp(got.h, base.h, 32) == 0);
+
+    res = l.put(rh, &val_hash_tmp, idx, &pending_block, nullptr);
+    assert(res == OK);
+    res = l.get(rh, idx, &got, &pending_block);
+    assert(res == BLOCK_NOT_FINALIZED);
+
+    res = prune_block(l, &pending_block);
+    assert(res == OK);
+
+    // batched, with a miss mixed in
+    std::vector<ByteSlice> many_keys;
+    std::vector<uint8_t> many_idxs;
+    for (i = 0; i < 20; i++) {
+        many_keys.emplace_back(raw_hashes[i].h, 32);
+        many_idxs.push_back(i == 7 ? 32 : idx);
+    }
+    std::vector<Hash> many_outs(many_keys.size());
+    std::vector<int> many_res(many_keys.size());
+
+    res = l.multi_get(
+        many_keys.data(), many_idxs.data(), many_keys.size(), 
+        many_outs.data(), many_res.data()
+    );
+    assert(res == OK);
+
+    for (i = 0; i < many_keys.size(); i++) {
+        if (i == 7) {
+            assert(many_res[i] == NOT_EXIST);
+            continue;
+        }
+        Hash expect;
+        derive_hash(expect.h, many_keys[i]);
+
+        assert(many_res[i] == OK);
+        assert(std::memcmp(many_outs[i].h, expect.h, 32) == 0);
+    }
+
+    // prefix scans
+    Hash first_hash;
+    derive_hash(first_hash.h, many_keys[0]);
+
+    size_t expect_under{};
+    for (Hash raw: raw_hashes) {
+        Hash k;
+        derive_hash(k.h, ByteSlice(raw.h, 32));
+        if (k.h[0] == first_hash.h[0]) expect_under++;
+    }
+
+    std::unique_ptr<RangeIter> it;
+    res = l.iter(it, first_hash.h, 1);
+    assert(res == OK);
+
+    Hash it_key, it_val, prev_key = new_hash();
+    uint8_t it_slot;
+    size_t under{};
+    while ((res = it->next(&it_key, &it_slot, &it_val)) == OK) {
+        assert(it_key.h[0] == first_hash.h[0]);
+        assert(std::memcmp(prev_key.h, it_key.h, 32) < 0);
+        prev_key = it_key;
+
+        if (it_slot != idx) continue;
+
+        // values here are the unindexed key hash
+        assert(std::memcmp(it_val.h, it_key.h, 31) == 0);
+        under++;
+    }
+    assert(res == ITER_END);
+    assert(under == expect_under);
+
+    res = l.iter(it, nullptr, 0);
+    assert(res == OK);
+    size_t total{};
+    while (it->next(&it_key, &it_slot, &it_val) == OK) 
+        if (it_slot == idx) total++;
+    assert(total == raw_hashes.size());
+
+    Hash exact = first_hash;
+    exact.h[31] = idx;
+    res = l.iter(it, exact.h, 32);
+    assert(res == OK);
+    res = it->next(&it_key, &it_slot, &it_val);
+    assert(res == OK);
+    assert(it_slot == idx);
+    assert(std::memcmp(it_val.h, first_hash.h, 32) == 0);
+    res = it->next(&it_key, &it_slot, &it_val);
+    assert(res == ITER_END);
+    it.reset();
+
+    printf("SUCCESSFUL READ \n");
+
+
+
+    /////////////////////////
+    // --- SYNC phase --- //
+    ///////////////////////
+    std::unique_ptr<ChunkExporter> exporter;
+    res = l.export_chunks(exporter, 1);
+    assert(res == OK);
+
+    std::vector<std::vector<byte>> chunks;
+    std::vector<byte> chunk;
+    while ((res = exporter->next(chunk)) == OK) chunks.push_back(chunk);
+    assert(res == ITER_END);
+    assert(chunks.size() > 1);
+    exporter.reset();
+
+    const char* sync_path = "./fake_db_sync";
+    if (fs::exists(sync_path)) fs::remove_all(sync_path);
+    fs::create_directory(sync_path);
+    {
+        Ledger replica(sync_path, CACHE_SIZE, MAP_SIZE, DST, SECRET);
+
+        std::vector<ByteSlice> slices;
+        for (auto &c: chunks) slices.emplace_back(c.data(), c.size());
+
+        // a changed value in any chunk fails the lot
+        std::vector<byte> forged = chunks.back();
+        forged[forged.size() - 10] ^= 1;
+
+        std::vector<ByteSlice> bad = slices;
+        bad.back() = ByteSlice(forged.data(), forged.size());
+        res = replica.import_chunks(bad, &h);
+        assert(res == INVALID_CHUNK);
+
+        // each chunk checks out, but not all of the trie is there
+        std::vector<ByteSlice> partial(slices.begin(), slices.end() - 1);
+        res = replica.import_chunks(partial, &h);
+        assert(res == MISSING_CHUNK);
+
+        res = replica.import_chunks(slices, &h);
+        assert(res == OK);
+
+        res = replica.get(rh, idx, &got);
+        assert(res == OK);
+        assert(std::memcmp(got.h, val_hash_tmp.h, 32) == 0);
+    }
+    fs::remove_all(sync_path);
+
+    printf("SUCCESSFUL SYNC \n");
+
+
+
+    /////////////////////////
+    // --- BULK phase --- //
+    ///////////////////////
+    std::vector<Hash> sorted_vals;
+    for (Hash raw: raw_hashes) {
+        Hash v;
+        derive_hash(v.h, ByteSlice(raw.h, 32));
+        sorted_vals.push_back(v);
+    }
+    std::sort(sorted_vals.begin(), sorted_vals.end(), [](const Hash &a, const Hash &b) {
+        return std::memcmp(a.h, b.h, 32) < 0;
+    });
+
+    const char* bulk_path = "./fake_db_bulk";
+    if (fs::exists(bulk_path)) fs::remove_all(bulk_path);
+    fs::create_directory(bulk_path);
+    {
+        Ledger built(bulk_path, CACHE_SIZE, MAP_SIZE, DST, SECRET);
+
+        std::unique_ptr<BulkLoader> loader;
+        res = built.bulk_load(loader);
+        assert(res == OK);
+
+        for (auto &v: sorted_vals) {
+            res = loader->add(&v, idx, &v);
+            assert(res == OK);
+        }
+        res = loader->add(&sorted_vals[0], idx, &sorted_vals[0]);
+        assert(res == UNSORTED_KEYS);
+
+        // same trie as the one put together key by key
+        Hash built_root;
+        res = loader->finish(&built_root);
+        assert(res == OK);
+        assert(std::memcmp(built_root.h, h.h, 32) == 0);
+
+        res = built.get(rh, idx, &got);
+        assert(res == OK);
+        assert(std::memcmp(got.h, val_hash_tmp.h, 32) == 0);
+    }
+    fs::remove_all(bulk_path);
+
+    printf("SUCCESSFUL BULK \n");
+
+
+
+    //////////////////////////////
+    // --- EXTENSION phase --- //
+    ////////////////////////////
+    // raw keys whose hashes share a prefix, a and b two bytes or 
+    // more, c only the first byte with them
+    std::vector<std::pair<Hash, Hash>> cands;
+    for (i = 0; i < 4096; i++) {
+        Hash raw;
+        seeded_hash(&raw, 1000 + i);
+
+        Hash kh;
+        derive_hash(kh.h, ByteSlice(raw.h, 32));
+        cands.push_back({kh, raw});
+    }
+    std::sort(cands.begin(), cands.end(), [](auto &a, auto &b) {
+        return std::memcmp(a.first.h, b.first.h, 32) < 0;
+    });
+
+    size_t pair{};
+    while (std::memcmp(cands[pair].first.h, cands[pair + 1].first.h, 2) != 0) pair++;
+
+    size_t third{};
+    while (
+        cands[third].first.h[0] != cands[pair].first.h[0] ||
+        cands[third].first.h[1] == cands[pair].first.h[1]
+    ) third++;
+
+    std::vector<std::pair<Hash, Hash>> ext_keys = {cands[pair], cands[pair + 1], cands[third]};
+    for (auto &[kh, raw]: ext_keys) kh.h[31] = idx;
+
+    Hash ext_root;
+    const char* ext_path = "./fake_db_ext";
+    if (fs::exists(ext_path)) fs::remove_all(ext_path);
+    fs::create_directory(ext_path);
+    {
+        Ledger le(ext_path, CACHE_SIZE, MAP_SIZE, DST, SECRET);
+
+        Hash ext_block;
+        seeded_hash(&ext_block, 888);
+        for (i = 0; i < 2; i++) {
+            auto &[kh, raw] = ext_keys[i];
+            ByteSlice key(raw.h, 32);
+
+            res = le.create_account(key, &ext_block, nullptr);
+            assert(res == OK);
+            res = le.put(key, &kh, idx, &ext_block, nullptr);
+            assert(res == OK);
+        }
+        res = finalize_block(le, &ext_block, &ext_root);
+        assert(res == OK);
+        res = justify_block(le, &ext_block);
+        assert(res == OK);
+
+        // one branch above both leaves, skipping what they share
+        for (i = 0; i < 2; i++) {
+            auto &[kh, raw] = ext_keys[i];
+
+            ProofShape ext_shape{};
+            res = generate_proof(le, Cs, Pis, &ext_shape, &kh, nullptr);
+            assert(res == OK);
+            assert(Cs.size() == 4);
+            assert(ext_shape.skips[0] > 0);
+            assert(valid_proof(le, &Cs, &Pis, &ext_shape, &kh, &kh, idx));
+            Cs.clear();
+            Pis.clear();
+        }
+
+        // off the extension, though every byte past it matches a's
+        std::unique_ptr<Snapshot> ext_snap;
+        res = le.open_snapshot(ext_snap);
+        assert(res == OK);
+
+        Hash off = ext_keys[0].first;
+        off.h[1] ^= 1;
+        res = ext_snap->get(&off, &got);
+        assert(res == NOT_EXIST);
+        ext_snap.reset();
+
+        // c parts from them inside the extension, splitting it
+        seeded_hash(&ext_block, 889);
+        {
+            auto &[kh, raw] = ext_keys[2];
+            ByteSlice key(raw.h, 32);
+
+            res = le.create_account(key, &ext_block, nullptr);
+            assert(res == OK);
+            res = le.put(key, &kh, idx, &ext_block, nullptr);
+            assert(res == OK);
+        }
+        res = finalize_block(le, &ext_block, &ext_root);
+        assert(res == OK);
+        res = justify_block(le, &ext_block);
+        assert(res == OK);
+
+        for (auto &[kh, raw]: ext_keys) {
+            res = le.get(ByteSlice(raw.h, 32), idx, &got);
+            assert(res == OK);
+            assert(std::memcmp(got.h, kh.h, 32) == 0);
+
+            ProofShape ext_shape{};
+            res = generate_proof(le, Cs, Pis, &ext_shape, &kh, nullptr);
+            assert(res == OK);
+            assert(valid_proof(le, &Cs, &Pis, &ext_shape, &kh, &kh, idx));
+            Cs.clear();
+            Pis.clear();
+        }
+    }
+    fs::remove_all(ext_path);
+
+    // the bulk loader lands on the same shape
+    std::sort(ext_keys.begin(), ext_keys.end(), [](auto &a, auto &b) {
+        return std::memcmp(a.first.h, b.first.h, 32) < 0;
+    });
+    if (fs::exists(bulk_path)) fs::remove_all(bulk_path);
+    fs::create_directory(bulk_path);
+    {
+        Ledger built(bulk_path, CACHE_SIZE, MAP_SIZE, DST, SECRET);
+
+        std::unique_ptr<BulkLoader> loader;
+        res = built.bulk_load(loader);
+        assert(res == OK);
+
+        for (auto &[kh, raw]: ext_keys) {
+            res = loader->add(&kh, idx, &kh);
+            assert(res == OK);
+        }
+
+        Hash built_root;
+        res = loader->finish(&built_root);
+        assert(res == OK);
+        assert(std::memcmp(built_root.h, ext_root.h, 32) == 0);
+    }
+    fs::remove_all(bulk_path);
+
+    printf("SUCCESSFUL EXTENSION \n");
+
+
+
+    //////////////////////////////
+    // --- PROOF CACHE phase --- //
+    ////////////////////////////
+    std::vector<byte> cached;
+    res = generate_cached_proof(l, &key_hash, cached);
+    assert(res == OK);
+
+    std::vector<byte> cached_hit;
+    res = generate_cached_proof(l, &key_hash, cached_hit);
+    assert(res == OK);
+    assert(cached == cached_hit);
+
+    Hash other_key;
+    ByteSlice other_rh{raw_hashes[2].h, sizeof(raw_hashes[2].h)};
+    derive_hash(other_key.h, other_rh);
+    Hash other_val = other_key;
+    other_key.h[31] = idx;
+
+    res = generate_cached_proof(l, &other_key, cached);
+    assert(res == OK);
+
+    // touch one key in a new block and justify it
+    Hash cache_block;
+    seeded_hash(&cache_block, 777);
+
+    Hash new_val;
+    seeded_hash(&new_val, 778);
+
+    ByteSlice first_key{raw_hashes[0].h, sizeof(raw_hashes[0].h)};
+    res = l.put(first_key, &new_val, idx, &cache_block);
+    assert(res == OK);
+
+    res = finalize_block(l, &cache_block, &h);
+    assert(res == OK);
+
+    res = justify_block(l, &cache_block);
+    assert(res == OK);
+
+    // new reads see the justified value, the snapshot doesn't
+    res = l.get(first_key, idx, &got);
+    assert(res == OK);
+    assert(std::memcmp(got.h, new_val.h, 32) == 0);
+
+    res = snap->get(&key_hash, &got);
+    assert(res == OK);
+    assert(std::memcmp(got.h, val_hash_tmp.h, 32) == 0);
+    snap.reset();
+
+    // touched path is re-opened from the leaf up
+    res = generate_cached_proof(l, &key_hash, cached);
+    assert(res == OK);
+    ProofShape cache_shape{};
+    decode_proof(cached.data(), Cs, Pis, &cache_shape);
+    assert(valid_proof(l, &Cs, &Pis, &cache_shape, &key_hash, &new_val, idx));
+    Cs.clear();
+    Pis.clear();
+
+    // untouched path only needs the root re-opened
+    res = generate_cached_proof(l, &other_key, cached);
+    assert(res == OK);
+    decode_proof(cached.data(), Cs, Pis, &cache_shape);
+    assert(valid_proof(l, &Cs, &Pis, &cache_shape, &other_key, &other_val, idx));
+    Cs.clear();
+    Pis.clear();
+
+    printf("SUCCESSFUL PROOF CACHE \n");
+
+
+
+    //////////////////////////
+    // --- BATCH phase --- //
+    ////////////////////////
+    Hash batch_block;
+    seeded_hash(&batch_block, 901);
+
+    std::vector<Hash> batch_keys(16);
+    for (i = 0; i < batch_keys.size(); i++) 
+        seeded_hash(&batch_keys[i], 2000 + i);
+
+    Hash wrong_prev;
+    seeded_hash(&wrong_prev, 902);
+
+    Hash missing_key;
+    seeded_hash(&missing_key, 903);
+
+    // shuffled on purpose, each account op still
+    // has to land before the puts that follow it
+    std::vector<LedgerOp> ops;
+    for (i = batch_keys.size() - 1; i >= 0; i--) {
+        ByteSlice key(batch_keys[i].h, 32);
+        ops.push_back({OP_CREATE_ACCOUNT, key, 0, nullptr, nullptr});
+        ops.push_back({OP_PUT, key, idx, &batch_keys[i], nullptr});
+    }
+    ops.push_back({OP_PUT, first_key, idx, &new_val, nullptr});
+    ops.push_back({OP_REPLACE, first_key, idx, &new_val, &wrong_prev});
+    ops.push_back({OP_PUT, {missing_key.h, 32}, idx, &new_val, nullptr});
+
+    std::vector<int> results;
+    res = l.apply_batch(ops, results, &batch_block);
+    assert(res == OK);
+    assert(results.size() == ops.size());
+
+    for (i = 0; i < batch_keys.size() * 2 + 1; i++) 
+        assert(results[i] == OK);
+    assert(results[ops.size() - 2] == INVALID_PREV_VAL_HASH);
+    assert(results[ops.size() - 1] == NOT_EXIST);
+
+    res = finalize_block(l, &batch_block, &h);
+    assert(res == OK);
+
+    res = prune_block(l, &batch_block);
+    assert(res == OK);
+
+    // root children worked on separate threads, and finalized
+    // depth first rather than from the dirty set, land on the same root
+    Hash parallel_block;
+    seeded_hash(&parallel_block, 904);
+
+    std::vector<int> parallel_results;
+    res = l.apply_batch(ops, parallel_results, &parallel_block, nullptr, true);
+    assert(res == OK);
+    assert(parallel_results == results);
+
+    Hash parallel_root;
+    res = finalize_block(l, &parallel_block, &parallel_root, FINALIZE_FORK_JOIN);
+    assert(res == OK);
+    assert(std::memcmp(parallel_root.h, h.h, 32) == 0);
+
+    res = prune_block(l, &parallel_block);
+    assert(res == OK);
+
+    // batched removes answer and commit like the single op calls
+    Hash remove_block;
+    seeded_hash(&remove_block, 905);
+
+    Hash single_block;
+    seeded_hash(&single_block, 906);
+
+    uint8_t empty_idx = idx + 1;
+    std::vector<LedgerOp> remove_ops{
+        {OP_REMOVE, first_key, idx, nullptr, nullptr},
+        {OP_REMOVE, first_key, empty_idx, nullptr, nullptr},
+        {OP_REMOVE, {missing_key.h, 32}, idx, nullptr, nullptr},
+    };
+
+    std::vector<int> remove_results;
+    res = l.apply_batch(remove_ops, remove_results, &remove_block);
+    assert(res == OK);
+    assert(remove_results[0] == OK);
+    assert(remove_results[1] == NOT_EXIST);
+    assert(remove_results[2] == NOT_EXIST);
+
+    for (i = 0; i < remove_ops.size(); i++) {
+        const LedgerOp &op = remove_ops[i];
+        res = l.remove(op.key, op.idx, &single_block);
+        assert(res == remove_results[i]);
+    }
+
+    Hash remove_root;
+    res = finalize_block(l, &remove_block, &remove_root);
+    assert(res == OK);
+
+    Hash single_root;
+    res = finalize_block(l, &single_block, &single_root);
+    assert(res == OK);
+    assert(std::memcmp(remove_root.h, single_root.h, 32) == 0);
+
+    res = prune_block(l, &single_block);
+    assert(res == OK);
+
+    // same removes through the flat op buffer
+    Hash flat_block;
+    seeded_hash(&flat_block, 907);
+
+    uint32_t flat_count = remove_ops.size();
+    std::vector<byte> flat{1};
+    flat.insert(flat.end(), (byte*)&flat_count, (byte*)&flat_count + 4);
+    for (const LedgerOp &op: remove_ops) {
+        uint16_t key_size = op.key.size();
+        flat.push_back(OP_REMOVE);
+        flat.push_back(op.idx);
+        flat.insert(flat.end(), (byte*)&key_size, (byte*)&key_size + 2);
+        flat.insert(flat.end(), op.key.data(), op.key.data() + key_size);
+        flat.insert(flat.end(), 64, 0);
+    }
+
+    std::vector<int> statuses(remove_ops.size());
+    res = ledger_apply_ops(
+        &l, flat.data(), flat.size(), 
+        &flat_block, nullptr, 
+        statuses.data(), statuses.size()
+    );
+    assert(res == OK);
+    assert(statuses == remove_results);
+
+    Hash flat_root;
+    res = finalize_block(l, &flat_block, &flat_root);
+    assert(res == OK);
+    assert(std::memcmp(flat_root.h, remove_root.h, 32) == 0);
+
+    res = prune_block(l, &remove_block);
+    assert(res == OK);
+    res = prune_block(l, &flat_block);
+    assert(res == OK);
+
+    printf("SUCCESSFUL BATCH \n");
+
+
+
     //////////////////////////
     // --- PRUNE phase --- //
     ////////////////////////
     seeded_hash(&block_hash, 1124);
     idx = 4;
 
+    Result<Node_ptr, int> cannon_res = l.get_root(nullptr, 0);
+    assert(cannon_res.is_ok());
+    Node_ptr cannon_before = cannon_res.unwrap();
+    Commitment cannon_commit = *cannon_before->get_commitment();
+
     i = 0;
     printf("INSERTING...AGAIN...\n");
     for (Hash h: raw_hashes) {
@@ -178,13 +783,928 @@ void main_state_trie() {
         i++;
     }
 
+    uint16_t pruned_id = l.get_block_id(&block_hash, false);
+    assert(pruned_id != 0);
+
+    // the block's root is a copy, the cannonical one is still cached as it was
+    cannon_res = l.get_root(nullptr, 0);
+    assert(cannon_res.is_ok());
+    Node_ptr cannon_after = cannon_res.unwrap();
+    assert(cannon_after->get_id()->get_block_id() == 0);
+    assert(blst_p1_is_equal(cannon_after->get_commitment(), &cannon_commit));
+
+    Result<Node_ptr, int> pruned_root = l.get_root(nullptr, pruned_id);
+    assert(pruned_root.is_ok());
+    assert(pruned_root.unwrap().get() != cannon_after.get());
+
     res = prune_block(l, &block_hash);
     assert(res == OK);
 
+    // every version the block wrote went with it
+    std::vector<NodeId> left_over;
+    res = gadgets->alloc.block_versions(pruned_id, left_over);
+    assert(res == OK);
+    assert(left_over.empty());
 
     printf("SUCCESSFUL PRUNING \n");
 
 
+    // --- SPLIT phase --- //
+    ////////////////////////
+    const char* split_path = "./fake_db_split";
+    if (fs::exists(split_path)) fs::remove_all(split_path);
+    fs::create_directory(split_path);
+    {
+        Ledger ls(split_path, CACHE_SIZE, MAP_SIZE, DST, SECRET);
+        ls.set_split_weight({16, 0});
+
+        Hash split_block;
+        seeded_hash(&split_block, 1200);
+        for (Hash raw: raw_hashes) {
+            ByteSlice key(raw.h, 32);
+
+            Hash vh;
+            derive_hash(vh.h, key);
+
+            res = ls.create_account(key, &split_block, nullptr);
+            assert(res == OK);
+            res = ls.put(key, &vh, idx, &split_block, nullptr);
+            assert(res == OK);
+        }
+
+        Hash split_root;
+        res = finalize_block(ls, &split_block, &split_root);
+        assert(res == OK);
+        res = justify_block(ls, &split_block);
+        assert(res == OK);
+
+        Result<Node_ptr, int> root_res = ls.get_root(nullptr, 0);
+        assert(root_res.is_ok());
+        Node_ptr root_node = root_res.unwrap();
+        Branch* root = static_cast<Branch*>(root_node.get());
+        assert(root->is_split());
+
+        std::vector<Child> ranges = root->get_ranges();
+        assert(ranges.size() > 1);
+        for (auto &range: ranges) assert(range.weight.leaves <= 16);
+
+        // an extra opening for the key's range, under the root
+        for (i = 0; i < 8; i++) {
+            Hash kh;
+            derive_hash(kh.h, ByteSlice(raw_hashes[i].h, 32));
+            Hash vh = kh;
+            kh.h[31] = idx;
+
+            ProofShape split_shape{};
+            res = generate_proof(ls, Cs, Pis, &split_shape, &kh, nullptr);
+            assert(res == OK);
+            assert(split_shape.split_map.is_set(0));
+            assert(valid_proof(ls, &Cs, &Pis, &split_shape, &kh, &vh, idx));
+            Cs.clear();
+            Pis.clear();
+        }
+
+        // only the first range is held, the rest is dropped
+        res = ls.set_shards({{0, 0}});
+        assert(res == OK);
+
+        Hash held_key{}, held_raw{};
+        bool have_held{};
+        for (Hash raw: raw_hashes) {
+            ByteSlice key(raw.h, 32);
+            Hash kh;
+            derive_hash(kh.h, key);
+
+            res = ls.get(key, idx, &got);
+            if (kh.h[0] > ranges[0].end) {
+                assert(res == NOT_IN_SHARD);
+                continue;
+            }
+            assert(res == OK);
+            assert(std::memcmp(got.h, kh.h, 32) == 0);
+
+            held_key = kh;
+            held_raw = raw;
+            have_held = true;
+        }
+
+        // the root still commits to what was dropped
+        if (have_held) {
+            held_key.h[31] = idx;
+            Hash vh;
+            derive_hash(vh.h, ByteSlice(held_raw.h, 32));
+
+            ProofShape split_shape{};
+            res = generate_proof(ls, Cs, Pis, &split_shape, &held_key, nullptr);
+            assert(res == OK);
+            assert(valid_proof(ls, &Cs, &Pis, &split_shape, &held_key, &vh, idx));
+            Cs.clear();
+            Pis.clear();
+
+            seeded_hash(&split_block, 1201);
+            res = ls.put(ByteSlice(held_raw.h, 32), &base, idx, &split_block, nullptr);
+            assert(res == OK);
+
+            Hash next_root;
+            res = finalize_block(ls, &split_block, &next_root);
+            assert(res == OK);
+            assert(std::memcmp(next_root.h, split_root.h, 32) != 0);
+            res = justify_block(ls, &split_block);
+            assert(res == OK);
+
+            res = ls.get(ByteSlice(held_raw.h, 32), idx, &got);
+            assert(res == OK);
+            assert(std::memcmp(got.h, base.h, 32) == 0);
+        }
+    }
+    fs::remove_all(split_path);
+
+    printf("SUCCESSFUL SPLIT \n");
+
+
+
+    // --- SHARD phase --- //
+    ////////////////////////
+    // the same split state on three ledgers, two of them holding half
+    // each. the halves' votes combine to what the whole has as root
+    std::vector<std::string> shard_paths = {
+        "./fake_db_shard_a", "./fake_db_shard_b", "./fake_db_shard_all"
+    };
+    {
+        Hash shard_block;
+        seeded_hash(&shard_block, 1300);
+
+        std::vector<std::unique_ptr<Ledger>> shards;
+        for (auto &shard_path: shard_paths) {
+            if (fs::exists(shard_path)) fs::remove_all(shard_path);
+            fs::create_directory(shard_path);
+
+            shards.push_back(std::make_unique<Ledger>(shard_path, CACHE_SIZE, MAP_SIZE, DST, SECRET));
+            Ledger &sl = *shards.back();
+            sl.set_split_weight({16, 0});
+
+            for (Hash raw: raw_hashes) {
+                ByteSlice key(raw.h, 32);
+
+                Hash vh;
+                derive_hash(vh.h, key);
+
+                res = sl.create_account(key, &shard_block, nullptr);
+                assert(res == OK);
+                res = sl.put(key, &vh, idx, &shard_block, nullptr);
+                assert(res == OK);
+            }
+
+            Hash first_root;
+            res = finalize_block(sl, &shard_block, &first_root);
+            assert(res == OK);
+            res = justify_block(sl, &shard_block);
+            assert(res == OK);
+        }
+        Ledger &sa = *shards[0];
+        Ledger &sb = *shards[1];
+        Ledger &whole = *shards[2];
+
+        Result<Node_ptr, int> root_res = whole.get_root(nullptr, 0);
+        assert(root_res.is_ok());
+        Node_ptr root_node = root_res.unwrap();
+        std::vector<Child> ranges = static_cast<Branch*>(root_node.get())->get_ranges();
+        assert(ranges.size() > 1);
+
+        res = sa.set_shards({{0, ranges[0].end}});
+        assert(res == OK);
+        res = sb.set_shards({{ranges[1].anchor, 255}});
+        assert(res == OK);
+
+        // one key in each half
+        Hash raw_a{}, raw_b{};
+        for (Hash raw: raw_hashes) {
+            Hash kh;
+            derive_hash(kh.h, ByteSlice(raw.h, 32));
+            if (kh.h[0] <= ranges[0].end) raw_a = raw;
+            else raw_b = raw;
+        }
+
+        seeded_hash(&shard_block, 1301);
+        res = sa.put(ByteSlice(raw_a.h, 32), &base, idx, &shard_block, nullptr);
+        assert(res == OK);
+        res = sa.put(ByteSlice(raw_b.h, 32), &base, idx, &shard_block, nullptr);
+        assert(res == NOT_IN_SHARD);
+        res = sb.put(ByteSlice(raw_b.h, 32), &base, idx, &shard_block, nullptr);
+        assert(res == OK);
+        for (Hash raw: {raw_a, raw_b}) {
+            res = whole.put(ByteSlice(raw.h, 32), &base, idx, &shard_block, nullptr);
+            assert(res == OK);
+        }
+
+        Hash expect;
+        res = finalize_block(whole, &shard_block, &expect);
+        assert(res == OK);
+
+        std::vector<ShardVote> votes_a, votes_b;
+        Hash root_a, root_b;
+        res = finalize_shards(sa, &shard_block, votes_a, &root_a);
+        assert(res == SHARDS_PENDING);
+        assert(votes_a.size() == 1);
+
+        std::vector<ShardRange> missing;
+        res = missing_shards(sa, &shard_block, missing);
+        assert(res == OK);
+        assert(missing.size() == ranges.size() - 1);
+
+        res = finalize_shards(sb, &shard_block, votes_b, &root_b);
+        assert(res == SHARDS_PENDING);
+        assert(votes_b.size() == ranges.size() - 1);
+
+        // a shard's own range isn't taken from elsewhere
+        res = insert_shard_hash(sa, &shard_block, votes_a[0], &root_a);
+        assert(res == INVALID_SHARD);
+
+        for (size_t k{}; k < votes_b.size(); k++) {
+            res = insert_shard_hash(sa, &shard_block, votes_b[k], &root_a);
+            assert(res == (k + 1 == votes_b.size() ? OK : SHARDS_PENDING));
+        }
+        res = insert_shard_hash(sb, &shard_block, votes_a[0], &root_b);
+        assert(res == OK);
+
+        assert(std::memcmp(root_a.h, expect.h, 32) == 0);
+        assert(std::memcmp(root_b.h, expect.h, 32) == 0);
+
+        for (auto &sl: shards) {
+            res = justify_block(*sl, &shard_block);
+            assert(res == OK);
+        }
+    }
+    for (auto &shard_path: shard_paths) fs::remove_all(shard_path);
+
+    printf("SUCCESSFUL SHARDS \n");
+
+
+
+    // --- REMAP phase --- //
+    ////////////////////////
+    // two blocks justified by copying and by remapping, the second 
+    // built on the first. both give the same roots and reads, before 
+    // and after settling, and a reopen settles what was left
+    std::vector<std::string> remap_paths = {"./fake_db_copy", "./fake_db_remap"};
+    {
+        auto check_reads = [&](Ledger &rl) {
+            for (size_t k{}; k < raw_hashes.size(); k++) {
+                ByteSlice key(raw_hashes[k].h, 32);
+                Hash kh;
+                derive_hash(kh.h, key);
+
+                res = rl.get(key, idx, &got);
+                assert(res == OK);
+                assert(std::memcmp(got.h, (k < 8 ? base : kh).h, 32) == 0);
+            }
+        };
+
+        Hash remap_root = same_root_runs(remap_paths, [&](Ledger &rl, size_t m, Hash &remap_hash) {
+            if (m == 1) rl.set_justify_mode(JUSTIFY_REMAP);
+
+            Hash remap_block;
+            seeded_hash(&remap_block, 1400);
+            for (Hash raw: raw_hashes) {
+                ByteSlice key(raw.h, 32);
+
+                Hash vh;
+                derive_hash(vh.h, key);
+
+                res = rl.create_account(key, &remap_block, nullptr);
+                assert(res == OK);
+                res = rl.put(key, &vh, idx, &remap_block, nullptr);
+                assert(res == OK);
+            }
+            res = finalize_block(rl, &remap_block, &remap_hash);
+            assert(res == OK);
+            res = justify_block(rl, &remap_block);
+            assert(res == OK);
+
+            seeded_hash(&remap_block, 1401);
+            for (i = 0; i < 8; i++) {
+                res = rl.put(ByteSlice(raw_hashes[i].h, 32), &base, idx, &remap_block, nullptr);
+                assert(res == OK);
+            }
+            res = finalize_block(rl, &remap_block, &remap_hash);
+            assert(res == OK);
+            res = justify_block(rl, &remap_block);
+            assert(res == OK);
+            check_reads(rl);
+
+            // the second block is left for the reopen
+            res = rl.settle_versions(1);
+            assert(res == OK);
+            check_reads(rl);
+        });
+
+        // reopening settles what was left remapped
+        Ledger rl(remap_paths[1], CACHE_SIZE, MAP_SIZE, DST, SECRET);
+        assert(rl.open_status() == OK);
+        check_reads(rl);
+
+        Result<Node_ptr, int> root_res = rl.get_root(nullptr, 0);
+        assert(root_res.is_ok());
+        assert(root_res.unwrap()->get_id()->get_block_id() == 0);
+
+        // exported straight after a remap, the chunks
+        // still check out on a replica
+        rl.set_justify_mode(JUSTIFY_REMAP);
+
+        Hash remap_block;
+        seeded_hash(&remap_block, 1402);
+        for (i = 0; i < 8; i++) {
+            ByteSlice key(raw_hashes[i].h, 32);
+
+            Hash vh;
+            derive_hash(vh.h, key);
+
+            res = rl.put(key, &vh, idx, &remap_block, nullptr);
+            assert(res == OK);
+        }
+        res = finalize_block(rl, &remap_block, &remap_root);
+        assert(res == OK);
+        res = justify_block(rl, &remap_block);
+        assert(res == OK);
+
+        std::unique_ptr<ChunkExporter> remap_exporter;
+        res = rl.export_chunks(remap_exporter, 1);
+        assert(res == OK);
+
+        std::vector<std::vector<byte>> remap_chunks;
+        while ((res = remap_exporter->next(chunk)) == OK) remap_chunks.push_back(chunk);
+        assert(res == ITER_END);
+        remap_exporter.reset();
+
+        const char* remap_sync_path = "./fake_db_remap_sync";
+        run_fresh(remap_sync_path, [&](Ledger &replica) {
+            std::vector<ByteSlice> slices;
+            for (auto &c: remap_chunks) slices.emplace_back(c.data(), c.size());
+
+            res = replica.import_chunks(slices, &remap_root);
+            assert(res == OK);
+
+            for (Hash raw: raw_hashes) {
+                ByteSlice key(raw.h, 32);
+                Hash kh;
+                derive_hash(kh.h, key);
+
+                res = replica.get(key, idx, &got);
+                assert(res == OK);
+                assert(std::memcmp(got.h, kh.h, 32) == 0);
+            }
+        });
+        fs::remove_all(remap_sync_path);
+    }
+    for (auto &remap_path: remap_paths) fs::remove_all(remap_path);
+
+    printf("SUCCESSFUL REMAP \n");
+
+
+
+    ////////////////////////////
+    // --- ENCODING phase --- //
+    //////////////////////////
+    const std::string* tag = &gadgets->settings.tag;
+    Commitment legacy_commit = *blst_p1_generator();
+
+    blst_scalar legacy_sk;
+    hash_p1_to_scalar(&legacy_commit, &legacy_sk, tag);
+
+    Hash legacy_path;
+    seeded_hash(&legacy_path, 3001);
+    legacy_path.h[31] = 0;
+    NodeId legacy_id{&legacy_path, 1, 0};
+
+    Hash legacy_val;
+    seeded_hash(&legacy_val, 3002);
+
+    // a leaf as written before v2, compressed commitment 
+    // then path, count and (nib, hash, block id) slots
+    std::vector<byte> leaf_v1{LEAF};
+    leaf_v1.resize(1 + COMPRESSED_SIZE);
+    blst_p1_compress(leaf_v1.data() + 1, &legacy_commit);
+    leaf_v1.insert(leaf_v1.end(), legacy_path.h, legacy_path.h + 32);
+    leaf_v1.push_back(2);
+    leaf_v1.push_back(2);
+    for (auto [nib, val]: {std::pair{0, &legacy_path}, std::pair{int(idx), &legacy_val}}) {
+        leaf_v1.push_back(nib);
+        leaf_v1.insert(leaf_v1.end(), val->h, val->h + 32);
+        leaf_v1.insert(leaf_v1.end(), 2, 0);
+    }
+
+    ByteSlice leaf_v1_slice(leaf_v1.data(), leaf_v1.size());
+    Ref<Leaf> legacy_leaf = create_leaf(gadgets, &legacy_id, &leaf_v1_slice);
+
+    // never written back
+    legacy_leaf->synced_ = true;
+
+    // the commitment is decoded once however many read it
+    std::vector<blst_scalar> legacy_sks(8);
+    {
+        TaskGroup reads(gadgets->pool);
+        for (auto &sk: legacy_sks) 
+            reads.spawn([&legacy_leaf, &sk] { 
+                legacy_leaf->get_commitment();
+                sk = *legacy_leaf->get_scalar(); 
+            });
+    }
+    for (auto &sk: legacy_sks) 
+        assert(std::memcmp(sk.b, legacy_sk.b, sizeof(sk.b)) == 0);
+    assert(blst_p1_is_equal(legacy_leaf->get_commitment(), &legacy_commit));
+
+    std::vector<byte> leaf_v2 = legacy_leaf->to_bytes();
+    assert(leaf_v2.size() == legacy_leaf->encoded_size());
+    assert(leaf_v2[0] == LEAF_V2);
+    assert(std::equal(
+        leaf_v2.begin() + 1 + COMMIT_V2_SIZE, leaf_v2.end(), 
+        leaf_v1.begin() + 1 + COMPRESSED_SIZE, leaf_v1.end()
+    ));
+
+    ByteSlice leaf_v2_slice(leaf_v2.data(), leaf_v2.size());
+    Ref<Leaf> upgraded_leaf = create_leaf(gadgets, &legacy_id, &leaf_v2_slice);
+    upgraded_leaf->synced_ = true;
+    assert(blst_p1_is_equal(upgraded_leaf->get_commitment(), &legacy_commit));
+    assert(std::memcmp(upgraded_leaf->get_scalar()->b, legacy_sk.b, 32) == 0);
+    assert(upgraded_leaf->to_bytes() == leaf_v2);
+
+    // a branch as the baseline wrote it, the type, split flag, 
+    // compressed commitment (the G1 generator) and child count, 
+    // then anchor, end, scalar and block id per child
+    std::vector<byte> branch_v1{
+        BRANCH, 0x00,
+        0x97, 0xf1, 0xd3, 0xa7, 0x31, 0x97, 0xd7, 0x94, 0x26, 0x95, 0x63, 0x8c, 0x4f, 0xa9, 0xac, 0x0f,
+        0xc3, 0x68, 0x8c, 0x4f, 0x97, 0x74, 0xb9, 0x05, 0xa1, 0x4e, 0x3a, 0x3f, 0x17, 0x1b, 0xac, 0x58,
+        0x6c, 0x55, 0xe8, 0x3f, 0xf9, 0x7a, 0x1a, 0xef, 0xfb, 0x3a, 0xf0, 0x0a, 0xdb, 0x22, 0xc6, 0xbb,
+        0x03,
+        0x05, 0x05,
+        0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x00,
+        0x00, 0x00,
+        0x40, 0x40,
+        0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22,
+        0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x00,
+        0x03, 0x00,
+        0xf1, 0xf1,
+        0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33,
+        0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x00,
+        0x00, 0x00,
+    };
+
+    const size_t V1_ENTRIES_AT = 2 + COMPRESSED_SIZE;
+    const size_t V2_ENTRIES_AT = 2 + COMMIT_V2_SIZE + 1;
+    const size_t ENTRIES_SIZE = branch_v1.size() - V1_ENTRIES_AT;
+
+    ByteSlice branch_v1_slice(branch_v1.data(), branch_v1.size());
+    Ref<Branch> legacy_branch = create_branch(gadgets, &legacy_id, &branch_v1_slice);
+    legacy_branch->synced_ = true;
+    assert(blst_p1_is_equal(legacy_branch->get_commitment(), &legacy_commit));
+
+    for (byte anchor: {0x05, 0x40, 0xf1}) {
+        Child* child = legacy_branch->get_child(anchor);
+        assert(child && child->anchor == anchor && child->end == anchor);
+        assert(child->blk_id == (anchor == 0x40 ? 3 : 0));
+    }
+    assert(!legacy_branch->get_child(0x06));
+
+    // what follows the commitment and extension is the same 
+    // count and children bytes, with their weights after them
+    std::vector<byte> branch_v2 = legacy_branch->to_bytes();
+    assert(branch_v2.size() == legacy_branch->encoded_size());
+    assert(branch_v2[0] == BRANCH_V2);
+    assert(branch_v2[2 + COMMIT_V2_SIZE] == 0);
+    assert(std::equal(
+        branch_v1.begin() + V1_ENTRIES_AT, branch_v1.end(),
+        branch_v2.begin() + V2_ENTRIES_AT
+    ));
+    assert(std::all_of(
+        branch_v2.begin() + V2_ENTRIES_AT + ENTRIES_SIZE, branch_v2.end(),
+        [](byte b) { return b == 0; }
+    ));
+
+    ByteSlice branch_v2_slice(branch_v2.data(), branch_v2.size());
+    Ref<Branch> upgraded_branch = create_branch(gadgets, &legacy_id, &branch_v2_slice);
+    upgraded_branch->synced_ = true;
+    assert(upgraded_branch->to_bytes() == branch_v2);
+
+    printf("SUCCESSFUL ENCODING \n");
+
+
+
+    ////////////////////////
+    // --- POOL phase --- //
+    //////////////////////
+    // tasks wait on groups of their own, with
+    // no workers everything runs inline
+    for (size_t threads: {size_t(0), size_t(4)}) {
+        std::vector<uint64_t> sums(16);
+        {
+            ThreadPool pool(threads);
+            TaskGroup outer(pool);
+            for (size_t t{}; t < sums.size(); t++) {
+                outer.spawn([&pool, &sums, t] {
+                    std::vector<uint64_t> parts(32);
+                    TaskGroup inner(pool);
+                    for (size_t k{}; k < parts.size(); k++) 
+                        inner.spawn([&parts, t, k] { parts[k] = t * k; });
+                    inner.wait();
+
+                    sums[t] = std::accumulate(parts.begin(), parts.end(), uint64_t{});
+                });
+            }
+            outer.wait();
+
+            // outer goes first, then the pool joins its idle workers
+        }
+        for (size_t t{}; t < sums.size(); t++) 
+            assert(sums[t] == t * (31 * 32 / 2));
+    }
+
+    printf("SUCCESSFUL POOL \n");
+
+
+
+    ////////////////////////
+    // --- LEAF phase --- //
+    //////////////////////
+    // an account spilling past the leaf's inline slots and 
+    // back under them commits as if it never had
+    ByteSlice leaf_key{raw_hashes[7].h, 32};
+    Hash leaf_stem;
+    derive_hash(leaf_stem.h, leaf_key);
+
+    std::vector<Hash> slot_vals(LEAF_INLINE_SLOTS + 4);
+    for (i = 0; i < slot_vals.size(); i++) seeded_hash(&slot_vals[i], 3100 + i);
+    auto slot_of = [](size_t k) { return uint8_t(10 + k); };
+
+    // kept past the removes
+    size_t kept_from = LEAF_INLINE_SLOTS;
+
+    auto prove_slot = [&](Ledger &pl, size_t k) -> int {
+        Hash slot_key = leaf_stem;
+        slot_key.h[31] = slot_of(k);
+
+        std::vector<Commitment> slot_Cs;
+        std::vector<Proof> slot_Pis;
+        ProofShape slot_shape{};
+        int rc = generate_proof(pl, slot_Cs, slot_Pis, &slot_shape, &slot_key);
+        if (rc != OK) return rc;
+
+        assert(valid_proof(
+            pl, &slot_Cs, &slot_Pis, &slot_shape, 
+            &slot_key, &slot_vals[k], slot_of(k)
+        ));
+        return OK;
+    };
+
+    const std::vector<std::string> leaf_paths{"./fake_db_leaf", "./fake_db_leaf_ref"};
+    same_root_runs(leaf_paths, [&](Ledger &ll, size_t m, Hash &leaf_root) {
+        Hash leaf_block;
+        if (m == 1) {
+            seeded_hash(&leaf_block, 3003);
+            res = ll.create_account(leaf_key, &leaf_block);
+            assert(res == OK);
+            for (i = kept_from; i < slot_vals.size(); i++) {
+                res = ll.put(leaf_key, &slot_vals[i], slot_of(i), &leaf_block);
+                assert(res == OK);
+            }
+            res = finalize_block(ll, &leaf_block, &leaf_root);
+            assert(res == OK);
+            return;
+        }
+
+        seeded_hash(&leaf_block, 3001);
+        res = ll.create_account(leaf_key, &leaf_block);
+        assert(res == OK);
+        for (i = 0; i < slot_vals.size(); i++) {
+            res = ll.put(leaf_key, &slot_vals[i], slot_of(i), &leaf_block);
+            assert(res == OK);
+        }
+        res = finalize_block(ll, &leaf_block, &leaf_root);
+        assert(res == OK);
+        res = justify_block(ll, &leaf_block);
+        assert(res == OK);
+
+        for (i = 0; i < slot_vals.size(); i++) {
+            res = prove_slot(ll, i);
+            assert(res == OK);
+        }
+
+        seeded_hash(&leaf_block, 3002);
+        for (i = 0; i < kept_from; i++) {
+            res = ll.remove(leaf_key, slot_of(i), &leaf_block);
+            assert(res == OK);
+        }
+        res = finalize_block(ll, &leaf_block, &leaf_root);
+        assert(res == OK);
+        res = justify_block(ll, &leaf_block);
+        assert(res == OK);
+
+        for (i = 0; i < slot_vals.size(); i++) {
+            res = prove_slot(ll, i);
+            assert(res == (i < kept_from ? NOT_EXIST : OK));
+        }
+    });
+    for (auto &leaf_path: leaf_paths) fs::remove_all(leaf_path);
+
+    printf("SUCCESSFUL LEAF \n");
+
+
+
+    ////////////////////////
+    // --- VIEW phase --- //
+    //////////////////////
+    // proofs read off the pages match proofs from loaded nodes
+    const char* view_path = "./fake_db_view";
+
+    const size_t VIEW_KEYS = 16;
+    std::vector<Hash> view_keys(VIEW_KEYS);
+    std::vector<Hash> view_vals(VIEW_KEYS);
+    std::vector<std::vector<byte>> loaded_proofs(VIEW_KEYS);
+
+    auto prove_encoded = [&](Ledger &pl, size_t k, std::vector<byte> &out) -> int {
+        std::vector<Commitment> view_Cs;
+        std::vector<Proof> view_Pis;
+        ProofShape view_shape{};
+        int rc = generate_proof(pl, view_Cs, view_Pis, &view_shape, &view_keys[k]);
+        if (rc != OK) return rc;
+
+        assert(valid_proof(
+            pl, &view_Cs, &view_Pis, &view_shape, 
+            &view_keys[k], &view_vals[k], idx
+        ));
+        out = encode_proof(view_Cs, view_Pis, &view_shape);
+        return OK;
+    };
+
+    run_fresh(view_path, [&](Ledger &vl) {
+        Hash view_block;
+        seeded_hash(&view_block, 3201);
+        for (i = 0; i < VIEW_KEYS; i++) {
+            ByteSlice key(raw_hashes[i].h, 32);
+            seeded_hash(&view_vals[i], 3300 + i);
+
+            derive_hash(view_keys[i].h, key);
+            view_keys[i].h[31] = idx;
+
+            res = vl.create_account(key, &view_block);
+            assert(res == OK);
+            res = vl.put(key, &view_vals[i], idx, &view_block);
+            assert(res == OK);
+        }
+        Hash view_root;
+        res = finalize_block(vl, &view_block, &view_root);
+        assert(res == OK);
+        res = justify_block(vl, &view_block);
+        assert(res == OK);
+
+        // a replace that can't apply still loads the key's path
+        Hash probe_block;
+        seeded_hash(&probe_block, 3202);
+        for (i = 0; i < VIEW_KEYS; i++) {
+            ByteSlice key(raw_hashes[i].h, 32);
+            res = vl.replace(key, &base, &base, idx, &probe_block);
+            assert(res == INVALID_PREV_VAL_HASH);
+
+            res = prove_encoded(vl, i, loaded_proofs[i]);
+            assert(res == OK);
+        }
+        res = prune_block(vl, &probe_block);
+        assert(res == OK);
+    });
+    {
+        // nothing under the root is cached when reopened
+        Ledger vl(view_path, CACHE_SIZE, MAP_SIZE, DST, SECRET);
+
+        std::vector<byte> viewed;
+        for (i = 0; i < VIEW_KEYS; i++) {
+            res = prove_encoded(vl, i, viewed);
+            assert(res == OK);
+            assert(viewed == loaded_proofs[i]);
+        }
+    }
+    fs::remove_all(view_path);
+
+    printf("SUCCESSFUL VIEW \n");
+
+
+
+    ///////////////////////////
+    // --- RESERVE phase --- //
+    /////////////////////////
+    // nodes encoded straight into the reserved page 
+    // read back as what to_bytes gives
+    Result<Node_ptr, int> reserve_res = l.get_root(nullptr, 0);
+    assert(reserve_res.is_ok());
+    std::vector<Node_ptr> reserved{reserve_res.unwrap()};
+
+    for (size_t nib{}; nib < BRANCH_ORDER && reserved.size() < 4; nib++) {
+        const NodeId* child_id = reserved[0]->get_next_id(nib);
+        if (!child_id) continue;
+
+        Result<Node_ptr, int> child_res = gadgets->alloc.load_node(child_id);
+        assert(child_res.is_ok());
+        reserved.push_back(child_res.unwrap());
+    }
+    assert(reserved.size() > 1);
+
+    res = gadgets->alloc.write_nodes(reserved);
+    assert(res == OK);
+
+    BulletDB &reserve_db = gadgets->alloc.db_;
+    for (auto &node: reserved) {
+        std::vector<byte> expected = node->to_bytes();
+        assert(expected.size() == node->encoded_size());
+
+        const void* stored = nullptr;
+        size_t stored_size = 0;
+        void* trx = reserve_db.start_rd_txn();
+        res = reserve_db.get_view(
+            node->get_id()->get_full(), node->get_id()->size(), 
+            &stored, &stored_size, trx
+        );
+        assert(res == OK);
+        assert(stored_size == expected.size());
+        assert(std::memcmp(stored, expected.data(), stored_size) == 0);
+        reserve_db.end_txn(trx, res);
+    }
+
+    printf("SUCCESSFUL RESERVE \n");
+
+
+
+    ////////////////////////////
+    // --- FORK JOIN phase --- //
+    //////////////////////////
+    // keys picked to put FORK_LEAVES accounts under each of two root
+    // children, enough for either to fork. one key a block never 
+    // forks, all in one block does, and both come to the same root
+    const std::vector<std::string> fork_paths{"./fake_db_serial", "./fake_db_fork"};
+    const size_t FORK_LEAVES = 16;
+    std::vector<Hash> fork_keys;
+    size_t fork_under[2]{};
+    for (int seed = 5000; fork_under[0] < FORK_LEAVES || fork_under[1] < FORK_LEAVES; seed++) {
+        Hash raw, kh;
+        seeded_hash(&raw, seed);
+        derive_hash(kh.h, ByteSlice(raw.h, 32));
+
+        if (kh.h[0] > 1 || fork_under[kh.h[0]] == FORK_LEAVES) continue;
+        fork_under[kh.h[0]]++;
+        fork_keys.push_back(raw);
+    }
+    const size_t FORK_KEYS = fork_keys.size();
+
+    same_root_runs(fork_paths, [&](Ledger &fl, size_t m, Hash &fork_root) {
+        bool serial = m == 0;
+
+        Hash fork_block;
+        seeded_hash(&fork_block, 3400);
+        for (i = 0; i < FORK_KEYS; i++) {
+            ByteSlice key(fork_keys[i].h, 32);
+            if (serial) seeded_hash(&fork_block, 3400 + i);
+
+            res = fl.create_account(key, &fork_block);
+            assert(res == OK);
+            res = fl.put(key, &fork_keys[i], idx, &fork_block);
+            assert(res == OK);
+
+            if (!serial && i + 1 < FORK_KEYS) continue;
+
+            res = finalize_block(fl, &fork_block, &fork_root, FINALIZE_FORK_JOIN);
+            assert(res == OK);
+            res = justify_block(fl, &fork_block);
+            assert(res == OK);
+        }
+    });
+    for (auto &fork_path: fork_paths) fs::remove_all(fork_path);
+
+    printf("SUCCESSFUL FORK JOIN \n");
+
+
+
+    /////////////////////////
+    // --- DIRTY phase --- //
+    ///////////////////////
+    // each block records only the versions it made, and 
+    // finalizing from them matches the fork-join walk
+    std::vector<Hash> dirty_blocks(2);
+    std::vector<uint16_t> dirty_ids(2);
+    std::vector<std::vector<NodeId>> dirty_sets(2);
+    std::vector<Hash> dirty_roots(2);
+
+    for (size_t m{}; m < dirty_blocks.size(); m++) {
+        seeded_hash(&dirty_blocks[m], 3500 + m);
+
+        res = l.put(first_key, &raw_hashes[m], idx, &dirty_blocks[m]);
+        assert(res == OK);
+
+        dirty_ids[m] = l.get_block_id(&dirty_blocks[m], false);
+        assert(dirty_ids[m] != 0);
+        bool recorded = gadgets->alloc.dirty_nodes(dirty_ids[m], dirty_sets[m]);
+        assert(recorded);
+    }
+
+    // the same path, root to leaf, under each block's own id
+    assert(dirty_sets[0].size() == dirty_sets[1].size());
+    assert(dirty_sets[0].size() > 1);
+    for (size_t m{}; m < dirty_sets.size(); m++) {
+        bool has_root = false;
+        for (auto &id: dirty_sets[m]) {
+            assert(id.get_block_id() == dirty_ids[m]);
+            has_root |= id.get_level() == 0;
+        }
+        assert(has_root);
+    }
+
+    // same value in a third block, finalized by walking the trie
+    Hash dirty_walked;
+    seeded_hash(&dirty_walked, 3502);
+    res = l.put(first_key, &raw_hashes[0], idx, &dirty_walked);
+    assert(res == OK);
+
+    Hash walked_root;
+    res = finalize_block(l, &dirty_walked, &walked_root, FINALIZE_FORK_JOIN);
+    assert(res == OK);
+
+    for (size_t m{}; m < dirty_blocks.size(); m++) {
+        res = finalize_block(l, &dirty_blocks[m], &dirty_roots[m], FINALIZE_LEVELS);
+        assert(res == OK);
+    }
+    assert(std::memcmp(dirty_roots[0].h, walked_root.h, 32) == 0);
+    assert(std::memcmp(dirty_roots[0].h, dirty_roots[1].h, 32) != 0);
+
+    // pruning drops the set with the block
+    for (size_t m{}; m < dirty_blocks.size(); m++) {
+        res = prune_block(l, &dirty_blocks[m]);
+        assert(res == OK);
+
+        std::vector<NodeId> pruned_set;
+        bool recorded = gadgets->alloc.dirty_nodes(dirty_ids[m], pruned_set);
+        assert(!recorded);
+    }
+    res = prune_block(l, &dirty_walked);
+    assert(res == OK);
+
+    printf("SUCCESSFUL DIRTY \n");
+
+
+
+    // --- ALLOC phase --- //
+    std::vector<SlabStats> stats = l.get_gadgets()->alloc.alloc_stats();
+    assert(!stats.empty());
+
+    for (auto &s: stats) {
+        assert(s.slabs > 0);
+        assert(s.in_use <= s.capacity);
+    }
+
+    // churns far more leaves than their partition holds through the
+    // cache, the evicted ones have to hand their slots back
+    const size_t CHURN_ROUNDS = 4;
+    const size_t CHURN_LEAVES = 4096;
+    // no block gets an id this high
+    const uint16_t CHURN_BLOCK = 0xFFFF;
+
+    SlabClass* leaf_class = gadgets->alloc.slabs_.class_for(sizeof(Leaf));
+    assert(leaf_class);
+
+    std::vector<NodeId> churn_ids;
+    for (size_t k{}; k < CHURN_LEAVES; k++) {
+        Hash churn_key;
+        seeded_hash(&churn_key, 9000 + k);
+        // all under one root child so they share a partition
+        churn_key.h[0] = 0xEE;
+        churn_ids.emplace_back(&churn_key, ID_PATH_SIZE, CHURN_BLOCK);
+    }
+
+    SlabStats churn_base = leaf_class->stats();
+    std::vector<SlabStats> churned;
+    for (size_t r{}; r < CHURN_ROUNDS; r++) {
+        for (auto &id: churn_ids) {
+            Ref<Leaf> leaf = gadgets->alloc.make_node<Leaf>(gadgets, &id, nullptr);
+            // nothing to write back when it's evicted
+            leaf->synced_ = true;
+            gadgets->alloc.cache_insert(leaf);
+        }
+
+        // only what the partition still caches is held
+        SlabStats s = leaf_class->stats();
+        assert(s.in_use < churn_base.in_use + CHURN_LEAVES / 2);
+        churned.push_back(s);
+
+        for (auto &id: churn_ids) gadgets->alloc.evict_node(&id);
+        assert(leaf_class->stats().in_use <= churn_base.in_use);
+    }
+
+    // the first round carves what the rest reuse
+    for (size_t r = 1; r < CHURN_ROUNDS; r++) {
+        assert(churned[r].slabs == churned[0].slabs);
+        assert(churned[r].recycled > churned[r - 1].recycled);
+    }
+
+    printf("SUCCESSFUL ALLOC STATS \n");
+
+
 
     fs::remove_all("./fake_db");
 
@@ -43,6 +43,7 @@ impl Blockchain {
             &config.ledger_path, 
             config.ledger_cache_size,
             config.ledger_map_size,
+            config.ledger_threads,
             &config.ledger_tag,
             Some(random_b32())
         )?;
@@ -27,12 +27,32 @@ pub struct Hash {
     // Replace with the real definition if different
     pub h: [u8; 32],
 }
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct ShardVote {
+    // must match state_types.h
+    pub first: u8,
+    pub last: u8,
+    pub hash: Hash,
+}
+#[repr(C)]
+#[derive(Copy, Clone, Debug, Default)]
+pub struct SlabStats {
+    // must match slab.h
+    pub slot_size: usize,
+    pub slabs: usize,
+    pub capacity: usize,
+    pub in_use: usize,
+    pub recycled: usize,
+}
+
 unsafe extern "C" {
     pub fn ledger_open(
         out: *mut *mut c_void,
         path: *const c_char,
         cache_size: usize,
         map_size: usize,
+        threads: usize,
         tag: *const c_char,
         secret: *mut c_uchar,
         secret_size: usize,
@@ -50,6 +70,29 @@ unsafe extern "C" {
         setup_size: usize,
     ) -> c_int;
 
+    pub fn ledger_alloc_stats(
+        ledger: *mut c_void,
+        out: *mut SlabStats,
+        cap: usize,
+        count: *mut usize,
+    ) -> c_int;
+
+    pub fn ledger_set_split_weight(
+        ledger: *mut c_void,
+        leaves: u32,
+        bytes: u64,
+    ) -> c_int;
+
+    pub fn ledger_set_justify_mode(ledger: *mut c_void, mode: u8) -> c_int;
+
+    pub fn ledger_settle_versions(ledger: *mut c_void, max_blocks: usize) -> c_int;
+
+    pub fn ledger_set_shards(
+        ledger: *mut c_void,
+        ranges: *const u8,
+        count: usize,
+    ) -> c_int;
+
     pub fn ledger_create_account(
         ledger: *mut c_void,
         key: *const c_uchar,
@@ -96,6 +139,115 @@ unsafe extern "C" {
         prev_block_hash: *const Hash,
     ) -> c_int;
 
+    pub fn ledger_apply_ops(
+        ledger: *mut c_void,
+        ops: *const c_uchar,
+        ops_size: usize,
+        block_hash: *const Hash,
+        prev_block_hash: *const Hash,
+        statuses: *mut c_int,
+        statuses_len: usize,
+    ) -> c_int;
+
+    pub fn ledger_get(
+        ledger: *mut c_void,
+        key: *const c_uchar,
+        key_size: usize,
+        val_idx: u8,
+        block_hash: *const Hash,
+        out: *mut Hash,
+    ) -> c_int;
+
+    pub fn ledger_snapshot_open(
+        ledger: *mut c_void,
+        block_hash: *const Hash,
+        out: *mut *mut c_void,
+    ) -> c_int;
+
+    pub fn ledger_snapshot_get(
+        snapshot: *mut c_void,
+        key: *const c_uchar,
+        key_size: usize,
+        val_idx: u8,
+        out: *mut Hash,
+    ) -> c_int;
+
+    pub fn ledger_multi_get(
+        ledger: *mut c_void,
+        keys: *const *const c_uchar,
+        key_sizes: *const usize,
+        val_idxs: *const u8,
+        count: usize,
+        block_hash: *const Hash,
+        outs: *mut Hash,
+        results: *mut c_int,
+    ) -> c_int;
+
+    pub fn ledger_snapshot_multi_get(
+        snapshot: *mut c_void,
+        keys: *const *const c_uchar,
+        key_sizes: *const usize,
+        val_idxs: *const u8,
+        count: usize,
+        outs: *mut Hash,
+        results: *mut c_int,
+    ) -> c_int;
+
+    pub fn ledger_snapshot_close(snapshot: *mut c_void);
+
+    pub fn ledger_iter_open(
+        ledger: *mut c_void,
+        prefix: *const c_uchar,
+        prefix_size: usize,
+        block_hash: *const Hash,
+        out: *mut *mut c_void,
+    ) -> c_int;
+
+    pub fn ledger_iter_next(
+        iter: *mut c_void,
+        key_hash: *mut Hash,
+        slot: *mut u8,
+        val_hash: *mut Hash,
+    ) -> c_int;
+
+    pub fn ledger_iter_close(iter: *mut c_void);
+
+    pub fn ledger_export_open(
+        ledger: *mut c_void,
+        depth: u8,
+        out: *mut *mut c_void,
+    ) -> c_int;
+
+    pub fn ledger_export_next(
+        exporter: *mut c_void,
+        out: *mut *mut c_void,
+        out_size: *mut usize,
+    ) -> c_int;
+
+    pub fn ledger_export_close(exporter: *mut c_void);
+
+    pub fn ledger_import_chunks(
+        ledger: *mut c_void,
+        chunks: *const *const c_uchar,
+        chunk_sizes: *const usize,
+        count: usize,
+        root_hash: *const Hash,
+    ) -> c_int;
+
+    pub fn ledger_bulk_begin(ledger: *mut c_void, out: *mut *mut c_void) -> c_int;
+
+    pub fn ledger_bulk_add(
+        loader: *mut c_void,
+        key_hashes: *const Hash,
+        slots: *const u8,
+        val_hashes: *const Hash,
+        count: usize,
+    ) -> c_int;
+
+    pub fn ledger_bulk_finish(loader: *mut c_void, root_hash: *mut Hash) -> c_int;
+
+    pub fn ledger_bulk_close(loader: *mut c_void);
+
     pub fn ledger_finalize(
         ledger: *mut c_void,
         block_hash: *const Hash,
@@ -103,6 +255,30 @@ unsafe extern "C" {
         out_size: *mut usize,
     ) -> c_int;
 
+    pub fn ledger_finalize_shards(
+        ledger: *mut c_void,
+        block_hash: *const Hash,
+        out: *mut ShardVote,
+        cap: usize,
+        count: *mut usize,
+        root_hash: *mut Hash,
+    ) -> c_int;
+
+    pub fn ledger_insert_shard_hash(
+        ledger: *mut c_void,
+        block_hash: *const Hash,
+        vote: *const ShardVote,
+        root_hash: *mut Hash,
+    ) -> c_int;
+
+    pub fn ledger_missing_shards(
+        ledger: *mut c_void,
+        block_hash: *const Hash,
+        out: *mut u8,
+        cap: usize,
+        count: *mut usize,
+    ) -> c_int;
+
     pub fn ledger_prune(
         ledger: *mut c_void,
         block_hash: *const Hash,
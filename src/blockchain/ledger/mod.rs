@@ -17,7 +17,7 @@
  */
 
 
-use std::ffi::{CString, c_void};
+use std::ffi::{CString, c_int, c_uchar, c_void};
 use std::ptr::NonNull;
 use nix::libc;
 
@@ -26,11 +26,327 @@ use crate::utils::errors::InternalError;
 
 mod ffi;
 
+// must match ops.cpp
+const OPS_VERSION: u8 = 1;
+const ZERO_HASH: [u8; 32] = [0u8; 32];
+
+// must match LedgerCodes in state_types.h
+const NOT_EXIST: c_int = 1;
+const ITER_END: c_int = 23;
+const SHARDS_PENDING: c_int = 26;
+
+// a root splits into at most this many ranges
+const MAX_SHARDS: usize = 255;
+
+#[repr(u8)]
+#[derive(Copy, Clone, Debug)]
+pub enum OpCode {
+    Put = 0,
+    Replace = 1,
+    Remove = 2,
+    CreateAccount = 3,
+    DeleteAccount = 4,
+}
+
+/// How justify makes a block's versions cannonical, see `Ledger::set_justify_mode`.
+#[repr(u8)]
+#[derive(Copy, Clone, Debug)]
+pub enum JustifyMode {
+    Copy = 0,
+    Remap = 1,
+}
+
+/// A block's ops packed for `Ledger::apply_ops`.
+pub struct OpsBuffer {
+    buf: Vec<u8>,
+    count: u32,
+}
+
+impl OpsBuffer {
+    pub fn new() -> Self {
+        let mut buf = Vec::with_capacity(1024);
+        buf.push(OPS_VERSION);
+        buf.extend_from_slice(&0u32.to_le_bytes());
+        Self { buf, count: 0 }
+    }
+
+    pub fn len(&self) -> usize { self.count as usize }
+
+    fn push(
+        &mut self,
+        op: OpCode,
+        key: &[u8],
+        val_idx: u8,
+        value_hash: &[u8; 32],
+        prev_value_hash: &[u8; 32],
+    ) {
+        let key_size = u16::try_from(key.len()).expect("key too long");
+
+        self.buf.push(op as u8);
+        self.buf.push(val_idx);
+        self.buf.extend_from_slice(&key_size.to_le_bytes());
+        self.buf.extend_from_slice(key);
+        self.buf.extend_from_slice(value_hash);
+        self.buf.extend_from_slice(prev_value_hash);
+
+        self.count += 1;
+        self.buf[1..5].copy_from_slice(&self.count.to_le_bytes());
+    }
+
+    pub fn put(&mut self, key: &[u8], value_hash: &Hash, val_idx: u8) {
+        self.push(OpCode::Put, key, val_idx, &value_hash.h, &ZERO_HASH);
+    }
+
+    pub fn replace(
+        &mut self,
+        key: &[u8],
+        value_hash: &Hash,
+        prev_value_hash: &Hash,
+        val_idx: u8,
+    ) {
+        self.push(OpCode::Replace, key, val_idx, &value_hash.h, &prev_value_hash.h);
+    }
+
+    pub fn remove(&mut self, key: &[u8], val_idx: u8) {
+        self.push(OpCode::Remove, key, val_idx, &ZERO_HASH, &ZERO_HASH);
+    }
+
+    pub fn create_account(&mut self, key: &[u8]) {
+        self.push(OpCode::CreateAccount, key, 0, &ZERO_HASH, &ZERO_HASH);
+    }
+
+    pub fn delete_account(&mut self, key: &[u8]) {
+        self.push(OpCode::DeleteAccount, key, 0, &ZERO_HASH, &ZERO_HASH);
+    }
+}
+
 #[derive(Debug)]
 pub struct Ledger {
     inner: NonNull<c_void>,
 }
 
+/// A pinned, read only view of one block's state, see `Ledger::snapshot`.
+/// Reads on one snapshot take turns, give each reader thread its own.
+#[derive(Debug)]
+pub struct Snapshot {
+    inner: NonNull<c_void>,
+}
+
+// the read txn behind it isn't tied to the thread that opened it
+unsafe impl Send for Snapshot {}
+
+impl Snapshot {
+    /// The value hash at `key`/`val_idx`, `None` if there isn't one.
+    pub fn get(&self, key: &[u8], val_idx: u8) -> Result<Option<Hash>> {
+        let mut out = Hash { h: ZERO_HASH };
+        let rc = unsafe {
+            ledger_snapshot_get(
+                self.inner.as_ptr(),
+                key.as_ptr(), key.len(),
+                val_idx,
+                &mut out,
+            )
+        };
+
+        match rc {
+            0 => Ok(Some(out)),
+            NOT_EXIST => Ok(None),
+            _ => Err(InternalError::Ledger(rc)),
+        }
+    }
+
+    /// `get` for every `(key, val_idx)` pair, lookups interleaved.
+    pub fn multi_get(&self, keys: &[(&[u8], u8)]) -> Result<Vec<Option<Hash>>> {
+        let (ptrs, sizes, idxs) = split_keys(keys);
+        let mut outs = vec![Hash { h: ZERO_HASH }; keys.len()];
+        let mut results: Vec<c_int> = vec![0; keys.len()];
+
+        let rc = unsafe {
+            ledger_snapshot_multi_get(
+                self.inner.as_ptr(),
+                ptrs.as_ptr(), sizes.as_ptr(), idxs.as_ptr(),
+                keys.len(),
+                outs.as_mut_ptr(),
+                results.as_mut_ptr(),
+            )
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        collect_gets(outs, results)
+    }
+}
+
+fn split_keys(keys: &[(&[u8], u8)]) -> (Vec<*const c_uchar>, Vec<usize>, Vec<u8>) {
+    let ptrs = keys.iter().map(|(k, _)| k.as_ptr()).collect();
+    let sizes = keys.iter().map(|(k, _)| k.len()).collect();
+    let idxs = keys.iter().map(|(_, i)| *i).collect();
+    (ptrs, sizes, idxs)
+}
+
+fn collect_gets(outs: Vec<Hash>, results: Vec<c_int>) -> Result<Vec<Option<Hash>>> {
+    outs.into_iter()
+        .zip(results)
+        .map(|(out, rc)| match rc {
+            0 => Ok(Some(out)),
+            NOT_EXIST => Ok(None),
+            _ => Err(InternalError::Ledger(rc)),
+        })
+        .collect()
+}
+
+impl Drop for Snapshot {
+    fn drop(&mut self) {
+        unsafe { ledger_snapshot_close(self.inner.as_ptr()) }
+    }
+}
+
+/// `(key hash, slot, value hash)` under a key hash prefix, in key order.
+#[derive(Debug)]
+pub struct RangeIter {
+    inner: NonNull<c_void>,
+    done: bool,
+}
+
+unsafe impl Send for RangeIter {}
+
+impl Iterator for RangeIter {
+    type Item = Result<(Hash, u8, Hash)>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.done {
+            return None;
+        }
+
+        let mut key_hash = Hash { h: ZERO_HASH };
+        let mut val_hash = Hash { h: ZERO_HASH };
+        let mut slot: u8 = 0;
+        let rc = unsafe {
+            ledger_iter_next(
+                self.inner.as_ptr(),
+                &mut key_hash,
+                &mut slot,
+                &mut val_hash,
+            )
+        };
+
+        match rc {
+            0 => Some(Ok((key_hash, slot, val_hash))),
+            ITER_END => {
+                self.done = true;
+                None
+            }
+            _ => {
+                self.done = true;
+                Some(Err(InternalError::Ledger(rc)))
+            }
+        }
+    }
+}
+
+impl Drop for RangeIter {
+    fn drop(&mut self) {
+        unsafe { ledger_iter_close(self.inner.as_ptr()) }
+    }
+}
+
+/// Self verifying chunks of the cannonical trie, for `Ledger::import_chunks`.
+#[derive(Debug)]
+pub struct ChunkExport {
+    inner: NonNull<c_void>,
+    done: bool,
+}
+
+unsafe impl Send for ChunkExport {}
+
+impl Iterator for ChunkExport {
+    type Item = Result<Vec<u8>>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.done {
+            return None;
+        }
+
+        let mut out: *mut c_void = std::ptr::null_mut();
+        let mut out_size: usize = 0;
+        let rc = unsafe {
+            ledger_export_next(self.inner.as_ptr(), &mut out, &mut out_size)
+        };
+
+        match rc {
+            0 => {
+                let bytes = unsafe {
+                    std::slice::from_raw_parts(out as *const u8, out_size)
+                }.to_vec();
+                unsafe { libc::free(out) };
+                Some(Ok(bytes))
+            }
+            ITER_END => {
+                self.done = true;
+                None
+            }
+            _ => {
+                self.done = true;
+                Some(Err(InternalError::Ledger(rc)))
+            }
+        }
+    }
+}
+
+/// Builds the cannonical trie of an empty ledger from a sorted stream.
+#[derive(Debug)]
+pub struct BulkLoader {
+    inner: NonNull<c_void>,
+}
+
+unsafe impl Send for BulkLoader {}
+
+impl BulkLoader {
+    /// Entries strictly increasing by key hash, then slot.
+    pub fn add(&mut self, entries: &[(Hash, u8, Hash)]) -> Result<()> {
+        let keys: Vec<Hash> = entries.iter().map(|e| e.0).collect();
+        let slots: Vec<u8> = entries.iter().map(|e| e.1).collect();
+        let vals: Vec<Hash> = entries.iter().map(|e| e.2).collect();
+
+        let rc = unsafe {
+            ledger_bulk_add(
+                self.inner.as_ptr(),
+                keys.as_ptr(), slots.as_ptr(), vals.as_ptr(),
+                entries.len(),
+            )
+        };
+
+        match rc {
+            0 => Ok(()),
+            _ => Err(InternalError::Ledger(rc)),
+        }
+    }
+
+    /// Writes what is left and returns the root hash.
+    pub fn finish(self) -> Result<Hash> {
+        let mut out = Hash { h: ZERO_HASH };
+        let rc = unsafe { ledger_bulk_finish(self.inner.as_ptr(), &mut out) };
+
+        match rc {
+            0 => Ok(out),
+            _ => Err(InternalError::Ledger(rc)),
+        }
+    }
+}
+
+impl Drop for BulkLoader {
+    fn drop(&mut self) {
+        unsafe { ledger_bulk_close(self.inner.as_ptr()) }
+    }
+}
+
+impl Drop for ChunkExport {
+    fn drop(&mut self) {
+        unsafe { ledger_export_close(self.inner.as_ptr()) }
+    }
+}
+
 type Result<T> = std::result::Result<T, InternalError>;
 
 impl Ledger {
@@ -38,6 +354,7 @@ impl Ledger {
         path: &str,
         cache_size: usize,
         map_size: usize,
+        threads: usize,
         tag: &str,
         secret: Option<[u8; 32]>,
     ) -> Result<Self> {
@@ -52,6 +369,7 @@ impl Ledger {
                 path.as_ptr(),
                 cache_size,
                 map_size,
+                threads,
                 tag.as_ptr(),
                 secret.map_or(std::ptr::null_mut(), |mut s| s.as_mut_ptr()),
                 secret.map_or(0, |s| s.len()),
@@ -115,6 +433,169 @@ impl Ledger {
         }
     }
 
+    /// Applies every op in one call, returning one status code per op.
+    pub fn apply_ops(
+        &self,
+        ops: &OpsBuffer,
+        block_hash: &Hash,
+        prev_block_hash: Option<&Hash>,
+    ) -> Result<Vec<i32>> {
+        let mut statuses = vec![0 as c_int; ops.len()];
+
+        let rc = unsafe {
+            ledger_apply_ops(
+                self.inner.as_ptr(),
+                ops.buf.as_ptr(), ops.buf.len(),
+                block_hash,
+                prev_block_hash.map_or(std::ptr::null(), |h| h),
+                statuses.as_mut_ptr(), statuses.len(),
+            )
+        };
+
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+        Ok(statuses)
+    }
+
+    /// The value hash at `key`/`val_idx`, `None` if there isn't one.
+    /// Reads the cannonical state unless `block_hash` is given.
+    pub fn get(
+        &self,
+        key: &[u8],
+        val_idx: u8,
+        block_hash: Option<&Hash>,
+    ) -> Result<Option<Hash>> {
+        let mut out = Hash { h: ZERO_HASH };
+        let rc = unsafe {
+            ledger_get(
+                self.inner.as_ptr(),
+                key.as_ptr(), key.len(),
+                val_idx,
+                block_hash.map_or(std::ptr::null(), |h| h),
+                &mut out,
+            )
+        };
+
+        match rc {
+            0 => Ok(Some(out)),
+            NOT_EXIST => Ok(None),
+            _ => Err(InternalError::Ledger(rc)),
+        }
+    }
+
+    /// `get` for every `(key, val_idx)` pair against one snapshot.
+    pub fn multi_get(
+        &self,
+        keys: &[(&[u8], u8)],
+        block_hash: Option<&Hash>,
+    ) -> Result<Vec<Option<Hash>>> {
+        let (ptrs, sizes, idxs) = split_keys(keys);
+        let mut outs = vec![Hash { h: ZERO_HASH }; keys.len()];
+        let mut results: Vec<c_int> = vec![0; keys.len()];
+
+        let rc = unsafe {
+            ledger_multi_get(
+                self.inner.as_ptr(),
+                ptrs.as_ptr(), sizes.as_ptr(), idxs.as_ptr(),
+                keys.len(),
+                block_hash.map_or(std::ptr::null(), |h| h),
+                outs.as_mut_ptr(),
+                results.as_mut_ptr(),
+            )
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        collect_gets(outs, results)
+    }
+
+    /// Streams everything under a key hash prefix, up to 32 bytes.
+    pub fn iter(&self, prefix: &[u8], block_hash: Option<&Hash>) -> Result<RangeIter> {
+        let mut out: *mut c_void = std::ptr::null_mut();
+        let rc = unsafe {
+            ledger_iter_open(
+                self.inner.as_ptr(),
+                prefix.as_ptr(), prefix.len(),
+                block_hash.map_or(std::ptr::null(), |h| h),
+                &mut out,
+            )
+        };
+
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        let inner = NonNull::new(out).expect("ledger_iter_open returned null");
+        Ok(RangeIter { inner, done: false })
+    }
+
+    /// The cannonical trie in chunks, cut `depth` levels below the root.
+    pub fn export_chunks(&self, depth: u8) -> Result<ChunkExport> {
+        let mut out: *mut c_void = std::ptr::null_mut();
+        let rc = unsafe { ledger_export_open(self.inner.as_ptr(), depth, &mut out) };
+
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        let inner = NonNull::new(out).expect("ledger_export_open returned null");
+        Ok(ChunkExport { inner, done: false })
+    }
+
+    /// Writes exported chunks once every one checks out against `root_hash`.
+    pub fn import_chunks(&self, chunks: &[&[u8]], root_hash: &Hash) -> Result<()> {
+        let ptrs: Vec<*const c_uchar> = chunks.iter().map(|c| c.as_ptr()).collect();
+        let sizes: Vec<usize> = chunks.iter().map(|c| c.len()).collect();
+
+        let rc = unsafe {
+            ledger_import_chunks(
+                self.inner.as_ptr(),
+                ptrs.as_ptr(), sizes.as_ptr(),
+                chunks.len(),
+                root_hash,
+            )
+        };
+
+        match rc {
+            0 => Ok(()),
+            _ => Err(InternalError::Ledger(rc)),
+        }
+    }
+
+    /// Bottom up loader for genesis and imports into an empty ledger.
+    pub fn bulk_loader(&self) -> Result<BulkLoader> {
+        let mut out: *mut c_void = std::ptr::null_mut();
+        let rc = unsafe { ledger_bulk_begin(self.inner.as_ptr(), &mut out) };
+
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        let inner = NonNull::new(out).expect("ledger_bulk_begin returned null");
+        Ok(BulkLoader { inner })
+    }
+
+    /// Pins the state as it is on disk for many consistent reads.
+    pub fn snapshot(&self, block_hash: Option<&Hash>) -> Result<Snapshot> {
+        let mut out: *mut c_void = std::ptr::null_mut();
+        let rc = unsafe {
+            ledger_snapshot_open(
+                self.inner.as_ptr(),
+                block_hash.map_or(std::ptr::null(), |h| h),
+                &mut out,
+            )
+        };
+
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        let inner = NonNull::new(out).expect("ledger_snapshot_open returned null");
+        Ok(Snapshot { inner })
+    }
+
     pub fn finalize(
         &self,
         block_hash: &Hash,
@@ -150,6 +631,148 @@ impl Ledger {
         Ok(bytes)
     }
 
+    /// Finalizes the ranges held here and returns their votes for the other shards,
+    /// with the root hash once no other shard's hash is missing.
+    pub fn finalize_shards(
+        &self,
+        block_hash: &Hash,
+    ) -> Result<(Vec<ShardVote>, Option<Hash>)> {
+        let empty = ShardVote { first: 0, last: 0, hash: Hash { h: ZERO_HASH } };
+        let mut votes = vec![empty; MAX_SHARDS];
+        let mut count: usize = 0;
+        let mut root = Hash { h: ZERO_HASH };
+
+        let rc = unsafe {
+            ledger_finalize_shards(
+                self.inner.as_ptr(),
+                block_hash,
+                votes.as_mut_ptr(), votes.len(),
+                &mut count,
+                &mut root,
+            )
+        };
+        if rc != 0 && rc != SHARDS_PENDING {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        votes.truncate(count);
+        Ok((votes, if rc == 0 { Some(root) } else { None }))
+    }
+
+    /// Takes another shard's vote, the root hash once it was the last one missing.
+    pub fn insert_shard_hash(
+        &self,
+        block_hash: &Hash,
+        vote: &ShardVote,
+    ) -> Result<Option<Hash>> {
+        let mut root = Hash { h: ZERO_HASH };
+        let rc = unsafe {
+            ledger_insert_shard_hash(self.inner.as_ptr(), block_hash, vote, &mut root)
+        };
+        match rc {
+            0 => Ok(Some(root)),
+            SHARDS_PENDING => Ok(None),
+            _ => Err(InternalError::Ledger(rc)),
+        }
+    }
+
+    /// Inclusive ranges held elsewhere whose hash the block's root is still waiting on.
+    pub fn missing_shards(&self, block_hash: &Hash) -> Result<Vec<(u8, u8)>> {
+        let mut out = vec![0u8; 2 * MAX_SHARDS];
+        let mut count: usize = 0;
+        let rc = unsafe {
+            ledger_missing_shards(
+                self.inner.as_ptr(),
+                block_hash,
+                out.as_mut_ptr(), MAX_SHARDS,
+                &mut count,
+            )
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        Ok(out.chunks(2).take(count).map(|p| (p[0], p[1])).collect())
+    }
+
+    pub fn alloc_stats(&self) -> Result<Vec<SlabStats>> {
+        let mut count: usize = 0;
+        let rc = unsafe {
+            ledger_alloc_stats(
+                self.inner.as_ptr(),
+                std::ptr::null_mut(), 0,
+                &mut count,
+            )
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        let mut stats = vec![SlabStats::default(); count];
+        let rc = unsafe {
+            ledger_alloc_stats(
+                self.inner.as_ptr(),
+                stats.as_mut_ptr(), stats.len(),
+                &mut count,
+            )
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+
+        // a class may have come into use between calls
+        stats.truncate(count);
+        Ok(stats)
+    }
+
+    /// Subtrees heavier than this split the root on finalize, zero for either is no limit.
+    pub fn set_split_weight(&self, leaves: u32, bytes: u64) -> Result<()> {
+        let rc = unsafe {
+            ledger_set_split_weight(self.inner.as_ptr(), leaves, bytes)
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+        Ok(())
+    }
+
+    /// Copy moves a block's versions on justify, Remap only remaps
+    /// the cannonical root and leaves the moving to settle_versions.
+    pub fn set_justify_mode(&self, mode: JustifyMode) -> Result<()> {
+        let rc = unsafe {
+            ledger_set_justify_mode(self.inner.as_ptr(), mode as u8)
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+        Ok(())
+    }
+
+    /// Copies up to max_blocks remap justified blocks to cannonical, oldest
+    /// first, zero for all. Meant for when the ledger is otherwise idle.
+    pub fn settle_versions(&self, max_blocks: usize) -> Result<()> {
+        let rc = unsafe {
+            ledger_settle_versions(self.inner.as_ptr(), max_blocks)
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+        Ok(())
+    }
+
+    /// Inclusive ranges of the key byte the root splits on, the cannonical
+    /// trie outside them is dropped. Empty holds everything.
+    pub fn set_shards(&self, ranges: &[(u8, u8)]) -> Result<()> {
+        let flat: Vec<u8> = ranges.iter().flat_map(|&(first, last)| [first, last]).collect();
+        let rc = unsafe {
+            ledger_set_shards(self.inner.as_ptr(), flat.as_ptr(), ranges.len())
+        };
+        if rc != 0 {
+            return Err(InternalError::Ledger(rc));
+        }
+        Ok(())
+    }
+
     pub fn db_put(
         &self,
         key: &[u8],
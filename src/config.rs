@@ -54,6 +54,7 @@ pub struct BlockchainConfig {
     pub ledger_path: String,
     pub ledger_cache_size: usize,
     pub ledger_map_size: usize,
+    pub ledger_threads: usize,
     pub ledger_tag: String,
     pub block_size: usize,
 }
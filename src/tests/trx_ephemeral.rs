@@ -38,7 +38,7 @@ fn ephemeral() {
 
     let ledger = Ledger::open(
         "assets/fake_db", 32, 
-        10 * 1024 * 1024, 
+        10 * 1024 * 1024, 0,
         "fake_tag", None
     ).unwrap();
 
@@ -34,7 +34,7 @@ fn regular() {
 
     let ledger = Ledger::open(
         "assets/fake_db", 32, 
-        10 * 1024 * 1024, 
+        10 * 1024 * 1024, 0,
         "fake_tag", None
     ).unwrap();
     let gens = TrxGenerators::new("custom_zkp", 1);